@@ -0,0 +1,105 @@
+#include "arena.hpp"
+
+#include <algorithm>
+
+
+// the first block is allocated with the first allocation
+Arena::Arena(size_t arenaBlockSize)
+    : blockSize(arenaBlockSize), memory(MemoryTracker::LOADER)
+{
+    current = 0;
+    offset = 0;
+    allocations = 0;
+    used = 0;
+    peak = 0;
+}
+
+
+Arena::~Arena()
+{
+    for (Block& block : blocks)
+        delete[] block.data;
+}
+
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    allocations++;
+
+    if (!blocks.empty())
+    {
+        void* data = take(size, alignment);
+        if (data != nullptr)
+            return data;
+
+        // the blocks after the current one are unused since the reset
+        if (current + 1 < blocks.size() &&
+            blocks[current + 1].size >= size + alignment)
+        {
+            current++;
+            offset = 0;
+            return take(size, alignment);
+        }
+    }
+
+    // the allocations bigger than a block get a block of their own
+    size_t newSize = std::max(blockSize, size + alignment);
+    size_t position = blocks.empty() ? 0 : current + 1;
+    blocks.insert(blocks.begin() + position, Block{new char[newSize], newSize});
+    current = position;
+    offset = 0;
+
+    memory.resize(getReserved());
+    return take(size, alignment);
+}
+
+
+// the memory is reused from the first block again
+void Arena::reset()
+{
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+
+// number of allocations since the arena was created, the resets don't
+// clear it
+uint64_t Arena::getAllocations()
+{
+    return allocations;
+}
+
+
+// the most bytes used at once between two resets
+size_t Arena::getPeak()
+{
+    return peak;
+}
+
+
+size_t Arena::getReserved()
+{
+    size_t reserved = 0;
+    for (Block& block : blocks)
+        reserved += block.size;
+    return reserved;
+}
+
+
+// nullptr when the rest of the current block is too small
+void* Arena::take(size_t size, size_t alignment)
+{
+    Block& block = blocks[current];
+    uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+    size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+
+    if (start + size > block.size)
+        return nullptr;
+
+    used += start + size - offset;
+    peak = std::max(peak, used);
+    offset = start + size;
+
+    return block.data + start;
+}
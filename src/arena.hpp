@@ -0,0 +1,94 @@
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+#include "memory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// hands out memory from big blocks by moving an offset, nothing is freed
+// until the whole arena is reset, the blocks are kept for the next use, so
+// millions of small temporaries cost only a few real allocations, the blocks
+// count as the loader's memory, an arena is used by one thread at a time
+class Arena
+{
+public:
+    Arena(size_t arenaBlockSize = 64 * 1024);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+    void reset();
+
+    uint64_t getAllocations();
+    size_t getPeak();
+    size_t getReserved();
+
+private:
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+
+    std::vector<Block> blocks;
+    size_t current;
+    size_t offset;
+    size_t blockSize;
+
+    uint64_t allocations;
+    size_t used;
+    size_t peak;
+    TrackedAllocation memory;
+
+    void* take(size_t size, size_t alignment);
+};
+
+
+// lets the standard containers use an arena, deallocation does nothing
+template<typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    Arena* arena;
+
+    ArenaAllocator(Arena& owner) : arena(&owner) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const
+    {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const
+    {
+        return arena != other.arena;
+    }
+};
+
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>
+    ArenaString;
+
+
+#endif /* ARENA_HPP_ */
@@ -0,0 +1,521 @@
+#include "benchmark.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+
+SceneParams::SceneParams()
+{
+    objectCount = 64;
+    trianglesPerObject = 5000;
+    ngonRatio = 0.25f;
+    texturedRatio = 0.5f;
+    duplicateRatio = 0.25f;
+    seed = 1;
+}
+
+
+// xorshift generator, std distributions give different numbers with
+// different standard libraries
+// https://en.wikipedia.org/wiki/Xorshift
+class BenchmarkRandom
+{
+public:
+    BenchmarkRandom(uint32_t seed) : state(seed != 0 ? seed : 1) {}
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // number from <0, 1)
+    float uniform()
+    {
+        return (next() >> 8) / 16777216.0f;
+    }
+
+private:
+    uint32_t state;
+};
+
+
+// deformed sphere made of a grid of quads, some of them are split to
+// triangles, the rest is left for the loader's triangulation
+static bool writeObjectFile(std::string file, int idx, bool textured,
+    const SceneParams& params, BenchmarkRandom& random)
+{
+    std::ofstream out(file);
+
+    if (!out)
+        return false;
+
+    int cells = std::max(1, params.trianglesPerObject / 2);
+    int rows = std::max(1, static_cast<int>(std::sqrt(cells / 2.0f)));
+    int columns = std::max(3, cells / rows);
+
+    float waveLat = 1.0f + std::floor(random.uniform() * 6.0f);
+    float waveLon = 1.0f + std::floor(random.uniform() * 6.0f);
+    float amplitude = 0.05f + random.uniform() * 0.15f;
+
+    out << "o benchmark " << idx << "\n";
+
+    // the poles are left out, so no face is degenerate
+    const float maxLatitude = glm::radians(80.0f);
+
+    for (int row = 0; row <= rows; row++)
+        for (int column = 0; column <= columns; column++)
+        {
+            float latitude = -maxLatitude + 2.0f * maxLatitude * row / rows;
+            float longitude = 2.0f * glm::pi<float>() * column / columns;
+
+            glm::vec3 normal(std::cos(latitude) * std::cos(longitude),
+                std::sin(latitude), std::cos(latitude) * std::sin(longitude));
+            float radius = 1.0f + amplitude * std::sin(waveLat * latitude) *
+                std::cos(waveLon * longitude);
+            glm::vec3 vertex = normal * radius;
+
+            out << "v " << vertex.x << " " << vertex.y << " " << vertex.z
+                << "\n";
+            out << "vn " << normal.x << " " << normal.y << " " << normal.z
+                << "\n";
+
+            if (textured)
+                out << "vt " << static_cast<float>(column) / columns << " "
+                    << static_cast<float>(row) / rows << "\n";
+        }
+
+    auto corner = [columns, textured](int row, int column)
+    {
+        int idx = row * (columns + 1) + column + 1;
+        std::string idxText = std::to_string(idx);
+
+        if (textured)
+            return " " + idxText + "/" + idxText + "/" + idxText;
+
+        return " " + idxText + "//" + idxText;
+    };
+
+    for (int row = 0; row < rows; row++)
+        for (int column = 0; column < columns; column++)
+        {
+            std::string a = corner(row, column);
+            std::string b = corner(row + 1, column);
+            std::string c = corner(row + 1, column + 1);
+            std::string d = corner(row, column + 1);
+
+            if (random.uniform() < params.ngonRatio)
+                out << "f" << a << b << c << d << "\n";
+            else
+                out << "f" << a << b << c << "\nf" << a << c << d << "\n";
+        }
+
+    return static_cast<bool>(out);
+}
+
+
+std::shared_ptr<CameraPath> CameraPath::orbit(int frames, float radius)
+{
+    std::shared_ptr<CameraPath> path = std::make_shared<CameraPath>();
+
+    CameraPose pose;
+    pose.target = glm::vec3(0.0f, 0.0f, 0.0f);
+
+    // one full circle while the camera rises and falls once
+    for (int frame = 0; frame < frames; frame++)
+    {
+        float progress = static_cast<float>(frame) / frames;
+        pose.yaw = 90.0f + 360.0f * progress;
+        pose.pitch = -25.0f + 15.0f *
+            std::sin(2.0f * glm::pi<float>() * progress);
+        pose.radius = radius;
+        path->record(pose);
+    }
+
+    return path;
+}
+
+
+void CameraPath::record(CameraPose pose)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    poses.push_back(pose);
+}
+
+
+// after the end the camera stays at the last pose
+CameraPose CameraPath::getPose(size_t frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (poses.empty())
+        return CameraPose{90.0f, 0.0f, 10.0f, glm::vec3(0.0f, 0.0f, 0.0f)};
+
+    return poses[std::min(frame, poses.size() - 1)];
+}
+
+
+size_t CameraPath::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return poses.size();
+}
+
+
+// text file with one pose per line: yaw pitch radius target.x target.y target.z
+bool CameraPath::save(std::string file)
+{
+    std::ofstream out(file);
+
+    if (!out)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    out.precision(9);
+    out << "whisk-camera-path 1\n";
+    for (CameraPose& pose : poses)
+        out << pose.yaw << " " << pose.pitch << " " << pose.radius << " "
+            << pose.target.x << " " << pose.target.y << " " << pose.target.z
+            << "\n";
+
+    return static_cast<bool>(out);
+}
+
+
+bool CameraPath::load(std::string file)
+{
+    std::ifstream in(file);
+    std::string header;
+
+    if (!std::getline(in, header) || header != "whisk-camera-path 1")
+        return false;
+
+    std::vector<CameraPose> loaded;
+    CameraPose pose;
+
+    while (in >> pose.yaw >> pose.pitch >> pose.radius >> pose.target.x
+        >> pose.target.y >> pose.target.z)
+        loaded.push_back(pose);
+
+    // anything else than the end of file means a malformed line
+    if (!in.eof() || loaded.empty())
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    poses = loaded;
+    return true;
+}
+
+
+Benchmark::Benchmark()
+{
+    path = std::make_shared<CameraPath>();
+    sceneGenerated = false;
+    sceneRadius = 10.0f;
+    stateCallSum = 0;
+    avoidedCallSum = 0;
+    triangleSum = 0;
+    vertexSum = 0;
+    culledSum = 0;
+    bufferUploadSum = 0;
+    textureUploadSum = 0;
+}
+
+
+// the objects are written to OBJ files and loaded back, so the load times
+// include the parser, flush is called after each object (the headless
+// renderer executes the commands there)
+bool Benchmark::generateScene(GraphicsManager* manager, SceneParams params,
+    std::string directory, std::function<void()> flush)
+{
+    sceneGenerated = true;
+    sceneParams = params;
+
+    BenchmarkRandom random(params.seed);
+
+    // all textured objects share a single checkerboard texture
+    const int textureSize = 256;
+    std::vector<unsigned char> texture(textureSize * textureSize * 3);
+    for (int y = 0; y < textureSize; y++)
+        for (int x = 0; x < textureSize; x++)
+        {
+            bool light = ((x / 32) + (y / 32)) % 2 == 0;
+            unsigned char* pixel = &texture[(y * textureSize + x) * 3];
+            pixel[0] = light ? 230 : 40;
+            pixel[1] = light ? 200 : 60;
+            pixel[2] = light ? 120 : 90;
+        }
+
+    int texIdx = manager->addTexture(texture.data(), textureSize,
+        textureSize, "benchmark checkerboard");
+
+    // objects are placed on a square grid around the origin
+    const float spacing = 3.0f;
+    int perRow = std::ceil(std::sqrt(static_cast<float>(params.objectCount)));
+    sceneRadius = spacing * perRow + 5.0f;
+
+    for (int i = 0; i < params.objectCount; i++)
+    {
+        bool textured = random.uniform() < params.texturedRatio;
+
+        // duplicates are appended right after the object they copy
+        if (i > 0 && random.uniform() < params.duplicateRatio)
+        {
+            manager->duplicateObject(
+                manager->getObjectAt(manager->getObjectCount() - 1));
+
+            if (flush)
+                flush();
+        }
+        else
+        {
+            std::string file = directory + "/whisk_benchmark_" +
+                std::to_string(i) + ".obj";
+
+            if (!writeObjectFile(file, i, textured, params, random) ||
+                !loadObject(manager, file, flush))
+                return false;
+        }
+
+        ObjectHandle object =
+            manager->getObjectAt(manager->getObjectCount() - 1);
+
+        glm::vec3 position((i % perRow - (perRow - 1) / 2.0f) * spacing, 0.0f,
+            (i / perRow - (perRow - 1) / 2.0f) * spacing);
+        glm::vec3 rotation(0.0f, random.uniform() * 360.0f, 0.0f);
+
+        manager->setObjectPos(object, position);
+        manager->setObjectRot(object, rotation);
+
+        if (textured)
+            manager->setObjectTex(object, texIdx);
+        else
+            manager->setObjectColor(object, random.uniform(),
+                random.uniform(), random.uniform());
+    }
+
+    if (flush)
+        flush();
+
+    return true;
+}
+
+
+bool Benchmark::loadObject(GraphicsManager* manager, std::string file,
+    std::function<void()> flush)
+{
+    size_t objectsBefore = manager->getObjectCount();
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    manager->newObject(file);
+
+    if (flush)
+        flush();
+
+    float time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count() / 1000.0f;
+
+    int objects = manager->getObjectCount() - objectsBefore;
+    loads.push_back(Load{file, time, objects});
+
+    return objects > 0;
+}
+
+
+// distance from the origin from which the whole generated scene is visible
+float Benchmark::getSceneRadius()
+{
+    return sceneRadius;
+}
+
+
+void Benchmark::setCameraPath(std::shared_ptr<CameraPath> cameraPath)
+{
+    path = cameraPath;
+}
+
+
+std::shared_ptr<CameraPath> Benchmark::getCameraPath()
+{
+    return path;
+}
+
+
+void Benchmark::addFrame(float CPUTime, float GPUTime,
+    const FrameStats& stats)
+{
+    CPUTimes.push_back(CPUTime);
+    GPUTimes.push_back(GPUTime);
+    drawCounts.push_back(stats.drawCalls);
+    stateCallSum += stats.stateChanges;
+    avoidedCallSum += stats.avoidedStateChanges;
+    triangleSum += stats.triangles;
+    vertexSum += stats.vertices;
+    culledSum += stats.culled;
+    bufferUploadSum += stats.bufferBytes;
+    textureUploadSum += stats.textureBytes;
+}
+
+
+size_t Benchmark::getFrameCount()
+{
+    return CPUTimes.size();
+}
+
+
+bool Benchmark::finished()
+{
+    return CPUTimes.size() >= path->size();
+}
+
+
+// nearest-rank percentile
+float Benchmark::percentile(const std::vector<float>& sorted, float rank)
+{
+    if (sorted.empty())
+        return 0.0f;
+
+    size_t idx = std::ceil(rank / 100.0f * sorted.size());
+    return sorted[std::max<size_t>(idx, 1) - 1];
+}
+
+
+std::string Benchmark::summary()
+{
+    std::vector<float> CPUSorted = CPUTimes;
+    std::vector<float> GPUSorted = GPUTimes;
+    std::sort(CPUSorted.begin(), CPUSorted.end());
+    std::sort(GPUSorted.begin(), GPUSorted.end());
+
+    float loadTime = 0.0f;
+    for (Load& load : loads)
+        loadTime += load.time;
+
+    std::stringstream text;
+    text.precision(2);
+    text << std::fixed;
+    text << CPUTimes.size() << " frames\n";
+    text << "CPU p50/p95/p99: " << percentile(CPUSorted, 50) << " / "
+        << percentile(CPUSorted, 95) << " / " << percentile(CPUSorted, 99)
+        << " ms\n";
+    text << "GPU p50/p95/p99: " << percentile(GPUSorted, 50) << " / "
+        << percentile(GPUSorted, 95) << " / " << percentile(GPUSorted, 99)
+        << " ms\n";
+    text << "Loading: " << loadTime << " ms (" << loads.size() << " files)\n";
+
+    MeshKernels& kernels = MeshKernels::instance();
+    text << "Mesh kernels: " << MeshKernels::levelName(kernels.getLevel());
+    if (kernels.getFallback())
+        text << " (the vectorized ones failed the verification)";
+
+    return text.str();
+}
+
+
+static void writeTimesJSON(std::ofstream& out, std::vector<float> times,
+    float (*percentile)(const std::vector<float>&, float))
+{
+    std::sort(times.begin(), times.end());
+
+    float sum = 0.0f;
+    for (float time : times)
+        sum += time;
+
+    out << "{\"p50\": " << percentile(times, 50)
+        << ", \"p95\": " << percentile(times, 95)
+        << ", \"p99\": " << percentile(times, 99)
+        << ", \"avg\": " << (times.empty() ? 0.0f : sum / times.size())
+        << ", \"max\": " << (times.empty() ? 0.0f : times.back()) << "}";
+}
+
+
+// GPU times are reported as soon as the GPU finishes the frame, so they lag
+// a frame or two behind the CPU times
+bool Benchmark::writeJSON(std::string file)
+{
+    std::ofstream out(file);
+
+    if (!out)
+        return false;
+
+    out.precision(4);
+    out << std::fixed;
+    out << "{\n";
+
+    if (sceneGenerated)
+        out << "  \"scene\": {\"objects\": " << sceneParams.objectCount
+            << ", \"triangles_per_object\": " << sceneParams.trianglesPerObject
+            << ", \"ngon_ratio\": " << sceneParams.ngonRatio
+            << ", \"textured_ratio\": " << sceneParams.texturedRatio
+            << ", \"duplicate_ratio\": " << sceneParams.duplicateRatio
+            << ", \"seed\": " << sceneParams.seed << "},\n";
+    else
+        out << "  \"scene\": null,\n";
+
+    out << "  \"frames\": " << CPUTimes.size() << ",\n";
+    out << "  \"cpu_ms\": ";
+    writeTimesJSON(out, CPUTimes, percentile);
+    out << ",\n  \"gpu_ms\": ";
+    writeTimesJSON(out, GPUTimes, percentile);
+
+    int drawSum = 0, drawMax = 0;
+    for (int draws : drawCounts)
+    {
+        drawSum += draws;
+        drawMax = std::max(drawMax, draws);
+    }
+
+    out << ",\n  \"draws\": {\"avg\": "
+        << (drawCounts.empty() ? 0.0f :
+            static_cast<float>(drawSum) / drawCounts.size())
+        << ", \"max\": " << drawMax << "},\n";
+
+    // state changes which reached the driver and those the cache skipped
+    float frames = std::max<size_t>(CPUTimes.size(), 1);
+    out << "  \"gl_state_calls\": {\"issued_avg\": "
+        << stateCallSum / frames << ", \"avoided_avg\": "
+        << avoidedCallSum / frames << "},\n";
+    out << "  \"triangles_avg\": " << triangleSum / frames << ",\n";
+    out << "  \"vertices_avg\": " << vertexSum / frames << ",\n";
+    out << "  \"culled_avg\": " << culledSum / frames << ",\n";
+    out << "  \"upload_bytes\": {\"buffers\": " << bufferUploadSum
+        << ", \"textures\": " << textureUploadSum << "},\n";
+
+    MeshKernels& kernels = MeshKernels::instance();
+    out << "  \"mesh_kernels\": {\"level\": \""
+        << MeshKernels::levelName(kernels.getLevel()) << "\", \"fallback\": "
+        << (kernels.getFallback() ? "true" : "false") << "},\n";
+
+    float loadTime = 0.0f;
+    out << "  \"loads\": [";
+    for (size_t i = 0; i < loads.size(); i++)
+    {
+        std::string name;
+        for (char c : loads[i].file)
+        {
+            if (c == '"' || c == '\\')
+                name += '\\';
+            name += c;
+        }
+
+        out << (i == 0 ? "\n" : ",\n") << "    {\"file\": \"" << name
+            << "\", \"ms\": " << loads[i].time << ", \"objects\": "
+            << loads[i].objects << "}";
+        loadTime += loads[i].time;
+    }
+    out << (loads.empty() ? "],\n" : "\n  ],\n");
+
+    out << "  \"load_total_ms\": " << loadTime << "\n";
+    out << "}\n";
+
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,111 @@
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+#include "graphics.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class GraphicsManager;
+struct FrameStats;
+
+
+// parameters of a procedurally generated scene, the same parameters always
+// generate the same scene
+struct SceneParams
+{
+    int objectCount;
+    int trianglesPerObject;
+    float ngonRatio;
+    float texturedRatio;
+    float duplicateRatio;
+    uint32_t seed;
+
+    SceneParams();
+};
+
+
+// everything needed to place the camera, mouse input is not repeatable
+struct CameraPose
+{
+    float yaw;
+    float pitch;
+    float radius;
+    glm::vec3 target;
+};
+
+
+// camera poses of consecutive frames, they are recorded by the render thread
+// while the UI thread can save the path at any time
+class CameraPath
+{
+public:
+    static std::shared_ptr<CameraPath> orbit(int frames, float radius);
+
+    void record(CameraPose pose);
+    CameraPose getPose(size_t frame);
+    size_t size();
+    bool save(std::string file);
+    bool load(std::string file);
+
+private:
+    std::mutex mutex;
+    std::vector<CameraPose> poses;
+};
+
+
+// plays a camera path over a scene and collects the frame times, frames are
+// added by the render thread and the results are read after it finishes
+class Benchmark
+{
+public:
+    Benchmark();
+
+    bool generateScene(GraphicsManager* manager, SceneParams params,
+        std::string directory, std::function<void()> flush = nullptr);
+    bool loadObject(GraphicsManager* manager, std::string file,
+        std::function<void()> flush = nullptr);
+    float getSceneRadius();
+    void setCameraPath(std::shared_ptr<CameraPath> cameraPath);
+    std::shared_ptr<CameraPath> getCameraPath();
+    void addFrame(float CPUTime, float GPUTime, const FrameStats& stats);
+    size_t getFrameCount();
+    bool finished();
+    std::string summary();
+    bool writeJSON(std::string file);
+
+private:
+    struct Load
+    {
+        std::string file;
+        float time;
+        int objects;
+    };
+
+    std::shared_ptr<CameraPath> path;
+    bool sceneGenerated;
+    SceneParams sceneParams;
+    float sceneRadius;
+    std::vector<Load> loads;
+
+    std::vector<float> CPUTimes;
+    std::vector<float> GPUTimes;
+    std::vector<int> drawCounts;
+    uint64_t stateCallSum;
+    uint64_t avoidedCallSum;
+    uint64_t triangleSum;
+    uint64_t vertexSum;
+    uint64_t culledSum;
+    uint64_t bufferUploadSum;
+    uint64_t textureUploadSum;
+
+    static float percentile(const std::vector<float>& sorted, float rank);
+};
+
+
+#endif /* BENCHMARK_HPP_ */
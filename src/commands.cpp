@@ -0,0 +1,45 @@
+#include "commands.hpp"
+
+
+CommandQueue::CommandQueue()
+{
+    // the queue always contains at least one (empty) node
+    tail = new Node();
+    head = tail;
+}
+
+
+CommandQueue::~CommandQueue()
+{
+    Command command;
+    while (pop(command));
+
+    delete tail;
+}
+
+
+// can be called from any thread
+void CommandQueue::push(Command command)
+{
+    Node* node = new Node();
+    node->command = std::move(command);
+
+    Node* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+
+// can be called only from the consumer thread
+bool CommandQueue::pop(Command& command)
+{
+    Node* next = tail->next.load(std::memory_order_acquire);
+
+    if (next == nullptr)
+        return false;
+
+    command = std::move(next->command);
+
+    delete tail;
+    tail = next;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef COMMANDS_HPP_
+#define COMMANDS_HPP_
+
+#include "graphics.hpp"
+
+#include <functional>
+#include <atomic>
+
+
+// lock-free multiple producer, single consumer queue
+// the algorithm is taken from:
+// https://www.1024cores.net/home/lock-free-algorithms/queues/non-intrusive-mpsc-node-based-queue
+class CommandQueue
+{
+public:
+    typedef std::function<void()> Command;
+
+    CommandQueue();
+    ~CommandQueue();
+
+    void push(Command command);
+    bool pop(Command& command);
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next;
+        Command command;
+
+        Node() : next(nullptr) {}
+    };
+
+    // producers only touch the head, the consumer only touches the tail
+    std::atomic<Node*> head;
+    Node* tail;
+};
+
+
+#endif /* COMMANDS_HPP_ */
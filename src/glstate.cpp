@@ -0,0 +1,286 @@
+#include "glstate.hpp"
+
+#include <cstring>
+
+
+GLState& GLState::instance()
+{
+    static GLState state;
+    return state;
+}
+
+
+GLState::GLState()
+{
+    reset();
+    resetCounters();
+}
+
+
+// counts the call and tells whether the driver has to be called
+bool GLState::changed(Call call, bool different)
+{
+    if (different)
+        issued[call]++;
+    else
+        avoided[call]++;
+
+    return different;
+}
+
+
+void GLState::useProgram(GLuint newProgram)
+{
+    if (!changed(PROGRAM, newProgram != program))
+        return;
+
+    program = newProgram;
+    glUseProgram(program);
+
+    auto it = programUniforms.find(program);
+    uniforms = it != programUniforms.end() ? &it->second : nullptr;
+}
+
+
+void GLState::bindVertexArray(GLuint newVertexArray)
+{
+    if (!changed(VERTEX_ARRAY, newVertexArray != vertexArray))
+        return;
+
+    vertexArray = newVertexArray;
+    glBindVertexArray(vertexArray);
+}
+
+
+void GLState::bindTexture(GLuint unit, GLuint texture)
+{
+    if (!changed(TEXTURE, texture != textures[unit]))
+        return;
+
+    textures[unit] = texture;
+    glBindTextureUnit(unit, texture);
+}
+
+
+void GLState::setPolygonMode(GLenum mode)
+{
+    if (!changed(POLYGON_MODE, mode != polygonMode))
+        return;
+
+    polygonMode = mode;
+    glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
+}
+
+
+void GLState::setDepthTest(bool enable)
+{
+    if (!changed(DEPTH, depthTest != enable))
+        return;
+
+    depthTest = enable;
+    if (enable)
+        glEnable(GL_DEPTH_TEST);
+    else
+        glDisable(GL_DEPTH_TEST);
+}
+
+
+void GLState::setDepthWrite(bool enable)
+{
+    if (!changed(DEPTH, depthWrite != enable))
+        return;
+
+    depthWrite = enable;
+    glDepthMask(enable ? GL_TRUE : GL_FALSE);
+}
+
+
+void GLState::setDepthFunc(GLenum func)
+{
+    if (!changed(DEPTH, func != depthFunc))
+        return;
+
+    depthFunc = func;
+    glDepthFunc(depthFunc);
+}
+
+
+void GLState::setBlend(bool enable)
+{
+    if (!changed(BLEND, blend != enable))
+        return;
+
+    blend = enable;
+    if (enable)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+}
+
+
+void GLState::setBlendFunc(GLenum source, GLenum destination)
+{
+    if (!changed(BLEND, source != blendSource ||
+        destination != blendDestination))
+        return;
+
+    blendSource = source;
+    blendDestination = destination;
+    glBlendFunc(blendSource, blendDestination);
+}
+
+
+// the names in the order of GLState::Uniform
+static const char* uniformNames[GLState::UNIFORM_NAMES] = {
+    "model", "texLayer", "glyphs", "screen"
+};
+
+
+// glGetUniformLocation is a string lookup inside the driver, so all
+// locations of a program are looked up once, -1 for the uniforms it doesn't
+// have
+void GLState::addProgram(GLuint newProgram)
+{
+    ProgramUniforms& table = programUniforms[newProgram];
+
+    for (int uniform = 0; uniform < UNIFORM_NAMES; uniform++)
+    {
+        table.locations[uniform] = glGetUniformLocation(newProgram,
+            uniformNames[uniform]);
+        table.values[uniform].known = false;
+    }
+
+    if (newProgram == program)
+        uniforms = &table;
+}
+
+
+// nullptr when the used program doesn't have the uniform
+GLState::UniformValue* GLState::uniformValue(Uniform uniform, GLint& location)
+{
+    if (uniforms == nullptr)
+        return nullptr;
+
+    location = uniforms->locations[uniform];
+    return location != -1 ? &uniforms->values[uniform] : nullptr;
+}
+
+
+// uniforms are set in the currently used program
+void GLState::setUniform(Uniform uniform, GLint value)
+{
+    GLint location;
+    UniformValue* cached = uniformValue(uniform, location);
+    if (cached == nullptr)
+        return;
+
+    if (!changed(UNIFORM, !cached->known || cached->integer != value))
+        return;
+
+    cached->known = true;
+    cached->integer = value;
+    glUniform1i(location, value);
+}
+
+
+void GLState::setUniform(Uniform uniform, const glm::mat4& value)
+{
+    GLint location;
+    UniformValue* cached = uniformValue(uniform, location);
+    if (cached == nullptr)
+        return;
+
+    if (!changed(UNIFORM, !cached->known ||
+        memcmp(&cached->matrix, &value, sizeof(glm::mat4)) != 0))
+        return;
+
+    cached->known = true;
+    cached->matrix = value;
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+
+void GLState::forgetProgram(GLuint deleted)
+{
+    if (program == deleted)
+    {
+        program = unknown;
+        uniforms = nullptr;
+    }
+
+    programUniforms.erase(deleted);
+}
+
+
+void GLState::forgetVertexArray(GLuint deleted)
+{
+    if (vertexArray == deleted)
+        vertexArray = unknown;
+}
+
+
+void GLState::forgetTexture(GLuint deleted)
+{
+    for (GLuint& texture : textures)
+        if (texture == deleted)
+            texture = unknown;
+}
+
+
+// called when the context is destroyed or changed by someone else
+void GLState::reset()
+{
+    program = unknown;
+    vertexArray = unknown;
+    for (GLuint& texture : textures)
+        texture = unknown;
+    polygonMode = unknown;
+    depthTest = -1;
+    depthWrite = -1;
+    depthFunc = unknown;
+    blend = -1;
+    blendSource = unknown;
+    blendDestination = unknown;
+
+    programUniforms.clear();
+    uniforms = nullptr;
+}
+
+
+void GLState::resetCounters()
+{
+    for (int call = 0; call < CALL_TYPES; call++)
+        issued[call] = avoided[call] = 0;
+}
+
+
+uint64_t GLState::getIssued(Call call)
+{
+    return issued[call];
+}
+
+
+uint64_t GLState::getAvoided(Call call)
+{
+    return avoided[call];
+}
+
+
+uint64_t GLState::getIssuedTotal()
+{
+    uint64_t total = 0;
+    for (int call = 0; call < CALL_TYPES; call++)
+        total += issued[call];
+
+    return total;
+}
+
+
+uint64_t GLState::getAvoidedTotal()
+{
+    uint64_t total = 0;
+    for (int call = 0; call < CALL_TYPES; call++)
+        total += avoided[call];
+
+    return total;
+}
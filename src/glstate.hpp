@@ -0,0 +1,112 @@
+#ifndef GLSTATE_HPP_
+#define GLSTATE_HPP_
+
+#include "graphics.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+
+
+// remembers the OpenGL state set by the render thread and calls the driver
+// only when the state really changes, the state starts unknown, so the first
+// call of every kind always reaches the driver
+class GLState
+{
+public:
+    enum Call
+    {
+        PROGRAM,
+        VERTEX_ARRAY,
+        TEXTURE,
+        POLYGON_MODE,
+        DEPTH,
+        BLEND,
+        UNIFORM,
+        CALL_TYPES
+    };
+
+    // uniforms of all programs, their locations are looked up when a program
+    // is linked or loaded
+    enum Uniform
+    {
+        MODEL,
+        TEX_LAYER,
+        GLYPHS,
+        SCREEN,
+        UNIFORM_NAMES
+    };
+
+    static GLState& instance();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void bindTexture(GLuint unit, GLuint texture);
+    void setPolygonMode(GLenum mode);
+    void setDepthTest(bool enable);
+    void setDepthWrite(bool enable);
+    void setDepthFunc(GLenum func);
+    void setBlend(bool enable);
+    void setBlendFunc(GLenum source, GLenum destination);
+    void addProgram(GLuint program);
+    void setUniform(Uniform uniform, GLint value);
+    void setUniform(Uniform uniform, const glm::mat4& value);
+
+    // deleted objects are unbound by OpenGL and their names can be reused
+    void forgetProgram(GLuint program);
+    void forgetVertexArray(GLuint vertexArray);
+    void forgetTexture(GLuint texture);
+    void reset();
+
+    void resetCounters();
+    uint64_t getIssued(Call call);
+    uint64_t getAvoided(Call call);
+    uint64_t getIssuedTotal();
+    uint64_t getAvoidedTotal();
+
+private:
+    static const int textureUnits = 16;
+    static const GLuint unknown = 0xFFFFFFFF;
+
+    struct UniformValue
+    {
+        bool known;
+        GLint integer;
+        glm::mat4 matrix;
+    };
+
+    struct ProgramUniforms
+    {
+        GLint locations[UNIFORM_NAMES];
+        UniformValue values[UNIFORM_NAMES];
+    };
+
+    GLState();
+
+    GLuint program;
+    GLuint vertexArray;
+    GLuint textures[textureUnits];
+    GLenum polygonMode;
+    int depthTest;
+    int depthWrite;
+    GLenum depthFunc;
+    int blend;
+    GLenum blendSource;
+    GLenum blendDestination;
+
+    // uniforms are part of the program's state, so they stay valid when
+    // another program is used in the meantime, the table of the used program
+    // is kept aside, so setting a uniform needs no lookup
+    std::unordered_map<GLuint, ProgramUniforms> programUniforms;
+    ProgramUniforms* uniforms;
+
+    uint64_t issued[CALL_TYPES];
+    uint64_t avoided[CALL_TYPES];
+
+    bool changed(Call call, bool different);
+    UniformValue* uniformValue(Uniform uniform, GLint& location);
+};
+
+
+#endif /* GLSTATE_HPP_ */
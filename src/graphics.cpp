@@ -1,518 +1,1847 @@
 #include "graphics.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <iomanip>
+#include <limits>
+#include <unordered_map>
 
-GraphicsManager::GraphicsManager(Canvas* parent) : parentCanvas(parent)
+
+ObjectInfo::ObjectInfo(std::string objectName) : name(objectName)
+{
+    // the same values are set in the Object's constructor
+    show = true;
+    color = glm::vec3(1.0f, 0.0f, 0.0f);
+    position = glm::vec3(0.0f, 0.0f, 0.0f);
+    rotation = glm::vec3(0.0f, 0.0f, 0.0f);
+    size = glm::vec3(1.0f, 1.0f, 1.0f);
+    renderMode = 0;
+    listPosition = -1;
+}
+
+
+FrameStats::FrameStats()
+{
+    drawCalls = 0;
+    objects = 0;
+    culled = 0;
+    triangles = 0;
+    vertices = 0;
+    stateChanges = 0;
+    avoidedStateChanges = 0;
+    bufferBytes = 0;
+    textureBytes = 0;
+}
+
+
+GraphicsManager::GraphicsManager(RenderHost* parent) : parentHost(parent)
 {
     lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
+    viewportDims = std::make_pair(1, 1);
+
+    mouseInfo.spinning = false;
+    mouseInfo.moving = false;
+    mouseInfo.mousePos = glm::ivec2(0, 0);
+    mouseInfo.wheelPos = 0;
+
+    commands = new CommandQueue();
 
     #ifdef DEBUG
         glEnable(GL_DEBUG_OUTPUT);
         glDebugMessageCallback(oglDebug::GLDebugMessageCallback, NULL);
     #endif /* DEBUG */
 
+    // the vectorized kernels are checked once before any mesh uses them, a
+    // fallback is reported by the benchmarks
+    MeshKernels& kernels = MeshKernels::instance();
+    kernels.verify();
+
+    #ifdef DEBUG
+        std::cout << "Mesh kernels: " <<
+            MeshKernels::levelName(kernels.getLevel()) <<
+            (kernels.getFallback() ? " (verification failed)" : "") <<
+            std::endl;
+    #endif /* DEBUG */
+
     // enable z-buffering depth test
-    glEnable(GL_DEPTH_TEST);
+    GLState::instance().setDepthTest(true);
+
+    // loading vertex and fragment shaders
+    shaders = new ShaderManager();
+    shaders->addShader("default.vert");
+    shaders->addShader("default.frag");
+    // in the order of Object::ShaderFeature
+    shaders->addFeature("TEXTURED");
+    shaders->addFeature("LIT");
+    // only the variants drawn by the objects, the lines are never lit
+    shaders->addVariant(0);
+    shaders->addVariant(Object::LIT);
+    shaders->addVariant(Object::TEXTURED | Object::LIT);
+    shadersCompiled = shaders->linkProgram();
+
+    camera = new Camera();
+    scene = new Scene();
+    renderQueue = new RenderQueue();
+
+    // the jobs continue on the render thread through the command queue
+    JobSystem::instance().setRenderThread(
+        [this](std::function<void()> command){ post(command); });
+
+    uploader = new TextureUploader();
+    streamer = new TextureStreamer(uploader);
+    textureBudget = streamer->getBudget() / (1024 * 1024);
+    frameNumber = 0;
+    nextTextureKey = 0;
+    nextSubscription = 0;
+    createPlaceholder();
+
+    framesInFlight = 2;
+    frameIdx = 0;
+    GPUFrameTime = 0.0f;
+    createFrameResources();
+
+    hud = new HUD();
+    HUDEnabled = true;
+    HUDFPS = 0.0f;
+    HUDCPUTime = 0.0f;
+    HUDGPUTime = 0.0f;
+}
+
+
+GraphicsManager::~GraphicsManager()
+{
+    JobSystem::instance().setRenderThread(nullptr);
+
+    delete commands;
+    delete shaders;
+    delete camera;
+    delete scene;
+    delete renderQueue;
+    delete uploader;
+    delete streamer;
+    delete hud;
+}
+
+
+// the variant is a mask of Object::ShaderFeature
+GLuint GraphicsManager::getShadersID(int variant)
+{
+    return shaders->getID(variant);
+}
+
+
+bool GraphicsManager::getShadersCompiled()
+{
+    return shadersCompiled;
+}
+
+
+// planes of the view frustum in the world space with normals pointing inside
+// https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+static void frustumPlanes(const glm::mat4& clip, glm::vec4 planes[6])
+{
+    glm::mat4 rows = glm::transpose(clip);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        planes[axis * 2] = rows[3] + rows[axis];
+        planes[axis * 2 + 1] = rows[3] - rows[axis];
+    }
+
+    for (int i = 0; i < 6; i++)
+        planes[i] = planes[i] / glm::length(glm::vec3(planes[i]));
+}
+
+
+void GraphicsManager::render()
+{
+    PROFILE_SCOPE("render");
+
+    FrameResources& frame = frames[frameIdx];
+
+    // the CPU can be at most framesInFlight frames ahead of the GPU, the
+    // resources of this frame are free once the GPU finishes with them
+    waitForFrame(frame);
+
+    // the counters show how many state changes were elided in this frame
+    GLState& state = GLState::instance();
+    state.resetCounters();
+
+    Profiler& profiler = Profiler::instance();
+    bool profiling = profiler.getEnabled();
+    bool profilingObjects = profiling && profiler.getPerObjectGPU();
+
+    if (profiling)
+    {
+        frame.timers->calibrate();
+        frame.timers->begin("frame");
+        frame.timers->begin("clear");
+    }
+
+    glQueryCounter(frame.timeQueries[0], GL_TIMESTAMP);
+
+    // clear the background and z-buffer
+    glClearColor(0.135f, 0.135f, 0.135f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (profiling)
+    {
+        frame.timers->end();
+        frame.timers->begin("objects");
+    }
 
-    // v-sync
-    if (WGLEW_EXT_swap_control_tear)
-        wglSwapIntervalEXT(-1);
+    // benchmarks replace the mouse input with a recorded camera path
+    if (benchmark != nullptr)
+        camera->setPose(benchmark->getCameraPath()->getPose(
+            benchmark->getFrameCount()));
     else
-        wglSwapIntervalEXT(1);
+        camera->move(mouseInfo);
+
+    float aspectRatio = static_cast<float>(viewportDims.first) /
+        static_cast<float>(viewportDims.second);
+
+    // the view matrix moves the camera, so it can be computed only once
+    glm::mat4 view = camera->viewMatrix();
+    glm::mat4 projection = camera->projectionMatrix(aspectRatio);
+
+    // the buffer is mapped persistently, so the values are written directly
+    frame.uniforms->view = view;
+    frame.uniforms->projection = projection;
+    frame.uniforms->lightColor = glm::vec4(lightColor, 1.0f);
+    frame.uniforms->lightPos = glm::vec4(camera->getPos(), 1.0f);
+
+    // the view matrix applies the camera movement, so the pose is final now
+    if (recordedPath != nullptr)
+        recordedPath->record(camera->getPose());
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, frame.uniformBuffer);
+
+    renderQueue->build(*scene, *shaders, view,
+        camera->getFarClip());
+
+    frameNumber++;
+
+    // height of a unit at the distance of one unit in pixels, the streaming
+    // derives the texture levels from it
+    float pixelsPerUnit = projection[1][1] * viewportDims.second / 2.0f;
+
+    glm::vec4 planes[6];
+    frustumPlanes(projection * view, planes);
+
+    // the culling goes through the hot arrays in their order, the queue then
+    // visits only the objects which passed
+    drawnObjects.resize(scene->size());
+    frameStats.culled += MeshKernels::instance().cullSpheres(planes,
+        scene->getBoundsData(), scene->getVisibleData(), scene->size(),
+        drawnObjects.data());
+
+    for (size_t i = 0; i < renderQueue->size(); i++)
+    {
+        int object = renderQueue->at(i);
+
+        if (!drawnObjects[object])
+            continue;
+
+        frameStats.objects++;
+        Object* data = scene->getObject(object);
+
+        if (profilingObjects)
+            frame.timers->begin(data->objectName);
+
+        data->draw(scene->getModel(object), scene->getMode(object),
+            frameStats);
+        streamer->markVisible(scene->getTexture(object),
+            scene->getBounds(object), view, pixelsPerUnit, frameNumber);
+
+        if (profilingObjects)
+            frame.timers->end();
+    }
+
+    streamer->update(textures, textureArrays, frameNumber);
+
+    // the streamed levels are uploaded in the next frames
+    if (uploader->pending())
+        requestRender();
+
+    // the HUD shows the calls of the objects, not its own
+    frameStats.stateChanges = state.getIssuedTotal();
+    frameStats.avoidedStateChanges = state.getAvoidedTotal();
+    drawHUD();
+
+    // Nvidia warns about performance without this call
+    // https://stackoverflow.com/a/15079431
+    state.useProgram(0);
+
+    glQueryCounter(frame.timeQueries[1], GL_TIMESTAMP);
+    frame.queriesPending = true;
+
+    if (profiling)
+    {
+        // objects and frame zones
+        frame.timers->end();
+        frame.timers->end();
+    }
+
+    // instead of waiting for the GPU with glFinish the frame is fenced
+    frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    frameIdx = (frameIdx + 1) % framesInFlight;
+
+    lastFrameStats = frameStats;
+    frameStats = FrameStats();
+}
+
+
+void GraphicsManager::drawHUD()
+{
+    if (!HUDEnabled || !hud->hasFont())
+        return;
+
+    const float megabyte = 1024.0f * 1024.0f;
+    std::vector<std::string> lines;
+    std::stringstream line;
+    line << std::fixed << std::setprecision(2);
+
+    auto nextLine = [&lines, &line]{
+        lines.push_back(line.str());
+        line.str("");
+    };
+
+    // frame rate only makes sense when frames are rendered all the time
+    if (HUDFPS > 0.0f)
+        line << std::setprecision(1) << HUDFPS << " FPS, "
+            << std::setprecision(2);
+    line << "CPU " << HUDCPUTime << " ms, GPU " << HUDGPUTime << " ms";
+    nextLine();
+
+    line << "Draws " << frameStats.drawCalls << ", objects "
+        << frameStats.objects << ", culled " << frameStats.culled;
+    nextLine();
+
+    line << "Triangles " << frameStats.triangles << ", vertices "
+        << frameStats.vertices;
+    nextLine();
+
+    line << "GL calls " << frameStats.stateChanges << " ("
+        << frameStats.avoidedStateChanges << " avoided)";
+    nextLine();
+
+    line << "Uploads: buffers " << frameStats.bufferBytes / megabyte
+        << " MB, textures " << frameStats.textureBytes / megabyte << " MB";
+    nextLine();
+
+    line << "Textures " << streamer->getUsed() / megabyte << " / "
+        << streamer->getBudget() / (1024 * 1024) << " MB";
+    nextLine();
+
+    hud->draw(lines, viewportDims.first, viewportDims.second);
+}
+
+
+// vertex data uploaded in a single frame
+static const size_t bufferUploadBudget = 64 * 1024 * 1024;
+
+
+void GraphicsManager::processCommands()
+{
+    PROFILE_SCOPE("processCommands");
+
+    CommandQueue::Command command;
+
+    while (commands->pop(command))
+        command();
+
+    // a part of the pending images is uploaded every frame, the textures
+    // sharing the layer of a streamed one move to its new layer with it
+    for (TextureUploader::Finished& upload : uploader->process())
+    {
+        std::vector<std::shared_ptr<Texture>> sharing;
+        if (upload.texture->getHash() != 0)
+            for (auto& texture : textures)
+                if (texture != upload.texture &&
+                    texture->getID() == upload.texture->getID() &&
+                    texture->getLayer() == upload.texture->getLayer())
+                    sharing.push_back(texture);
+
+        placeTexture(upload.texture, upload.image, upload.data);
+        glDeleteTextures(1, &upload.image);
+
+        for (auto& texture : sharing)
+            texture->shareLayer(*upload.texture);
+    }
+    frameStats.textureBytes += uploader->getUploadedBytes();
+
+    // a big mesh would block the driver for seconds in a single upload,
+    // its segments are drawn once their buffers are complete
+    size_t bufferBudget = bufferUploadBudget;
+    while (!pendingBuffers.empty() && bufferBudget > 0)
+    {
+        VertexBuffer* buffer = pendingBuffers.front();
+        size_t bytes = buffer->upload(bufferBudget);
+        bufferBudget -= bytes;
+        frameStats.bufferBytes += bytes;
+
+        if (buffer->isUploaded())
+            pendingBuffers.pop_front();
+    }
+
+    if (uploader->pending() || !pendingBuffers.empty())
+        requestRender();
+}
+
+
+// all GL objects are deleted by the render thread before it stops
+void GraphicsManager::releaseResources()
+{
+    streamer->finishJobs();
+    processCommands();
+
+    scene->clear();
+    renderQueue->invalidate();
+    textures.clear();
+    textureArrays.clear();
+    uploader->release();
+    hud->release();
+    glDeleteTextures(1, &placeholderImage);
+
+    for (FrameResources& frame : frames)
+    {
+        waitForFrame(frame);
+        glUnmapNamedBuffer(frame.uniformBuffer);
+        glDeleteBuffers(1, &frame.uniformBuffer);
+        glDeleteQueries(2, frame.timeQueries);
+        frame.timers->release();
+        delete frame.timers;
+        frame.timers = nullptr;
+    }
+
+    delete shaders;
+    shaders = nullptr;
+
+    // the context is going away, nothing in it can be trusted anymore
+    GLState::instance().reset();
+}
+
+
+// duration of the last frame finished by the GPU in milliseconds
+float GraphicsManager::getGPUFrameTime()
+{
+    return GPUFrameTime;
+}
+
+
+// counters of the last rendered frame
+FrameStats GraphicsManager::getFrameStats()
+{
+    return lastFrameStats;
+}
+
+
+// memory used by the textures in bytes
+size_t GraphicsManager::getTextureMemory()
+{
+    return streamer->getUsed();
+}
+
+
+// the buffer's data is uploaded in parts by the next frames
+void GraphicsManager::queueBufferUpload(VertexBuffer* buffer)
+{
+    if (std::find(pendingBuffers.begin(), pendingBuffers.end(), buffer) ==
+        pendingBuffers.end())
+        pendingBuffers.push_back(buffer);
+}
+
+
+// called by the deleted buffers
+void GraphicsManager::cancelBufferUpload(VertexBuffer* buffer)
+{
+    pendingBuffers.erase(std::remove(pendingBuffers.begin(),
+        pendingBuffers.end(), buffer), pendingBuffers.end());
+}
+
+
+// the host measures the frame times, they are shown with the next frame
+void GraphicsManager::setHUDTimes(float FPS, float CPUTime, float GPUTime)
+{
+    HUDFPS = FPS;
+    HUDCPUTime = CPUTime;
+    HUDGPUTime = GPUTime;
+}
+
+
+std::shared_ptr<Benchmark> GraphicsManager::getBenchmark()
+{
+    return benchmark;
+}
+
+
+void GraphicsManager::endBenchmark()
+{
+    benchmark = nullptr;
+}
+
+
+// the host renders a new frame only when something in the scene changes
+void GraphicsManager::requestRender()
+{
+    parentHost->requestRender();
+}
+
+
+void GraphicsManager::setMouseInfo(MouseInfo info)
+{
+    post([this, info]{ mouseInfo = info; });
+}
+
+
+void GraphicsManager::setViewport(int width, int height)
+{
+    // minimized window has zero height
+    if (width <= 0 || height <= 0)
+        return;
+
+    post([this, width, height]{
+        viewportDims = std::make_pair(width, height);
+        glViewport(0, 0, width, height);
+    });
+}
+
+
+// more frames in flight allow more overlap of the CPU and GPU work at the
+// cost of higher input latency
+void GraphicsManager::setFramesInFlight(int count)
+{
+    if (count < 1 || count > maxFramesInFlight)
+        return;
+
+    post([this, count]{
+        for (FrameResources& frame : frames)
+            waitForFrame(frame);
+
+        framesInFlight = count;
+        frameIdx = 0;
+
+        #ifdef DEBUG
+            std::cout << "Frames in flight: " << count << std::endl;
+        #endif /* DEBUG */
+    });
+}
+
+
+// the font is rendered by the UI, without it the HUD isn't drawn
+void GraphicsManager::setHUDFont(std::shared_ptr<FontAtlas> atlas)
+{
+    post([this, atlas]{ hud->setFont(atlas); });
+}
+
+
+void GraphicsManager::setHUDEnabled(bool enable)
+{
+    post([this, enable]{ HUDEnabled = enable; });
+}
+
+
+// the benchmark starts with the next frame and runs until its camera path
+// ends, the host has to keep rendering frames in the meantime
+void GraphicsManager::runBenchmark(std::shared_ptr<Benchmark> run)
+{
+    post([this, run]{ benchmark = run; });
+}
+
+
+// pose of every rendered frame is added to the path, nullptr stops recording
+void GraphicsManager::recordCameraPath(std::shared_ptr<CameraPath> path)
+{
+    post([this, path]{ recordedPath = path; });
+}
+
+
+// std::stof without the copy into a std::string, throws the same exceptions
+static float parseFloat(const char* text)
+{
+    char* end;
+    errno = 0;
+    float value = std::strtof(text, &end);
+
+    if (end == text)
+        throw std::invalid_argument("stof");
+    if (errno == ERANGE)
+        throw std::out_of_range("stof");
+
+    return value;
+}
+
+
+// std::stoll without the copy into a std::string, throws the same
+// exceptions, the indices of the biggest meshes don't fit into an int
+static int64_t parseIndex(const char* text)
+{
+    char* end;
+    errno = 0;
+    long long value = std::strtoll(text, &end, 10);
+
+    if (end == text)
+        throw std::invalid_argument("stoll");
+    if (errno == ERANGE)
+        throw std::out_of_range("stoll");
+
+    return value;
+}
+
+
+// the file is read once and split into its objects, the objects are then
+// built by the jobs, the faces of every object in parallel, the objects are
+// added only when the whole file is correct
+void GraphicsManager::newObject(std::string file)
+{
+    PROFILE_SCOPE("newObject");
+
+    // the parsed file is kept in one arena until all its objects are built
+    Arena arena(1024 * 1024);
+    ParsedFile data = parseFile(file, arena);
+
+    // the vertices, texture vertices and normals are shared by all objects
+    // in the file
+    std::shared_ptr<std::vector<GLfloat>> vertices =
+        std::make_shared<std::vector<GLfloat>>();
+    std::vector<GLfloat> texVertices;
+    std::vector<GLfloat> normals;
+
+    std::vector<LoadedObject> objects(1);
+    objects.back().name = "New Object";
+    bool nameModified = false;
+
+    // the first error in the file is reported, the objects before an error
+    // found here are still built, because they can contain an earlier one
+    size_t errorLine = data.size();
+    std::string error;
+
+    for (size_t lineIdx = 0; lineIdx < data.size(); lineIdx++)
+    {
+        try
+        {
+            const ParsedLine& line = data[lineIdx];
+            const ArenaString& keyword = line.front();
+
+            LoadedElement element{lineIdx,
+                static_cast<int64_t>(vertices->size() / 3),
+                static_cast<int64_t>(texVertices.size() / 2),
+                static_cast<int64_t>(normals.size() / 3)};
+
+            // vertex
+            if (keyword == "v")
+            {
+                // v x-coord y-coord z-coord
+                if (line.size() != 4)
+                    throw std::invalid_argument(
+                        "Incorrect number of axes in space (expected 3)");
+
+                for (size_t i = 1; i < line.size(); i++)
+                    vertices->push_back(parseFloat(line[i].c_str()));
+            }
+            // texture vertex
+            else if (keyword == "vt")
+            {
+                // vt x-coord y-coord
+                if (line.size() != 3)
+                    throw std::invalid_argument(
+                        "Incorrect number of axes in texture (expected 2)");
+
+                for (size_t i = 1; i < line.size(); i++)
+                    texVertices.push_back(parseFloat(line[i].c_str()));
+            }
+            // vertex normal
+            else if (keyword == "vn")
+            {
+                // vn x-coord y-coord z-coord
+                if (line.size() != 4)
+                    throw std::invalid_argument(
+                        "Incorrect number of axes in normal vec. (expected 3)");
+
+                for (size_t i = 1; i < line.size(); i++)
+                    normals.push_back(parseFloat(line[i].c_str()));
+            }
+            // face
+            else if (keyword == "f")
+            {
+                // f vertex1/texture1/normal1 vertex2/texture2/normal2...
+                if (line.size() < 4)
+                    throw std::invalid_argument(
+                        "Incorrect number of vertices in face (expected >=3)");
+
+                objects.back().faces.push_back(element);
+            }
+            // line
+            else if (keyword == "l")
+            {
+                // l vertex1 vertex2
+                if (line.size() != 3)
+                    throw std::invalid_argument(
+                        "Incorrect number of vertices in line (expected 2)");
+
+                objects.back().lines.push_back(element);
+            }
+            // object name
+            else if (keyword == "o")
+            {
+                // o partOfName1 partOfName2...
+                if (line.size() == 1)
+                    throw std::invalid_argument("The name is missing");
+
+                // the next object starts if this one already has a name
+                if (nameModified)
+                    objects.push_back(LoadedObject());
+
+                objects.back().name.clear();
+                for (size_t i = 1; i < line.size(); i++)
+                    objects.back().name.append(line[i].data(),
+                        line[i].size());
+                nameModified = true;
+            }
+        }
+        catch (std::invalid_argument& exception)
+        {
+            // invalid_argument can be non-number characters in stof
+            // or manually thrown incompatible number of parameters
+            errorLine = lineIdx;
+            error = exception.what();
+            break;
+        }
+        catch (std::out_of_range&)
+        {
+            // stof of a number which doesn't fit into a float
+            errorLine = lineIdx;
+            error = "Incorrect index of vertex, texture or normal";
+            break;
+        }
+    }
+
+    JobSystem& jobs = JobSystem::instance();
+    std::vector<JobHandle> builds;
+
+    for (LoadedObject& object : objects)
+        builds.push_back(jobs.run([this, &data, vertices, &texVertices,
+            &normals, &object]{
+            buildObject(data, vertices, texVertices, normals, object);
+        }));
+
+    jobs.wait(builds);
+
+    uint64_t allocations = arena.getAllocations();
+    size_t facePeak = 0;
+    for (const LoadedObject& object : objects)
+    {
+        allocations += object.arenaAllocations;
+        facePeak = std::max(facePeak, object.arenaPeak);
+    }
+    MemoryTracker::instance().recordLoad(allocations, arena.getPeak(),
+        facePeak);
+
+    #ifdef DEBUG
+        std::cout << "Loader arenas: " << allocations << " allocations, "
+            << arena.getPeak() << " B peak of the file, " << facePeak
+            << " B peak of a face" << std::endl;
+    #endif /* DEBUG */
+
+    for (const LoadedObject& object : objects)
+        if (!object.error.empty() && object.errorLine < errorLine)
+        {
+            errorLine = object.errorLine;
+            error = object.error;
+        }
+
+    if (!error.empty())
+    {
+        #ifdef DEBUG
+            std::cout << "Object loading error: " << error << std::endl;
+        #endif /* DEBUG */
+        parentHost->showErrorMessage("Object loading error", "In file '" +
+            file + "' an error has occurred on line " +
+            std::to_string(errorLine + 1) + ":\n" + error);
+        return;
+    }
+
+    for (LoadedObject& object : objects)
+    {
+        // the name has to fit inside the object list
+        std::string name = object.name;
+        if (name.size() > 24)
+            name.resize(24);
+
+        ObjectHandle handle = objectHandles.create();
+        objectInfos.push_back(ObjectInfo(name));
+        objectOrder.push_back(handle);
+        objectInfos.back().listPosition = objectOrder.size() - 1;
+        publish(SceneEvent::OBJECT_ADDED, handle, objectOrder.size() - 1);
+
+        // the buffers are created by the render thread, which owns the
+        // context
+        size_t lineCount = object.lineCount;
+        std::shared_ptr<std::vector<GLfloat>> finalVertices = object.vertices;
+        std::shared_ptr<std::vector<GLfloat>> finalTextures =
+            object.texVertices;
+        std::shared_ptr<std::vector<GLfloat>> finalNormals = object.normals;
+
+        post([this, handle, name, lineCount, finalVertices, finalTextures,
+            finalNormals]{
+            scene->add(handle, std::make_unique<Object>(this, name,
+                lineCount, finalVertices, finalTextures, finalNormals));
+            renderQueue->invalidate();
+
+            #ifdef DEBUG
+                std::cout << "Object added: " << name << std::endl;
+            #endif /* DEBUG */
+        });
+    }
+}
+
+
+// the faces are split into chunks, every chunk collects its own vertices,
+// the chunks are joined in the order of the file, the lines are added after
+// the triangles
+void GraphicsManager::buildObject(const ParsedFile& data,
+    std::shared_ptr<std::vector<GLfloat>> vertices,
+    const std::vector<GLfloat>& texVertices,
+    const std::vector<GLfloat>& normals, LoadedObject& object)
+{
+    PROFILE_SCOPE("buildObject");
+
+    static const size_t faceGrain = 256;
+
+    struct Chunk
+    {
+        std::vector<GLfloat> vertices;
+        std::vector<GLfloat> texVertices;
+        std::vector<GLfloat> normals;
+        size_t errorLine;
+        std::string error;
+        uint64_t arenaAllocations;
+        size_t arenaPeak;
+    };
+
+    std::vector<Chunk> chunks((object.faces.size() + faceGrain - 1) /
+        faceGrain);
+
+    JobSystem::instance().parallelFor(object.faces.size(), faceGrain,
+        [this, &data, &vertices, &texVertices, &normals, &object, &chunks](
+        size_t begin, size_t end){
+        Chunk& chunk = chunks[begin / faceGrain];
+        glm::vec3 normal;
+
+        // the temporaries of a face are dropped before the next face
+        Arena arena;
+
+        for (size_t face = begin; face < end; face++)
+        {
+            const LoadedElement& element = object.faces[face];
+            arena.reset();
+
+            try
+            {
+                FaceIndices faceData = parseFace(element.vertices,
+                    data[element.line], arena);
+
+                // the arrays already hold the data defined after the face
+                for (const std::tuple<int64_t, int64_t, int64_t>& index :
+                    faceData)
+                    if (std::get<0>(index) < 0 ||
+                        std::get<0>(index) >= element.vertices ||
+                        std::get<1>(index) < -1 ||
+                        std::get<1>(index) >= element.texVertices ||
+                        std::get<2>(index) < -1 ||
+                        std::get<2>(index) >= element.normals)
+                        throw std::out_of_range("Face index");
+
+                triangulate(&faceData, vertices, &normal, arena);
+
+                for (const std::tuple<int64_t, int64_t, int64_t>& index :
+                    faceData)
+                {
+                    for (int axis = 0; axis < 3; axis++)
+                        chunk.vertices.push_back(
+                            vertices->at(std::get<0>(index) * 3 + axis));
+
+                    // if texture vertices are not included in the file
+                    if (std::get<1>(index) == -1)
+                    {
+                        chunk.texVertices.push_back(-1);
+                        chunk.texVertices.push_back(-1);
+                    }
+                    else
+                    {
+                        chunk.texVertices.push_back(
+                            texVertices.at(std::get<1>(index) * 2));
+                        chunk.texVertices.push_back(
+                            texVertices.at(std::get<1>(index) * 2 + 1));
+                    }
+
+                    // if normals are not included in the file
+                    if (std::get<2>(index) == -1)
+                    {
+                        chunk.normals.push_back(normal.x);
+                        chunk.normals.push_back(normal.y);
+                        chunk.normals.push_back(normal.z);
+                    }
+                    else
+                        for (int axis = 0; axis < 3; axis++)
+                            chunk.normals.push_back(
+                                normals.at(std::get<2>(index) * 3 + axis));
+                }
+            }
+            catch (std::invalid_argument& exception)
+            {
+                chunk.errorLine = element.line;
+                chunk.error = exception.what();
+                break;
+            }
+            catch (std::out_of_range&)
+            {
+                // this exception is triggered when line or faces includes
+                // non-existent vertex, texture coordinate or normal
+                chunk.errorLine = element.line;
+                chunk.error = "Incorrect index of vertex, texture or normal";
+                break;
+            }
+        }
+
+        chunk.arenaAllocations = arena.getAllocations();
+        chunk.arenaPeak = arena.getPeak();
+    });
+
+    object.vertices = std::make_shared<std::vector<GLfloat>>();
+    object.texVertices = std::make_shared<std::vector<GLfloat>>();
+    object.normals = std::make_shared<std::vector<GLfloat>>();
+    object.errorLine = 0;
+    object.arenaAllocations = 0;
+    object.arenaPeak = 0;
+
+    for (const Chunk& chunk : chunks)
+    {
+        object.arenaAllocations += chunk.arenaAllocations;
+        object.arenaPeak = std::max(object.arenaPeak, chunk.arenaPeak);
+    }
+
+    for (Chunk& chunk : chunks)
+    {
+        // the first chunk with an error has the first error of the faces
+        if (!chunk.error.empty())
+        {
+            object.errorLine = chunk.errorLine;
+            object.error = chunk.error;
+            break;
+        }
+
+        object.vertices->insert(object.vertices->end(),
+            chunk.vertices.begin(), chunk.vertices.end());
+        object.texVertices->insert(object.texVertices->end(),
+            chunk.texVertices.begin(), chunk.texVertices.end());
+        object.normals->insert(object.normals->end(),
+            chunk.normals.begin(), chunk.normals.end());
+    }
+
+    // line vertices are stored after the triangles
+    size_t triangleFloats = object.vertices->size();
+
+    for (const LoadedElement& element : object.lines)
+    {
+        // a line after the first error of the faces doesn't matter
+        if (!object.error.empty() && element.line > object.errorLine)
+            break;
+
+        const ParsedLine& line = data[element.line];
+
+        try
+        {
+            for (size_t value = 1; value <= 2; value++)
+            {
+                // lines can be indexed negatively from the end, and are
+                // 1-based
+                int64_t vertIdx = parseIndex(line[value].c_str());
+                if (vertIdx < 0)
+                    vertIdx = element.vertices + vertIdx;
+                else
+                    vertIdx--;
+
+                if (vertIdx < 0 || vertIdx >= element.vertices)
+                    throw std::out_of_range("Line index");
+
+                for (int axis = 0; axis < 3; axis++)
+                    object.vertices->push_back(
+                        vertices->at(vertIdx * 3 + axis));
+            }
+        }
+        catch (std::invalid_argument& exception)
+        {
+            object.errorLine = element.line;
+            object.error = exception.what();
+            break;
+        }
+        catch (std::out_of_range&)
+        {
+            object.errorLine = element.line;
+            object.error = "Incorrect index of vertex, texture or normal";
+            break;
+        }
+    }
+
+    object.lineCount = object.vertices->size() - triangleFloats;
+}
+
+
+void GraphicsManager::renameObject(ObjectHandle object, std::string newName)
+{
+    ObjectInfo* info = findInfo(object);
+    if (info == nullptr)
+        return;
+
+    info->name = newName;
+    publish(SceneEvent::OBJECT_RENAMED, object, getObjectPosition(object));
+
+    post([this, object, newName]{
+        int dense = scene->find(object);
+        if (dense == -1)
+            return;
+
+        #ifdef DEBUG
+            std::cout << "Object name changed: "
+                << scene->getObject(dense)->objectName << " -> " << newName
+                << std::endl;
+        #endif /* DEBUG */
+
+        scene->getObject(dense)->objectName = newName;
+    });
+}
+
+
+void GraphicsManager::setObjectColor(ObjectHandle object, GLfloat r,
+    GLfloat g, GLfloat b)
+{
+    ObjectInfo* info = findInfo(object);
+    if (info == nullptr)
+        return;
+
+    info->color = glm::vec3(r, g, b);
+    publish(SceneEvent::OBJECT_APPEARANCE, object, getObjectPosition(object));
+
+    post([this, object, r, g, b]{
+        int dense = scene->find(object);
+        if (dense == -1)
+            return;
+
+        #ifdef DEBUG
+            std::cout << "Object color changed: "
+                << scene->getObject(dense)->objectName << " -> " << r << "x"
+                << g << "x" << b << std::endl;
+        #endif /* DEBUG */
+
+        scene->getObject(dense)->setColor(r, g, b);
+        scene->setTexture(dense, nullptr);
+    });
+}
+
+
+void GraphicsManager::setObjectTex(ObjectHandle object, int texIdx)
+{
+    if (findInfo(object) == nullptr)
+        return;
+
+    if (static_cast<size_t>(texIdx) >= textureNames.size())
+        return;
+
+    publish(SceneEvent::OBJECT_APPEARANCE, object, getObjectPosition(object));
+
+    post([this, object, texIdx]{
+        int dense = scene->find(object);
+        if (dense == -1)
+            return;
+
+        #ifdef DEBUG
+            std::cout << "Object texture changed: "
+                << scene->getObject(dense)->objectName << " -> "
+                << textures[texIdx]->textureName << std::endl;
+        #endif /* DEBUG */
+
+        scene->setTexture(dense, textures[texIdx]);
+    });
+}
+
+
+// the copy is listed right after the original
+void GraphicsManager::duplicateObject(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    if (info == nullptr)
+        return;
+
+    ObjectInfo copy = *info;
+    copy.name += " copy";
+    int position = info->listPosition + 1;
+
+    ObjectHandle copyHandle = objectHandles.create();
+    objectInfos.push_back(copy);
+
+    objectOrder.insert(objectOrder.begin() + position, copyHandle);
+    updateListPositions(position);
+    publish(SceneEvent::OBJECT_ADDED, copyHandle, position);
+    
+    post([this, object, copyHandle]{
+        scene->duplicate(object, copyHandle);
+        renderQueue->invalidate();
+        
+        #ifdef DEBUG
+            int dense = scene->find(object);
+            if (dense != -1)
+                std::cout << "Object duplicated: "
+                    << scene->getObject(dense)->objectName << std::endl;
+        #endif /* DEBUG */
+    });
+}
+
+
+// the other objects keep their handles, only the list positions after the
+// object move
+void GraphicsManager::deleteObject(ObjectHandle object)
+{
+    int position = getObjectPosition(object);
+    int dense = objectHandles.remove(object);
+    if (dense == -1)
+        return;
+
+    HandleTable::removeAt(objectInfos, dense);
+
+    objectOrder.erase(objectOrder.begin() + position);
+    updateListPositions(position);
+
+    // a removed object can't stay selected
+    bool selectedRemoved = selectedObject == object;
+    if (selectedRemoved)
+        selectedObject = ObjectHandle();
+
+    publish(SceneEvent::OBJECT_REMOVED, object, position);
+
+    if (selectedRemoved)
+        publish(SceneEvent::OBJECT_SELECTED, ObjectHandle(), -1);
+
+    post([this, object]{
+        #ifdef DEBUG
+            int dense = scene->find(object);
+            if (dense != -1)
+                std::cout << "Object deleted: "
+                    << scene->getObject(dense)->objectName << std::endl;
+        #endif /* DEBUG */
+
+        scene->remove(object);
+        renderQueue->invalidate();
+    });
+}
+
+
+void GraphicsManager::showOrHideObject(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    if (info == nullptr)
+        return;
+
+    bool show = !info->show;
+    info->show = show;
+    publish(SceneEvent::OBJECT_VISIBILITY, object, getObjectPosition(object));
+
+    post([this, object, show]{
+        int dense = scene->find(object);
+        if (dense == -1)
+            return;
+
+        scene->setVisible(dense, show);
+
+        #ifdef DEBUG
+            if (show)
+                std::cout << "Object showed: "
+                    << scene->getObject(dense)->objectName << std::endl;
+            else
+                std::cout << "Object hid: "
+                    << scene->getObject(dense)->objectName << std::endl;
+        #endif /* DEBUG */
+    });
+}
+
+
+// the getters return the default values for deleted objects
+bool GraphicsManager::getObjectShow(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    return info != nullptr ? info->show : false;
+}
+
+
+std::string GraphicsManager::getObjectName(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    return info != nullptr ? info->name : "";
+}
+
+
+std::tuple<GLfloat, GLfloat, GLfloat> GraphicsManager::getObjectColor(
+    ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    glm::vec3 color = info != nullptr ? info->color : glm::vec3(1.0f);
+    return std::make_tuple(color.r, color.g, color.b);
+}
+
+
+glm::vec3 GraphicsManager::getObjectPos(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    return info != nullptr ? info->position : glm::vec3(0.0f);
+}
+
+
+glm::vec3 GraphicsManager::getObjectRot(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    return info != nullptr ? info->rotation : glm::vec3(0.0f);
+}
+
+
+glm::vec3 GraphicsManager::getObjectSize(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    return info != nullptr ? info->size : glm::vec3(1.0f);
+}
+
+
+int GraphicsManager::getObjectMode(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    return info != nullptr ? info->renderMode : 0;
+}
+
+
+void GraphicsManager::setObjectPos(ObjectHandle object, glm::vec3 pos)
+{
+    ObjectInfo* info = findInfo(object);
+    if (info == nullptr)
+        return;
+
+    info->position = pos;
+    publish(SceneEvent::OBJECT_TRANSFORM, object, getObjectPosition(object));
+    post([this, object, pos]{
+        int dense = scene->find(object);
+        if (dense != -1)
+            scene->setPosition(dense, pos);
+    });
+}
+
+
+void GraphicsManager::setObjectRot(ObjectHandle object, glm::vec3 rot)
+{
+    ObjectInfo* info = findInfo(object);
+    if (info == nullptr)
+        return;
+
+    info->rotation = rot;
+    publish(SceneEvent::OBJECT_TRANSFORM, object, getObjectPosition(object));
+    post([this, object, rot]{
+        int dense = scene->find(object);
+        if (dense != -1)
+            scene->setRotation(dense, rot);
+    });
+}
+
+
+void GraphicsManager::setObjectSize(ObjectHandle object, glm::vec3 size)
+{
+    ObjectInfo* info = findInfo(object);
+    if (info == nullptr)
+        return;
+
+    info->size = size;
+    publish(SceneEvent::OBJECT_TRANSFORM, object, getObjectPosition(object));
+    post([this, object, size]{
+        int dense = scene->find(object);
+        if (dense != -1)
+            scene->setSize(dense, size);
+    });
+}
+
+
+void GraphicsManager::setObjectMode(ObjectHandle object, int mode)
+{
+    ObjectInfo* info = findInfo(object);
+    if (info == nullptr)
+        return;
+
+    info->renderMode = mode;
+    publish(SceneEvent::OBJECT_APPEARANCE, object, getObjectPosition(object));
+    post([this, object, mode]{
+        int dense = scene->find(object);
+        if (dense != -1)
+            scene->setMode(dense, mode);
+    });
+}
+
+
+// in the order of the object list
+std::vector<std::string> GraphicsManager::getAllObjectNames()
+{
+    std::vector<std::string> names;
+
+    for (ObjectHandle object : objectOrder)
+        names.push_back(findInfo(object)->name);
+    
+    return names;
+}
+
+
+int GraphicsManager::getObjectCount()
+{
+    return objectOrder.size();
+}
+
+
+// handle of the object at the position in the object list
+ObjectHandle GraphicsManager::getObjectAt(int position)
+{
+    if (static_cast<size_t>(position) >= objectOrder.size())
+        return ObjectHandle();
+
+    return objectOrder[position];
+}
+
+
+// -1 for deleted objects
+int GraphicsManager::getObjectPosition(ObjectHandle object)
+{
+    ObjectInfo* info = findInfo(object);
+    return info != nullptr ? info->listPosition : -1;
+}
+
+
+// the selection is kept by the manager, so every panel shows the same
+// object, a null handle clears it
+void GraphicsManager::selectObject(ObjectHandle object)
+{
+    if (!object.isNull() && findInfo(object) == nullptr)
+        return;
+
+    if (object == selectedObject)
+        return;
+
+    selectedObject = object;
+    publish(SceneEvent::OBJECT_SELECTED, object,
+        object.isNull() ? -1 : getObjectPosition(object));
+}
+
+
+// null handle when no object is selected
+ObjectHandle GraphicsManager::getSelectedObject()
+{
+    return selectedObject;
+}
+
+
+// returns the id used to unsubscribe, the callbacks are called by the UI
+// thread
+int GraphicsManager::subscribe(
+    std::function<void(const SceneEvent&)> callback)
+{
+    subscribers.push_back(std::make_pair(nextSubscription, callback));
+    return nextSubscription++;
+}
 
-    // loading vertex and fragment shaders
-    shaders = new ShaderManager();
-    shaders->addShader("default.vert");
-    shaders->addShader("default.frag");
-    shadersCompiled = shaders->linkProgram();
 
-    camera = new Camera();
+void GraphicsManager::unsubscribe(int subscription)
+{
+    subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+        [subscription](auto& subscriber){
+            return subscriber.first == subscription;
+        }), subscribers.end());
 }
 
 
-GraphicsManager::~GraphicsManager()
+void GraphicsManager::publish(SceneEvent::Type type, ObjectHandle object,
+    int position)
 {
-    delete shaders;
-    delete camera;
+    SceneEvent event{type, object, position};
+
+    // a subscriber can subscribe another one, so the vector can grow
+    for (size_t i = 0; i < subscribers.size(); i++)
+        subscribers[i].second(event);
 }
 
 
-GLuint GraphicsManager::getShadersID() 
+// returns the index of the texture, an identical image which is already
+// in the library is returned instead of being added again
+int GraphicsManager::addTexture(const unsigned char* data, int width,
+    int height, std::string name)
 {
-    return shaders->getID();
+    // the image is owned by the caller, so it has to be copied before it is
+    // uploaded by the render thread
+    std::shared_ptr<TextureImage> image =
+        TextureImage::fromRGB(data, width, height);
+
+    int idx = findTexture(image->hash);
+    if (idx != -1)
+        return idx;
+
+    setTextureImage(reserveTexture(name, image->hash), image);
+    return textureNames.size() - 1;
 }
 
 
-bool GraphicsManager::getShadersCompiled()
+void GraphicsManager::setTextureBudget(size_t megabytes)
 {
-    return shadersCompiled;
+    textureBudget = megabytes;
+    post([this, megabytes]{
+        streamer->setBudget(megabytes * 1024 * 1024);
+    });
 }
 
 
-void GraphicsManager::render()
+// in megabytes
+size_t GraphicsManager::getTextureBudget()
 {
-    // clear the background and z-buffer
-    glClearColor(0.135f, 0.135f, 0.135f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return textureBudget;
+}
 
-    shaders->useProgram();
 
-    camera->move(parentCanvas->getMouseInfo());
+// the hash identifies the image of the texture, -1 if it isn't loaded
+int GraphicsManager::findTexture(uint64_t hash)
+{
+    for (size_t idx = 0; idx < textureHashes.size(); idx++)
+        if (textureHashes[idx] == hash)
+            return idx;
 
-    setUniformMatrix(camera->viewMatrix(), "view");
-    setUniformMatrix(camera->projectionMatrix(
-        parentCanvas->viewportAspectRatio()), "projection");
-    
-    setUniformVector(lightColor, "lightColor");
-    setUniformVector(camera->getPos(), "lightPos");
+    return -1;
+}
 
-    for (auto it = objects.begin(); it != objects.end(); it++)
-        if ((*it)->show)
-            (*it)->draw();
-        
-    // Nvidia warns about performance without this call
-    // https://stackoverflow.com/a/15079431
-    glUseProgram(0);
 
-    // CPU waits for the GPU to execute everything
-    glFinish();
+// the hash of the file the texture was opened from, -1 if it isn't loaded
+int GraphicsManager::findTextureFile(uint64_t fileHash)
+{
+    for (size_t idx = 0; idx < textureFileHashes.size(); idx++)
+        if (fileHash != 0 && textureFileHashes[idx] == fileHash)
+            return idx;
+
+    return -1;
 }
 
 
-void GraphicsManager::setUniformMatrix(glm::mat4 mat, const char* name)
+// the texture is shown as a placeholder until its image is set, the
+// returned key identifies it even when other textures are deleted, the
+// hash of an image which isn't decoded yet is set later
+int GraphicsManager::reserveTexture(std::string name, uint64_t hash)
 {
-    int location = glGetUniformLocation(shaders->getID(), name);
-    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(mat));
+    int key = nextTextureKey++;
+    textureNames.push_back(name);
+    textureKeys.push_back(key);
+    textureHashes.push_back(hash);
+    textureFileHashes.push_back(0);
+
+    post([this, name, key]{
+        std::shared_ptr<Texture> texture =
+            std::make_shared<Texture>(name, key);
+        placeTexture(texture, placeholderImage, placeholder);
+        textures.push_back(texture);
+    });
+
+    return key;
 }
 
 
-void GraphicsManager::newObject(std::string file, size_t startLine,
-    std::shared_ptr<std::vector<std::vector<std::string>>> data,
-    std::shared_ptr<std::vector<GLfloat>> vertices,
-    std::shared_ptr<std::vector<GLfloat>> texVertices,
-    std::shared_ptr<std::vector<GLfloat>> normals)
+// the UI thread is told the hashes when the reserved texture is decoded, a
+// file which is already in the library is removed from it again, the image
+// was set before, so the objects which were given the texture meanwhile
+// keep it and share its layer with the other texture
+void GraphicsManager::setTextureHash(int key, uint64_t hash,
+    uint64_t fileHash)
 {
-    if (data == nullptr)
-        data = std::make_shared<std::vector<std::vector<std::string>>>(
-            parseFile(file));
+    int idx = -1;
+    for (size_t i = 0; i < textureKeys.size(); i++)
+        if (textureKeys[i] == key)
+            idx = i;
 
-    std::string keyword;
-    std::vector<std::tuple<int, int, int>> faceData;
-    std::pair<int, int> lineData;
+    if (idx == -1)
+        return;
 
-    // to save memory all recursive calls use the same data
-    if (vertices == nullptr)
-        vertices = std::make_shared<std::vector<GLfloat>>();
+    int existing = findTextureFile(fileHash);
+    if (existing != -1 && existing != idx)
+    {
+        deleteTexture(idx);
+        return;
+    }
 
-    if (texVertices == nullptr)
-        texVertices = std::make_shared<std::vector<GLfloat>>();
+    textureHashes[idx] = hash;
+    textureFileHashes[idx] = fileHash;
+}
 
-    if (normals == nullptr)
-        normals = std::make_shared<std::vector<GLfloat>>();
 
-    // all final arrays are only for 1 object
-    // they are not shared between objects in the same file
-    std::shared_ptr<std::vector<GLfloat>> finalLineVertices =
-        std::make_shared<std::vector<GLfloat>>();
-    std::shared_ptr<std::vector<GLfloat>> finalVertices =
-        std::make_shared<std::vector<GLfloat>>();
-    std::shared_ptr<std::vector<GLfloat>> finalTextures =
-        std::make_shared<std::vector<GLfloat>>();
-    std::shared_ptr<std::vector<GLfloat>> finalNormals =
-        std::make_shared<std::vector<GLfloat>>();
+// can be called from any thread, so the images can be decoded by workers,
+// different files with the same pixels share the image on the GPU
+void GraphicsManager::setTextureImage(int key,
+    std::shared_ptr<TextureImage> image)
+{
+    post([this, key, image]{
+        std::shared_ptr<Texture> target;
+        for (auto& texture : textures)
+            if (texture->getKey() == key)
+                target = texture;
 
-    std::string name = "New Object";
-    bool nameModified = false;
+        if (target == nullptr)
+            return;
 
-    std::vector<std::string> line;
-    glm::vec3 normal;
+        target->setSource(image);
 
-    for (size_t lineIdx = startLine; lineIdx < data->size(); lineIdx++)
-    {
-        try
-        {
-            line = data->at(lineIdx);
-            keyword = line.front();
-            
-            // vertex
-            if (keyword == "v")
-            {
-                // v x-coord y-coord z-coord
-                if (line.size() != 4)
-                    throw std::invalid_argument(
-                        "Incorrect number of axes in space (expected 3)");
-                
-                for (size_t i = 1; i < line.size(); i++)
-                    vertices->push_back(std::stof(line[i]));
-            }
-            // texture vertex
-            else if (keyword == "vt")
-            {
-                // vt x-coord y-coord
-                if (line.size() != 3)
-                    throw std::invalid_argument(
-                        "Incorrect number of axes in texture (expected 2)");
-                
-                for (size_t i = 1; i < line.size(); i++)
-                    texVertices->push_back(std::stof(line[i]));
-            }
-            // vertex normal
-            else if (keyword == "vn")
+        for (auto& texture : textures)
+            if (texture != target && texture->getHash() == image->hash)
             {
-                // vn x-coord y-coord z-coord
-                if (line.size() != 4)
-                    throw std::invalid_argument(
-                        "Incorrect number of axes in normal vec. (expected 3)");
-                
-                for (size_t i = 1; i < line.size(); i++)
-                    normals->push_back(std::stof(line[i]));
+                target->shareLayer(*texture);
+                return;
             }
-            // face
-            else if (keyword == "f")
-            {
-                // f vertex1/texture1/normal1 vertex2/texture2/normal2...
-                if (line.size() < 4)
-                    throw std::invalid_argument(
-                        "Incorrect number of vertices in face (expected >=3)");
-                
-                faceData = parseFace(vertices->size()/3, line);
 
-                triangulate(&faceData, vertices, &normal);
-                
-                for (std::vector<std::tuple<int, int, int>>::iterator it =
-                    faceData.begin(); it != faceData.end(); it++)
-                {
-                    finalVertices->push_back(
-                        vertices->at(std::get<0>(*it) * 3));
-                    finalVertices->push_back(
-                        vertices->at(std::get<0>(*it) * 3 + 1));
-                    finalVertices->push_back(
-                        vertices->at(std::get<0>(*it) * 3 + 2));
+        target->setStreamingLevel(image->baseLevel);
+        uploader->add(target, image);
+    });
+}
 
-                    // if texture vertices are not included in the file
-                    if (std::get<1>(*it) == -1)
-                    {
-                        finalTextures->push_back(-1);
-                        finalTextures->push_back(-1);
-                    }
-                    else
-                    {
-                        finalTextures->push_back(
-                            texVertices->at(std::get<1>(*it) * 2));
-                        finalTextures->push_back(
-                            texVertices->at(std::get<1>(*it) * 2 + 1));
-                    }
-                        
-                    // if normals are not included in the file
-                    if (std::get<2>(*it) == -1)
-                    {
-                        finalNormals->push_back(normal.x);
-                        finalNormals->push_back(normal.y);
-                        finalNormals->push_back(normal.z);
-                    }
-                    else
-                    {
-                        finalNormals->push_back(
-                            normals->at(std::get<2>(*it) * 3));
-                        finalNormals->push_back(
-                            normals->at(std::get<2>(*it) * 3 + 1));
-                        finalNormals->push_back(
-                            normals->at(std::get<2>(*it) * 3 + 2));
-                    }
-                }
-            }
-            // line
-            else if (keyword == "l")
-            {
-                // l vertex1 vertex2
-                if (line.size() != 3)
-                    throw std::invalid_argument(
-                        "Incorrect number of vertices in line (expected 2)");
-                
-                lineData = std::make_pair(
-                    std::stoi(line[1]), std::stoi(line[2]));
-                
-                for (int vertIdx : {lineData.first, lineData.second})
-                {
-                    if (vertIdx < 0)
-                        vertIdx = vertices->size() + vertIdx;
-                    else
-                        vertIdx--;
-
-                    finalLineVertices->push_back(
-                        vertices->at(vertIdx * 3));
-                    finalLineVertices->push_back(
-                        vertices->at(vertIdx * 3 + 1));
-                    finalLineVertices->push_back(
-                        vertices->at(vertIdx * 3 + 2));
-                }
-            }
-            // object name
-            else if (keyword == "o")
-            {
-                // o partOfName1 partOfName2...
-                if (line.size() == 1)
-                    throw std::invalid_argument("The name is missing");
-                
-                // recursively call this function if there is another object
-                if (nameModified)
-                {
-                    newObject(file, lineIdx, data, vertices, texVertices,
-                        normals);
-                    break;
-                }
 
-                name.clear();
-                for (size_t i = 1; i < line.size(); i++)
-                    name += line[i];
-                nameModified = true;
-            }
-        }
-        catch (std::invalid_argument& exception)
-        {
-            // invalid_argument can be non-number characters in stof
-            // or manually thrown incompatible number of parameters
-            #ifdef DEBUG
-                std::cout << "Object loading error: " << exception.what()
-                    << std::endl;
-            #endif /* DEBUG */
-            parentCanvas->showErrorMessage("Object loading error", "In file '" +
-                file + "' an error has occurred on line " + 
-                std::to_string(lineIdx + 1) + ":\n" + exception.what());
-            return;
-        }
-        catch (std::out_of_range& exception)
+// the texture goes to the first array of the same size with a free layer,
+// a new array is created when there is none
+void GraphicsManager::placeTexture(std::shared_ptr<Texture> texture,
+    GLuint image, std::shared_ptr<TextureImage> data)
+{
+    bool generateMipmaps = data->levels.size() == 1;
+
+    for (auto& array : textureArrays)
+    {
+        if (!array->matches(data->width, data->height, data->format))
+            continue;
+
+        int layer = array->addLayer(image, generateMipmaps);
+        if (layer != -1)
         {
-            // this exception is triggered when line or faces includes
-            // non-existent vertex, texture coordinate or normal
-            #ifdef DEBUG
-                std::cout << "Object loading error: " << exception.what()
-                    << std::endl;
-            #endif /* DEBUG */
-            parentCanvas->showErrorMessage("Object loading error", "In file '" +
-                file + "' an error has occurred on line " + 
-                std::to_string(lineIdx + 1) + ":\n" +
-                "Incorrect index of vertex, texture or normal");
+            texture->setLayer(array, layer, data);
             return;
         }
     }
 
-    // the name has to fit inside the wxCheckListBox
-    if (name.size() > 24)
-        name.resize(24);
-    
-    // add all line vertices to the end of finalVertices
-    finalVertices->insert(finalVertices->end(),
-        finalLineVertices->begin(), finalLineVertices->end());
-
-    objects.push_back(std::make_unique<Object>(this, name,
-        finalLineVertices->size(), finalVertices, finalTextures,
-        finalNormals));
-    
-    #ifdef DEBUG
-        std::cout << "Object added: " << name << std::endl;
-    #endif /* DEBUG */
+    textureArrays.push_back(std::make_shared<TextureArray>(data->width,
+        data->height, data->format));
+    texture->setLayer(textureArrays.back(),
+        textureArrays.back()->addLayer(image, generateMipmaps), data);
 }
 
 
-void GraphicsManager::renameObject(int idx, std::string newName)
+void GraphicsManager::deleteTexture(int idx)
 {
-    #ifdef DEBUG
-        std::cout << "Object name changed: " << objects[idx]->objectName
-            << " -> " << newName << std::endl;
-    #endif /* DEBUG */
+    if (static_cast<size_t>(idx) >= textureNames.size())
+        return;
 
-    objects[idx]->objectName = newName;
-}
+    textureNames.erase(textureNames.begin() + idx);
+    textureKeys.erase(textureKeys.begin() + idx);
+    textureHashes.erase(textureHashes.begin() + idx);
+    textureFileHashes.erase(textureFileHashes.begin() + idx);
 
+    publish(SceneEvent::TEXTURE_REMOVED, ObjectHandle(), idx);
 
-void GraphicsManager::setObjectColor(int idx, GLfloat r, GLfloat g, GLfloat b)
-{
-    #ifdef DEBUG
-        std::cout << "Object color changed: " << objects[idx]->objectName 
-            << " -> " << r << "x" << g << "x" << b << std::endl;
-    #endif /* DEBUG */
+    // objects using the texture keep it until they are given another one,
+    // the layer is freed when no texture uses it
+    post([this, idx]{
+        textures.erase(textures.begin() + idx);
 
-    objects[idx]->setColor(r, g, b);
-    objects[idx]->tex = nullptr;
+        // arrays no texture refers to anymore are freed
+        textureArrays.erase(std::remove_if(textureArrays.begin(),
+            textureArrays.end(), [](std::shared_ptr<TextureArray>& array){
+                return array.use_count() == 1;
+            }), textureArrays.end());
+    });
 }
 
 
-void GraphicsManager::setObjectTex(int idx, std::shared_ptr<Texture> tex)
+std::vector<std::string> GraphicsManager::getAllTextureNames()
 {
-    #ifdef DEBUG
-        std::cout << "Object texture changed: " << objects[idx]->objectName
-            << " -> " << tex->textureName << std::endl;
-    #endif /* DEBUG */
-
-    objects[idx]->tex = tex;
+    return textureNames;
 }
 
 
-void GraphicsManager::duplicateObject(int idx)
+// the report is made by the render thread, which owns the objects and the
+// textures, the callback is called there too
+void GraphicsManager::requestMemoryReport(
+    std::function<void(std::shared_ptr<MemoryReport>)> callback)
 {
-    // integer is cast to size_t, so the compiler doesn't flag this with
-    // a warning; GetSelection() from wxCheckListBox returns int anyway
-    if (static_cast<size_t>(idx) >= objects.size())
-        return;
+    post([this, callback]{
+        std::shared_ptr<MemoryReport> report =
+            std::make_shared<MemoryReport>();
+        report->readCounters();
 
-    int newObjectIdx = idx + 1;
-    
-    objects.insert(objects.begin() + newObjectIdx,
-        std::make_unique<Object>(*objects[idx]));
-    
-    #ifdef DEBUG
-        std::cout << "Object duplicated: " << objects[idx]->objectName
-            << std::endl;
-    #endif /* DEBUG */
+        for (size_t dense = 0; dense < scene->size(); dense++)
+        {
+            Object* object = scene->getObject(dense);
+            report->objects.push_back(MemoryReport::Entry{object->objectName,
+                object->getCPUMemory(), object->getGPUMemory()});
+        }
+
+        for (std::shared_ptr<Texture>& texture : textures)
+            report->textures.push_back(MemoryReport::Entry{
+                texture->textureName, texture->getCPUMemory(),
+                texture->getGPUMemory()});
+
+        callback(report);
+    });
 }
 
 
-void GraphicsManager::deleteObject(int idx)
+// the UI thread fills in the properties of the objects, the render thread
+// adds their geometry and the textures, the callback is called there
+void GraphicsManager::requestSceneFile(
+    std::function<void(std::shared_ptr<SceneFile>)> callback)
 {
-    if (static_cast<size_t>(idx) >= objects.size())
-        return;
+    std::shared_ptr<SceneFile> saved = std::make_shared<SceneFile>();
+    std::vector<ObjectHandle> handles = objectOrder;
 
-    #ifdef DEBUG
-        std::cout << "Object deleted: " << objects[idx]->objectName
-            << std::endl;
-    #endif /* DEBUG */
+    for (ObjectHandle object : objectOrder)
+    {
+        ObjectInfo* info = findInfo(object);
+
+        SceneFile::ObjectEntry entry;
+        entry.name = info->name;
+        entry.show = info->show;
+        entry.color = info->color;
+        entry.position = info->position;
+        entry.rotation = info->rotation;
+        entry.size = info->size;
+        entry.renderMode = info->renderMode;
+        entry.texture = -1;
+        entry.lineCount = 0;
+        entry.boundingRadius = 0.0f;
+        entry.vertices = std::make_shared<std::vector<GLfloat>>();
+        saved->objects.push_back(entry);
+    }
+
+    post([this, saved, handles, callback]{
+        // textures still waiting for their image are left out, the objects
+        // using them keep only their color
+        std::unordered_map<Texture*, int> textureIndices;
+        for (std::shared_ptr<Texture>& texture : textures)
+            if (texture->getSource() != nullptr)
+            {
+                textureIndices[texture.get()] = saved->textures.size();
+                saved->textures.push_back(SceneFile::TextureEntry{
+                    texture->textureName, texture->getSource()});
+            }
+
+        size_t vertexBytes = 0;
+        for (size_t i = 0; i < handles.size(); i++)
+        {
+            int dense = scene->find(handles[i]);
+            if (dense == -1)
+                continue;
+
+            Object* object = scene->getObject(dense);
+            SceneFile::ObjectEntry& entry = saved->objects[i];
+            entry.lineCount = object->getLineCount();
+            entry.boundingRadius = object->getBoundingRadius();
+            entry.vertices->assign(object->getVertexData(),
+                object->getVertexData() + object->getVertexDataLength());
+            vertexBytes += entry.vertices->size() * sizeof(GLfloat);
+
+            auto texture = textureIndices.find(scene->getTexture(dense));
+            if (texture != textureIndices.end())
+                entry.texture = texture->second;
+        }
 
-    objects.erase(objects.begin() + idx);
+        saved->memory.resize(vertexBytes);
+        callback(saved);
+    });
 }
 
 
-void GraphicsManager::showOrHideObject(int idx)
+// the objects are added after the existing ones, textures which are already
+// loaded are reused
+void GraphicsManager::restoreScene(std::shared_ptr<SceneFile> saved)
 {
-    if (static_cast<size_t>(idx) >= objects.size())
-        return;
+    PROFILE_SCOPE("restoreScene");
 
-    if (objects[idx]->show)
+    std::vector<int> textureIndices;
+    for (SceneFile::TextureEntry& entry : saved->textures)
     {
-        objects[idx]->show = false;
-
-        #ifdef DEBUG
-            std::cout << "Object hid: " << objects[idx]->objectName
-                << std::endl;
-        #endif /* DEBUG */
+        int idx = findTexture(entry.image->hash);
+        if (idx == -1)
+        {
+            setTextureImage(reserveTexture(entry.name, entry.image->hash),
+                entry.image);
+            idx = textureNames.size() - 1;
+        }
+        textureIndices.push_back(idx);
     }
-    else
-    {
-        objects[idx]->show = true;
 
-        #ifdef DEBUG
-            std::cout << "Object showed: " << objects[idx]->objectName
-                << std::endl;
-        #endif /* DEBUG */
+    std::vector<ObjectHandle> handles;
+    for (SceneFile::ObjectEntry& entry : saved->objects)
+    {
+        ObjectInfo info(entry.name);
+        info.show = entry.show;
+        info.color = entry.color;
+        info.position = entry.position;
+        info.rotation = entry.rotation;
+        info.size = entry.size;
+        info.renderMode = entry.renderMode;
+
+        ObjectHandle object = objectHandles.create();
+        info.listPosition = objectOrder.size();
+        objectInfos.push_back(info);
+        objectOrder.push_back(object);
+        handles.push_back(object);
+        publish(SceneEvent::OBJECT_ADDED, object, objectOrder.size() - 1);
     }
-}
 
+    // a single command uploads the whole scene
+    post([this, saved, handles, textureIndices]{
+        for (size_t i = 0; i < handles.size(); i++)
+        {
+            SceneFile::ObjectEntry& entry = saved->objects[i];
 
-bool GraphicsManager::getObjectShow(int idx)
-{
-    return objects[idx]->show;
-}
+            scene->add(handles[i], std::make_unique<Object>(this, entry.name,
+                entry.lineCount, entry.vertices, entry.boundingRadius,
+                entry.color));
 
+            int dense = scene->size() - 1;
+            scene->setVisible(dense, entry.show);
+            scene->setTransform(dense, entry.position, entry.rotation,
+                entry.size);
+            scene->setMode(dense, entry.renderMode);
 
-std::string GraphicsManager::getObjectName(int idx)
-{
-    return objects[idx]->objectName;
-}
+            if (entry.texture != -1)
+                scene->setTexture(dense,
+                    textures[textureIndices[entry.texture]]);
+        }
 
+        renderQueue->invalidate();
 
-std::tuple<GLfloat, GLfloat, GLfloat> GraphicsManager::getObjectColor(int idx)
-{
-    return objects[idx]->getColor();
+        #ifdef DEBUG
+            std::cout << "Scene restored: " << handles.size() << " objects"
+                << std::endl;
+        #endif /* DEBUG */
+    });
 }
 
 
-glm::vec3* GraphicsManager::getObjectPosVec(int idx)
+// commands are executed by the render thread before the next frame
+void GraphicsManager::post(std::function<void()> command)
 {
-    return &objects[idx]->position;
+    commands->push(command);
+    requestRender();
 }
 
 
-glm::vec3* GraphicsManager::getObjectRotVec(int idx)
+// gray checkerboard shown until the image of a texture is uploaded
+void GraphicsManager::createPlaceholder()
 {
-    return &objects[idx]->rotation;
-}
-
+    unsigned char data[placeholderSize * placeholderSize * 3];
+    for (int y = 0; y < placeholderSize; y++)
+        for (int x = 0; x < placeholderSize; x++)
+        {
+            bool light = ((x / 4) + (y / 4)) % 2 == 0;
+            for (int channel = 0; channel < 3; channel++)
+                data[(y * placeholderSize + x) * 3 + channel] =
+                    light ? 160 : 96;
+        }
 
-glm::vec3* GraphicsManager::getObjectSize(int idx)
-{
-    return &objects[idx]->size;
+    placeholder = TextureImage::fromRGB(data, placeholderSize,
+        placeholderSize);
+    placeholderImage = TextureArray::createImage(placeholderSize,
+        placeholderSize, GL_RGB8);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage2D(placeholderImage, 0, 0, 0, placeholderSize,
+        placeholderSize, GL_RGB, GL_UNSIGNED_BYTE, data);
 }
 
 
-int* GraphicsManager::getObjectMode(int idx)
+void GraphicsManager::createFrameResources()
 {
-    return &objects[idx]->renderMode;
-}
+    // https://www.khronos.org/opengl/wiki/Buffer_Object#Persistent_mapping
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+        GL_MAP_COHERENT_BIT;
 
+    for (FrameResources& frame : frames)
+    {
+        frame.fence = 0;
+        frame.queriesPending = false;
 
-std::vector<std::string> GraphicsManager::getAllObjectNames()
-{
-    std::vector<std::string> names;
+        glCreateBuffers(1, &frame.uniformBuffer);
+        glNamedBufferStorage(frame.uniformBuffer, sizeof(FrameUniforms),
+            nullptr, flags);
+        frame.uniforms = static_cast<FrameUniforms*>(glMapNamedBufferRange(
+            frame.uniformBuffer, 0, sizeof(FrameUniforms), flags));
 
-    for (auto it = objects.begin(); it != objects.end(); it++)
-        names.push_back((*it)->objectName);
-    
-    return names;
+        glCreateQueries(GL_TIMESTAMP, 2, frame.timeQueries);
+        frame.timers = new GPUTimers();
+    }
 }
 
 
-void GraphicsManager::addTexture(const unsigned char* data, int width,
-    int height, std::string name)
+void GraphicsManager::waitForFrame(FrameResources& frame)
 {
-    textures.push_back(
-        std::make_shared<Texture>(data, width, height, name));
-}
+    if (frame.fence != 0)
+    {
+        // the first wait flushes the commands, so the fence can be signaled
+        GLenum result = glClientWaitSync(frame.fence,
+            GL_SYNC_FLUSH_COMMANDS_BIT, 0);
 
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(frame.fence, 0, 1000000);
 
-void GraphicsManager::deleteTexture(int idx)
-{
-    textures.erase(textures.begin() + idx);
-}
+        glDeleteSync(frame.fence);
+        frame.fence = 0;
+    }
 
+    // the GPU has finished the frame, so its queries are available
+    if (frame.queriesPending)
+    {
+        GLuint64 start, end;
+        glGetQueryObjectui64v(frame.timeQueries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame.timeQueries[1], GL_QUERY_RESULT, &end);
 
-std::shared_ptr<Texture> GraphicsManager::getTexPtr(int idx)
-{
-    if (static_cast<size_t>(idx) > textures.size())
-        return nullptr;
-    
-    return textures[idx];
+        GPUFrameTime = (end - start) / 1000000.0f;
+        frame.queriesPending = false;
+    }
+
+    frame.timers->collect();
 }
 
 
-std::vector<std::string> GraphicsManager::getAllTextureNames()
+// nullptr for handles of deleted objects
+ObjectInfo* GraphicsManager::findInfo(ObjectHandle object)
 {
-    std::vector<std::string> names;
-
-    for (std::shared_ptr<Texture> texture : textures)
-        names.push_back(texture->textureName);
-    
-    return names;
+    int dense = objectHandles.find(object);
+    return dense != -1 ? &objectInfos[dense] : nullptr;
 }
 
 
-void GraphicsManager::setUniformVector(glm::vec3 vec, const char* name)
+// the objects from the position to the end of the list moved after an
+// insertion or a removal
+void GraphicsManager::updateListPositions(size_t first)
 {
-    int location = glGetUniformLocation(shaders->getID(), name);
-    glUniform3f(location, vec.x, vec.y, vec.z);
+    for (size_t position = first; position < objectOrder.size(); position++)
+        findInfo(objectOrder[position])->listPosition = position;
 }
 
 
-std::vector<std::vector<std::string>> GraphicsManager::parseFile(
-    std::string name)
+GraphicsManager::ParsedFile GraphicsManager::parseFile(std::string name,
+    Arena& arena)
 {
+    PROFILE_SCOPE("parseFile");
+
     std::ifstream fileStream(name);
 
     // every line is separate vector and each block of characters separated by
     // spaces is in separate strings
-    std::vector<std::vector<std::string>> fileVector;
+    ParsedFile fileVector{ArenaAllocator<ParsedLine>(arena)};
 
     std::string tempLine, tempSegment;
     std::stringstream lineStream;
-    std::vector<std::string> lineVector;
+    ParsedLine lineVector{ArenaAllocator<ArenaString>(arena)};
     
     bool backSlash;
 
@@ -526,14 +1855,17 @@ std::vector<std::vector<std::string>> GraphicsManager::parseFile(
 
         while(std::getline(lineStream, tempSegment, ' '))
         {
+            if (tempSegment.empty())
+                continue;
+
             if (tempSegment.front() == '#')
             {
                 lineStream.ignore(std::numeric_limits<std::streamsize>::max());
                 break;
             }
 
-            if (!tempSegment.empty())
-                lineVector.push_back(tempSegment);
+            lineVector.emplace_back(tempSegment.data(), tempSegment.size(),
+                ArenaAllocator<char>(arena));
         }
         
         lineStream.clear();
@@ -550,7 +1882,9 @@ std::vector<std::vector<std::string>> GraphicsManager::parseFile(
                             lineVector.erase(lineVector.begin() + i);
                     }
         
-        fileVector.push_back(lineVector);
+        // the vector is moved with its arena, the cleared one gets a new
+        // buffer from the same arena
+        fileVector.push_back(std::move(lineVector));
         lineVector.clear();
     }
 
@@ -558,36 +1892,41 @@ std::vector<std::vector<std::string>> GraphicsManager::parseFile(
 }
 
 
-std::vector<std::tuple<int, int, int>> GraphicsManager::parseFace(
-    size_t vertices, std::vector<std::string> data)
+GraphicsManager::FaceIndices GraphicsManager::parseFace(
+    size_t vertices, const ParsedLine& data, Arena& arena)
 {
     // first - vert idx, second - texture vert idx, third - vert normal idx
-    std::vector<std::tuple<int, int, int>> ret;
-
-    std::stringstream valueStream;
-    std::string tempValue;
+    FaceIndices ret{
+        ArenaAllocator<std::tuple<int64_t, int64_t, int64_t>>(arena)};
+    ret.reserve(data.size() - 1);
 
-    int dataIdx, saveValue;
+    int dataIdx;
+    int64_t saveValue;
 
     for (size_t i = 1; i < data.size(); i++)
     {
-        valueStream << data[i];
+        const ArenaString& segment = data[i];
+        size_t start = 0;
         dataIdx = 0;
         ret.push_back(std::make_tuple(-1, -1, -1));
 
-        while (std::getline(valueStream, tempValue, '/'))
+        // the values are separated by slashes, the empty ones are skipped
+        while (start < segment.size())
         {
-            if (tempValue.empty())
+            size_t end = std::min(segment.find('/', start), segment.size());
+
+            if (end == start)
             {
                 dataIdx++;
+                start = end + 1;
                 continue;
             }
 
-            saveValue = std::stoi(tempValue);
+            saveValue = parseIndex(segment.c_str() + start);
 
             // faces can be indexed negatively from the end, and are 1-based
             if (saveValue < 0)
-                saveValue = vertices + saveValue;
+                saveValue += static_cast<int64_t>(vertices);
             else
                 saveValue--;
 
@@ -606,8 +1945,8 @@ std::vector<std::tuple<int, int, int>> GraphicsManager::parseFace(
                     break;
             }
             dataIdx++;
+            start = end + 1;
         }
-        valueStream.clear();
     }
 
     return ret;
@@ -616,10 +1955,12 @@ std::vector<std::tuple<int, int, int>> GraphicsManager::parseFace(
 
 // using ear-clipping method; used algorithm explanation:
 // https://www.geometrictools.com/Documentation/TriangulationByEarClipping.pdf
-void GraphicsManager::triangulate(
-    std::vector<std::tuple<int, int, int>>* indices,
-    std::shared_ptr<std::vector<GLfloat>> allVertices, glm::vec3* normalVec)
+void GraphicsManager::triangulate(FaceIndices* indices,
+    std::shared_ptr<std::vector<GLfloat>> allVertices, glm::vec3* normalVec,
+    Arena& arena)
 {
+    PROFILE_SCOPE("triangulate");
+
     struct vertex
     {
         glm::vec3 pos;
@@ -627,7 +1968,10 @@ void GraphicsManager::triangulate(
         vertex(glm::vec3 vec, unsigned int index) : pos(vec), idx(index) {}
     };
 
-    std::list<vertex> verticesList;
+    typedef std::list<vertex, ArenaAllocator<vertex>> VertexList;
+    typedef ArenaVector<vertex> VertexVector;
+
+    VertexList verticesList{ArenaAllocator<vertex>(arena)};
 
     // get positions of the vertices in the list
     for (size_t i = 0; i < indices->size(); i++)
@@ -639,8 +1983,8 @@ void GraphicsManager::triangulate(
     }
     
     // delete duplicates
-    std::list<vertex>::iterator delIt = verticesList.begin();
-    std::list<vertex>::iterator checkIt;
+    VertexList::iterator delIt = verticesList.begin();
+    VertexList::iterator checkIt;
     while (delIt != verticesList.end())
     {
         checkIt = verticesList.begin();
@@ -654,18 +1998,18 @@ void GraphicsManager::triangulate(
         delIt++;
     }
 
-    std::list<vertex>::iterator it = verticesList.begin();
+    VertexList::iterator it = verticesList.begin();
 
     // map is used to store indices from which are constructed the triangles
-    std::vector<GLuint> map;
+    ArenaVector<GLuint> map{ArenaAllocator<GLuint>(arena)};
 
     // to get oriented angle in the face a reference axis is needed
     *normalVec = glm::normalize(glm::cross(it->pos - std::next(it, 1)->pos,
         std::next(it, 2)->pos - std::next(it, 1)->pos));
     
     bool outside, skip;
-    std::vector<vertex> triangleVertices;
-    std::vector<vertex>::iterator prev, next;
+    VertexVector triangleVertices{ArenaAllocator<vertex>(arena)};
+    VertexVector::iterator prev, next;
     glm::vec3 vecToPrev, vecToNext, referenceVec, testVec;
     float referenceAngle, testAngle;
 
@@ -696,7 +2040,7 @@ void GraphicsManager::triangulate(
             triangleVertices.push_back(*std::next(it, 1));
 
         // test each vertex if it lies inside the triangle
-        for (std::list<vertex>::iterator testIt = verticesList.begin();
+        for (VertexList::iterator testIt = verticesList.begin();
             testIt != verticesList.end(); testIt++)
         {
             // skip vertices which define the tested triangle
@@ -897,3 +2241,32 @@ glm::vec3 Camera::getPos()
 {
     return target - toTarget;
 }
+
+
+float Camera::getFarClip()
+{
+    return farClipBorder;
+}
+
+
+CameraPose Camera::getPose()
+{
+    CameraPose pose;
+    pose.yaw = yaw;
+    pose.pitch = pitch;
+    pose.radius = radius;
+    pose.target = target;
+    return pose;
+}
+
+
+void Camera::setPose(CameraPose pose)
+{
+    yaw = pose.yaw;
+    pitch = pose.pitch;
+    radius = pose.radius;
+    target = pose.target;
+
+    horizMove = 0.0f;
+    vertiMove = 0.0f;
+}
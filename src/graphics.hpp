@@ -1,28 +1,47 @@
 #ifndef GRAPHICS_HPP_
 #define GRAPHICS_HPP_
 
-#include "main.hpp"
+#include "shaders.hpp"
+#include "vertices.hpp"
+#include "commands.hpp"
+#include "profiler.hpp"
+#include "benchmark.hpp"
+#include "renderqueue.hpp"
+#include "glstate.hpp"
+#include "uploader.hpp"
+#include "teximage.hpp"
+#include "streamer.hpp"
+#include "memory.hpp"
+#include "hud.hpp"
+#include "scene.hpp"
+#include "scenefile.hpp"
+#include "jobs.hpp"
+#include "kernels.hpp"
+#include "arena.hpp"
+
+#ifdef DEBUG
+    #include <iostream>
+#endif /* DEBUG */
 
-#include <wx/timer.h>
 #include <GL/glew.h>
-#include <GL/wglew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/vector_angle.hpp>
+#include <cstdint>
 #include <sstream>
 #include <string>
 #include <memory>
 #include <fstream>
 #include <vector>
+#include <deque>
 #include <list>
+#include <functional>
 
 #ifdef DEBUG
     #include "GLDebugMessageCallback.h"
 #endif /* DEBUG */
 
-class MainFrame;
-class Canvas;
 class ShaderManager;
 class VertexBuffer;
 class ElementBuffer;
@@ -30,63 +49,319 @@ class VertexArray;
 class Camera;
 class Object;
 class Texture;
-struct MouseInfo;
+class TextureArray;
+class TextureUploader;
+class TextureStreamer;
+struct TextureImage;
+class CommandQueue;
+class GPUTimers;
+class Benchmark;
+class CameraPath;
+class RenderQueue;
+struct CameraPose;
+struct MemoryReport;
+class HUD;
+struct FontAtlas;
+class Scene;
+struct SceneFile;
+
+
+struct MouseInfo
+{
+    bool spinning;
+    bool moving;
+    glm::ivec2 mousePos;
+    int wheelPos;
+};
+
+
+// the window (or the offscreen context) the manager renders into
+class RenderHost
+{
+public:
+    virtual ~RenderHost() {}
+
+    virtual void requestRender() = 0;
+    virtual void showErrorMessage(std::string title, std::string msg) = 0;
+};
+
+
+// copy of the object's properties for the UI thread, the render thread works
+// with its own Object and is told about every change through a command
+struct ObjectInfo
+{
+    std::string name;
+    bool show;
+    glm::vec3 color;
+    glm::vec3 position;
+    glm::vec3 rotation;
+    glm::vec3 size;
+    int renderMode;
+    // index in the object list, the manager keeps it up to date
+    int listPosition;
+
+    ObjectInfo(std::string objectName);
+};
+
+
+// change of the scene made by the UI thread, the subscribers are called right
+// after the change, so they update only what changed
+struct SceneEvent
+{
+    enum Type
+    {
+        OBJECT_ADDED,
+        OBJECT_REMOVED,
+        OBJECT_RENAMED,
+        OBJECT_VISIBILITY,
+        OBJECT_TRANSFORM,
+        OBJECT_APPEARANCE,
+        OBJECT_SELECTED,
+        TEXTURE_REMOVED
+    };
+
+    Type type;
+    // null when nothing gets selected and for the texture events
+    ObjectHandle object;
+    // position of the object in the object list, -1 when nothing gets
+    // selected, position in the texture list for the texture events
+    int index;
+};
+
+
+// counters of a single frame, uploads made by the commands before the frame
+// count to it too
+struct FrameStats
+{
+    int drawCalls;
+    int objects;
+    int culled;
+    uint64_t triangles;
+    uint64_t vertices;
+    uint64_t stateChanges;
+    uint64_t avoidedStateChanges;
+    size_t bufferBytes;
+    size_t textureBytes;
+
+    FrameStats();
+};
+
+
+// uniforms shared by all objects in a frame, layout follows std140 rules
+struct FrameUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 lightColor;
+    glm::vec4 lightPos;
+};
+
+
+// resources which can be reused only after the GPU finishes the frame
+// they were used in
+struct FrameResources
+{
+    GLsync fence;
+    GLuint uniformBuffer;
+    FrameUniforms* uniforms;
+    GLuint timeQueries[2];
+    bool queriesPending;
+    GPUTimers* timers;
+};
 
 
 class GraphicsManager
 {
 public:
-    GraphicsManager(Canvas* parent);
+    GraphicsManager(RenderHost* parent);
     ~GraphicsManager();
 
-    GLuint getShadersID();
-    bool getShadersCompiled();
+    // called from the render thread
+    GLuint getShadersID(int variant);
     void render();
-    void setUniformMatrix(glm::mat4 mat, const char* name);
-    void newObject(std::string file, size_t startLine = 0,
-        std::shared_ptr<std::vector<std::vector<std::string>>> data = nullptr,
-        std::shared_ptr<std::vector<GLfloat>> vertices = nullptr,
-        std::shared_ptr<std::vector<GLfloat>> texVertices = nullptr,
-        std::shared_ptr<std::vector<GLfloat>> normals = nullptr);
-    void renameObject(int idx, std::string newName);
-    void setObjectColor(int idx, GLfloat r, GLfloat g, GLfloat b);
-    void setObjectTex(int idx, std::shared_ptr<Texture> tex);
-    void duplicateObject(int idx);
-    void deleteObject(int idx);
-    void showOrHideObject(int idx);
-    bool getObjectShow(int idx);
-    std::string getObjectName(int idx);
-    std::tuple<GLfloat, GLfloat, GLfloat> getObjectColor(int idx);
-    glm::vec3* getObjectPosVec(int idx);
-    glm::vec3* getObjectRotVec(int idx);
-    glm::vec3* getObjectSize(int idx);
-    int* getObjectMode(int idx);
+    void processCommands();
+    void releaseResources();
+    float getGPUFrameTime();
+    FrameStats getFrameStats();
+    size_t getTextureMemory();
+    void queueBufferUpload(VertexBuffer* buffer);
+    void cancelBufferUpload(VertexBuffer* buffer);
+    void setHUDTimes(float FPS, float CPUTime, float GPUTime);
+    std::shared_ptr<Benchmark> getBenchmark();
+    void endBenchmark();
+
+    // called from the UI thread
+    bool getShadersCompiled();
+    void requestRender();
+    void setMouseInfo(MouseInfo info);
+    void setViewport(int width, int height);
+    void setFramesInFlight(int count);
+    void setHUDFont(std::shared_ptr<FontAtlas> atlas);
+    void setHUDEnabled(bool enable);
+    void runBenchmark(std::shared_ptr<Benchmark> run);
+    void recordCameraPath(std::shared_ptr<CameraPath> path);
+    void newObject(std::string file);
+    void renameObject(ObjectHandle object, std::string newName);
+    void setObjectColor(ObjectHandle object, GLfloat r, GLfloat g, GLfloat b);
+    void setObjectTex(ObjectHandle object, int texIdx);
+    void duplicateObject(ObjectHandle object);
+    void deleteObject(ObjectHandle object);
+    void showOrHideObject(ObjectHandle object);
+    bool getObjectShow(ObjectHandle object);
+    std::string getObjectName(ObjectHandle object);
+    std::tuple<GLfloat, GLfloat, GLfloat> getObjectColor(ObjectHandle object);
+    glm::vec3 getObjectPos(ObjectHandle object);
+    glm::vec3 getObjectRot(ObjectHandle object);
+    glm::vec3 getObjectSize(ObjectHandle object);
+    int getObjectMode(ObjectHandle object);
+    void setObjectPos(ObjectHandle object, glm::vec3 pos);
+    void setObjectRot(ObjectHandle object, glm::vec3 rot);
+    void setObjectSize(ObjectHandle object, glm::vec3 size);
+    void setObjectMode(ObjectHandle object, int mode);
     std::vector<std::string> getAllObjectNames();
-    void addTexture(const unsigned char* data, int width, int height,
+    int getObjectCount();
+    ObjectHandle getObjectAt(int position);
+    int getObjectPosition(ObjectHandle object);
+    void selectObject(ObjectHandle object);
+    ObjectHandle getSelectedObject();
+    int subscribe(std::function<void(const SceneEvent&)> callback);
+    void unsubscribe(int subscription);
+    int addTexture(const unsigned char* data, int width, int height,
         std::string name);
+    int findTexture(uint64_t hash);
+    int findTextureFile(uint64_t fileHash);
+    void setTextureBudget(size_t megabytes);
+    size_t getTextureBudget();
+    int reserveTexture(std::string name, uint64_t hash);
+    void setTextureHash(int key, uint64_t hash, uint64_t fileHash);
+    void setTextureImage(int key, std::shared_ptr<TextureImage> image);
     void deleteTexture(int idx);
-    std::shared_ptr<Texture> getTexPtr(int idx);
     std::vector<std::string> getAllTextureNames();
+    void requestMemoryReport(
+        std::function<void(std::shared_ptr<MemoryReport>)> callback);
+    void requestSceneFile(
+        std::function<void(std::shared_ptr<SceneFile>)> callback);
+    void restoreScene(std::shared_ptr<SceneFile> saved);
 
 private:
-    Canvas* parentCanvas;
-    ShaderManager* shaders;
-    Camera* camera;
+    // the loader's temporaries live in arenas, every line of a parsed file
+    // is a vector of its space separated blocks
+    typedef ArenaVector<ArenaString> ParsedLine;
+    typedef ArenaVector<ParsedLine> ParsedFile;
+    typedef ArenaVector<std::tuple<int64_t, int64_t, int64_t>> FaceIndices;
+
+    // a face or a line of a loaded file, the counts of the data defined
+    // before it are kept, because it can use only those
+    struct LoadedElement
+    {
+        size_t line;
+        int64_t vertices;
+        int64_t texVertices;
+        int64_t normals;
+    };
+
+    // an object of a loaded file, it's built by a job, the error is empty
+    // when all its elements are correct
+    struct LoadedObject
+    {
+        std::string name;
+        std::vector<LoadedElement> faces;
+        std::vector<LoadedElement> lines;
+        std::shared_ptr<std::vector<GLfloat>> vertices;
+        std::shared_ptr<std::vector<GLfloat>> texVertices;
+        std::shared_ptr<std::vector<GLfloat>> normals;
+        size_t lineCount;
+        size_t errorLine;
+        std::string error;
+        // allocations of the face arenas and the largest of their peaks
+        uint64_t arenaAllocations;
+        size_t arenaPeak;
+    };
+
+    RenderHost* parentHost;
+    CommandQueue* commands;
 
+    // state owned by the UI thread
     bool shadersCompiled;
+    // the infos are packed by the handle table, the list order is kept
+    // separately
+    HandleTable objectHandles;
+    std::vector<ObjectInfo> objectInfos;
+    std::vector<ObjectHandle> objectOrder;
+    std::vector<std::string> textureNames;
+    std::vector<int> textureKeys;
+    // hashes of the images, 0 until a texture opened from a file is
+    // decoded, the file hashes are 0 for the textures without a file
+    std::vector<uint64_t> textureHashes;
+    std::vector<uint64_t> textureFileHashes;
+    size_t textureBudget;
+    int nextTextureKey;
+    ObjectHandle selectedObject;
+    std::vector<std::pair<int, std::function<void(const SceneEvent&)>>>
+        subscribers;
+    int nextSubscription;
 
-    std::vector<std::unique_ptr<Object>> objects;
+    // state owned by the render thread
+    ShaderManager* shaders;
+    Camera* camera;
+    Scene* scene;
+    // objects which passed the culling in the current frame
+    std::vector<uint8_t> drawnObjects;
+    RenderQueue* renderQueue;
     std::vector<std::shared_ptr<Texture>> textures;
-
+    std::vector<std::shared_ptr<TextureArray>> textureArrays;
+    TextureUploader* uploader;
+    // vertex buffers whose data isn't on the GPU yet, in the order of
+    // their upload
+    std::deque<VertexBuffer*> pendingBuffers;
+    TextureStreamer* streamer;
+    uint64_t frameNumber;
+    static const int placeholderSize = 8;
+    GLuint placeholderImage;
+    std::shared_ptr<TextureImage> placeholder;
+    MouseInfo mouseInfo;
+    std::pair<int, int> viewportDims;
     glm::vec3 lightColor;
 
-    void setUniformVector(glm::vec3 vec, const char* name);
-    std::vector<std::vector<std::string>> parseFile(std::string name);
-    std::vector<std::tuple<int, int, int>> parseFace(size_t vertices,
-        std::vector<std::string> data);
-    void triangulate(std::vector<std::tuple<int, int, int>>* indices,
+    static const int maxFramesInFlight = 3;
+    FrameResources frames[maxFramesInFlight];
+    int framesInFlight;
+    int frameIdx;
+    float GPUFrameTime;
+    FrameStats frameStats;
+    FrameStats lastFrameStats;
+
+    // text over the frame, the times are measured by the host
+    HUD* hud;
+    bool HUDEnabled;
+    float HUDFPS;
+    float HUDCPUTime;
+    float HUDGPUTime;
+
+    // the camera follows the benchmark's path instead of the mouse
+    std::shared_ptr<Benchmark> benchmark;
+    std::shared_ptr<CameraPath> recordedPath;
+
+    void post(std::function<void()> command);
+    void publish(SceneEvent::Type type, ObjectHandle object, int position);
+    void placeTexture(std::shared_ptr<Texture> texture, GLuint image,
+        std::shared_ptr<TextureImage> data);
+    void createPlaceholder();
+    void createFrameResources();
+    void drawHUD();
+    void waitForFrame(FrameResources& frame);
+    ObjectInfo* findInfo(ObjectHandle object);
+    void updateListPositions(size_t first);
+    ParsedFile parseFile(std::string name, Arena& arena);
+    void buildObject(const ParsedFile& data,
+        std::shared_ptr<std::vector<GLfloat>> vertices,
+        const std::vector<GLfloat>& texVertices,
+        const std::vector<GLfloat>& normals, LoadedObject& object);
+    FaceIndices parseFace(size_t vertices, const ParsedLine& data,
+        Arena& arena);
+    void triangulate(FaceIndices* indices,
         std::shared_ptr<std::vector<GLfloat>> allVertices,
-        glm::vec3* normalVec);
+        glm::vec3* normalVec, Arena& arena);
 };
 
 
@@ -100,11 +375,14 @@ public:
     glm::mat4 cameraMatrix();
     void move(MouseInfo info);
     glm::vec3 getPos();
+    float getFarClip();
+    CameraPose getPose();
+    void setPose(CameraPose pose);
 
 private:
     bool cameraSpinningPrevFrame;
     bool cameraMovingPrevFrame;
-    wxPoint prevMousePos;
+    glm::ivec2 prevMousePos;
     float spinSensitivity;
     float moveSensitivity;
     float scrollSensitivity;
@@ -0,0 +1,433 @@
+#include "headless.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+
+HeadlessContext::HeadlessContext(int framebufferWidth, int framebufferHeight)
+    : width(framebufferWidth), height(framebufferHeight)
+{
+    created = false;
+    errorShown = false;
+    framebuffer = colorBuffer = depthBuffer = 0;
+
+    #ifdef HEADLESS_OSMESA
+        context = NULL;
+    #else
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+    #endif /* HEADLESS_OSMESA */
+
+    if (!createContext())
+        return;
+
+    if (!initGlew() || !createFramebuffer())
+    {
+        destroyContext();
+        return;
+    }
+
+    created = true;
+}
+
+
+HeadlessContext::~HeadlessContext()
+{
+    // the context is already destroyed if the creation failed
+    if (created)
+    {
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteRenderbuffers(1, &colorBuffer);
+        glDeleteRenderbuffers(1, &depthBuffer);
+    }
+
+    destroyContext();
+}
+
+
+#ifdef HEADLESS_OSMESA
+
+bool HeadlessContext::createContext()
+{
+    // llvmpipe in older Mesa releases supports at most 4.5 core profile,
+    // which still has everything the renderer needs
+    const int versions[][2] = {{4, 6}, {4, 5}};
+
+    for (auto version : versions)
+    {
+        const int attributes[] =
+        {
+            OSMESA_FORMAT, OSMESA_RGBA,
+            OSMESA_DEPTH_BITS, 24,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, version[0],
+            OSMESA_CONTEXT_MINOR_VERSION, version[1],
+            0
+        };
+
+        context = OSMesaCreateContextAttribs(attributes, NULL);
+        if (context != NULL)
+            break;
+    }
+
+    if (context == NULL)
+    {
+        showErrorMessage("Initialization error",
+            "OSMesa failed to create an OpenGL 4.5 core context");
+        return false;
+    }
+
+    // OSMesa always needs a buffer, even though the frames go to the FBO
+    contextBuffer.resize(static_cast<size_t>(width) * height * 4);
+    if (!OSMesaMakeCurrent(context, contextBuffer.data(), GL_UNSIGNED_BYTE,
+        width, height))
+    {
+        showErrorMessage("Initialization error",
+            "OSMesa failed to make the context current");
+        return false;
+    }
+
+    return true;
+}
+
+
+void HeadlessContext::destroyContext()
+{
+    if (context != NULL)
+        OSMesaDestroyContext(context);
+
+    context = NULL;
+}
+
+#else
+
+// surfaceless platform needs no display server, if it's not available the
+// default display is used
+// https://registry.khronos.org/EGL/extensions/MESA/EGL_MESA_platform_surfaceless.txt
+bool HeadlessContext::createContext()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+    if (getPlatformDisplay != NULL)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+            EGL_DEFAULT_DISPLAY, NULL);
+
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        showErrorMessage("Initialization error",
+            "EGL failed to initialize");
+        return false;
+    }
+
+    #ifdef DEBUG
+        std::cout << "EGL " << major << "." << minor << " initialized ("
+            << eglQueryString(display, EGL_VENDOR) << ")" << std::endl;
+    #endif /* DEBUG */
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        showErrorMessage("Initialization error",
+            "EGL does not support desktop OpenGL");
+        return false;
+    }
+
+    const EGLint configAttributes[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint configCount;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount)
+        || configCount == 0)
+    {
+        showErrorMessage("Initialization error",
+            "EGL found no suitable framebuffer configuration");
+        return false;
+    }
+
+    const EGLint contextAttributes[] =
+    {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 6,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        #ifdef DEBUG
+            EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE,
+        #endif /* DEBUG */
+        EGL_NONE
+    };
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+        contextAttributes);
+    if (context == EGL_NO_CONTEXT)
+    {
+        showErrorMessage("Initialization error",
+            "EGL failed to create an OpenGL 4.6 core context");
+        return false;
+    }
+
+    // the context has no default framebuffer (EGL_KHR_surfaceless_context)
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        showErrorMessage("Initialization error",
+            "EGL failed to make the context current");
+        return false;
+    }
+
+    return true;
+}
+
+
+void HeadlessContext::destroyContext()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+
+    eglTerminate(display);
+    context = EGL_NO_CONTEXT;
+    display = EGL_NO_DISPLAY;
+}
+
+#endif /* HEADLESS_OSMESA */
+
+
+// glewInit() of GLX builds of GLEW fails without a GLX display, the context
+// initialization alone is enough here
+bool HeadlessContext::initGlew()
+{
+    glewExperimental = GL_TRUE;
+    GLenum error = glewContextInit();
+    if (error != GLEW_OK)
+    {
+        showErrorMessage("Glew error", std::string("Glew failed to "
+            "initialize: ") + reinterpret_cast<const char*>(
+            glewGetErrorString(error)));
+        return false;
+    }
+
+    #ifdef DEBUG
+        std::cout << "Glew successfully initialized" << std::endl;
+        std::cout << "OpenGL " << glGetString(GL_VERSION) << " ("
+            << glGetString(GL_RENDERER) << ")" << std::endl;
+    #endif /* DEBUG */
+
+    if (!GLEW_ARB_direct_state_access)
+    {
+        showErrorMessage("Initialization error", "The GPU driver does not "
+            "support ARB_direct_state_access extension");
+        return false;
+    }
+
+    return true;
+}
+
+
+// GraphicsManager never binds any framebuffer, so it draws into this one
+bool HeadlessContext::createFramebuffer()
+{
+    glCreateRenderbuffers(1, &colorBuffer);
+    glNamedRenderbufferStorage(colorBuffer, GL_RGBA8, width, height);
+
+    glCreateRenderbuffers(1, &depthBuffer);
+    glNamedRenderbufferStorage(depthBuffer, GL_DEPTH_COMPONENT24, width,
+        height);
+
+    glCreateFramebuffers(1, &framebuffer);
+    glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0,
+        GL_RENDERBUFFER, colorBuffer);
+    glNamedFramebufferRenderbuffer(framebuffer, GL_DEPTH_ATTACHMENT,
+        GL_RENDERBUFFER, depthBuffer);
+
+    if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) !=
+        GL_FRAMEBUFFER_COMPLETE)
+    {
+        showErrorMessage("Initialization error",
+            "The offscreen framebuffer is not complete");
+        return false;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    return true;
+}
+
+
+bool HeadlessContext::contextExists()
+{
+    return created;
+}
+
+
+bool HeadlessContext::getErrorShown()
+{
+    return errorShown;
+}
+
+
+int HeadlessContext::getWidth()
+{
+    return width;
+}
+
+
+int HeadlessContext::getHeight()
+{
+    return height;
+}
+
+
+// frames are rendered by the caller's loop, there is nothing to wake up
+void HeadlessContext::requestRender()
+{
+}
+
+
+void HeadlessContext::showErrorMessage(std::string title, std::string msg)
+{
+    errorShown = true;
+    std::cerr << title << ": " << msg << std::endl;
+}
+
+
+// rows are returned from the top, OpenGL stores them from the bottom
+std::vector<unsigned char> HeadlessContext::readPixels()
+{
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    std::vector<unsigned char> flipped(rowSize * height);
+    std::vector<unsigned char> pixels(rowSize * height);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+        flipped.data());
+
+    for (int row = 0; row < height; row++)
+        std::copy(flipped.begin() + rowSize * (height - row - 1),
+            flipped.begin() + rowSize * (height - row),
+            pixels.begin() + rowSize * row);
+
+    return pixels;
+}
+
+
+// PNG writer without any compression, so no zlib is needed
+// http://www.libpng.org/pub/png/spec/1.2/PNG-Structure.html
+static uint32_t crc32(const unsigned char* data, size_t length, uint32_t crc)
+{
+    static uint32_t table[256] = {0};
+
+    if (table[1] == 0)
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++)
+                value = (value & 1) ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+            table[i] = value;
+        }
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+
+static void appendUint32(std::vector<unsigned char>& out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back((value >> 16) & 0xFF);
+    out.push_back((value >> 8) & 0xFF);
+    out.push_back(value & 0xFF);
+}
+
+
+static void writeChunk(std::ofstream& out, const char* type,
+    const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> chunk;
+    appendUint32(chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+
+    // CRC covers the type and the data, not the length
+    appendUint32(chunk, crc32(chunk.data() + 4, chunk.size() - 4, 0));
+
+    out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+}
+
+
+bool writePNG(std::string file, const std::vector<unsigned char>& pixels,
+    int width, int height)
+{
+    std::ofstream out(file, std::ios::binary);
+
+    if (!out)
+        return false;
+
+    const unsigned char signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+    out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    // 8 bits per channel, RGBA, no interlacing
+    std::vector<unsigned char> header;
+    appendUint32(header, width);
+    appendUint32(header, height);
+    header.insert(header.end(), {8, 6, 0, 0, 0});
+    writeChunk(out, "IHDR", header);
+
+    // every row starts with the filter type, 0 means no filtering
+    size_t rowSize = static_cast<size_t>(width) * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowSize + 1) * height);
+    for (int row = 0; row < height; row++)
+    {
+        raw.push_back(0);
+        raw.insert(raw.end(), pixels.begin() + rowSize * row,
+            pixels.begin() + rowSize * (row + 1));
+    }
+
+    // zlib stream made of stored deflate blocks
+    // https://www.rfc-editor.org/rfc/rfc1951#section-3.2.4
+    const size_t maxBlock = 65535;
+    std::vector<unsigned char> data = {0x78, 0x01};
+    uint32_t adlerA = 1, adlerB = 0;
+
+    for (size_t offset = 0; offset < raw.size(); offset += maxBlock)
+    {
+        size_t length = std::min(maxBlock, raw.size() - offset);
+
+        data.push_back(offset + length == raw.size() ? 1 : 0);
+        data.push_back(length & 0xFF);
+        data.push_back(length >> 8);
+        data.push_back(~length & 0xFF);
+        data.push_back((~length >> 8) & 0xFF);
+        data.insert(data.end(), raw.begin() + offset,
+            raw.begin() + offset + length);
+
+        for (size_t i = offset; i < offset + length; i++)
+        {
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+    }
+
+    appendUint32(data, (adlerB << 16) | adlerA);
+    writeChunk(out, "IDAT", data);
+    writeChunk(out, "IEND", std::vector<unsigned char>());
+
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,64 @@
+#ifndef HEADLESS_HPP_
+#define HEADLESS_HPP_
+
+#include "../graphics.hpp"
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+#ifdef HEADLESS_OSMESA
+    #include <GL/osmesa.h>
+#else
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+#endif /* HEADLESS_OSMESA */
+
+
+// OpenGL context without any window, the scene is rendered into a framebuffer
+// object and can be read back, context is created through EGL surfaceless
+// platform or OSMesa (both work with Mesa's software llvmpipe driver)
+class HeadlessContext : public RenderHost
+{
+public:
+    HeadlessContext(int framebufferWidth, int framebufferHeight);
+    ~HeadlessContext();
+
+    bool contextExists();
+    bool getErrorShown();
+    int getWidth();
+    int getHeight();
+    void requestRender() override;
+    void showErrorMessage(std::string title, std::string msg) override;
+    std::vector<unsigned char> readPixels();
+
+private:
+    int width;
+    int height;
+    bool created;
+    bool errorShown;
+
+    #ifdef HEADLESS_OSMESA
+        OSMesaContext context;
+        std::vector<unsigned char> contextBuffer;
+    #else
+        EGLDisplay display;
+        EGLContext context;
+    #endif /* HEADLESS_OSMESA */
+
+    GLuint framebuffer;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+
+    bool createContext();
+    bool initGlew();
+    bool createFramebuffer();
+    void destroyContext();
+};
+
+
+bool writePNG(std::string file, const std::vector<unsigned char>& pixels,
+    int width, int height);
+
+
+#endif /* HEADLESS_HPP_ */
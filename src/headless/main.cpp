@@ -0,0 +1,296 @@
+#include "headless.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+struct Options
+{
+    int width = 1280;
+    int height = 720;
+    int frames = 600;
+    int PNGEvery = 0;
+    std::string PNGPrefix;
+    std::string timingsFile;
+    std::string traceFile;
+    std::string benchmarkFile;
+    std::string cameraPathFile;
+    std::string sceneDirectory = ".";
+    SceneParams scene;
+    std::vector<std::string> objects;
+};
+
+
+struct FrameTiming
+{
+    float CPUTime;
+    float GPUTime;
+};
+
+
+static void printUsage()
+{
+    std::cerr <<
+        "usage: whisk-headless [options] [file.obj...]\n"
+        "without any OBJ file a benchmark scene is generated\n"
+        "  --width W             framebuffer width (default 1280)\n"
+        "  --height H            framebuffer height (default 720)\n"
+        "  --frames N            length of the orbit path (default 600)\n"
+        "  --camera-path FILE    play a recorded camera path instead\n"
+        "  --objects N           generated objects (default 64)\n"
+        "  --triangles N         triangles per object (default 5000)\n"
+        "  --ngon-ratio F        share of faces stored as quads (default 0.25)\n"
+        "  --textured-ratio F    share of textured objects (default 0.5)\n"
+        "  --duplicate-ratio F   share of duplicated objects (default 0.25)\n"
+        "  --seed N              seed of the scene generator (default 1)\n"
+        "  --scene-dir DIR       where generated OBJ files are written\n"
+        "  --benchmark FILE      write percentiles and load times as JSON\n"
+        "  --png PREFIX          save the last frame as PREFIX<frame>.png\n"
+        "  --png-every K         save every K-th frame instead of the last one\n"
+        "  --timings FILE        write per-frame timings as CSV\n"
+        "  --trace FILE          record and export a Chrome trace\n";
+}
+
+
+static bool parseArguments(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        if (arg.rfind("--", 0) != 0)
+        {
+            options.objects.push_back(arg);
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        std::string value = argv[++i];
+
+        if (arg == "--width")
+            options.width = std::atoi(value.c_str());
+        else if (arg == "--height")
+            options.height = std::atoi(value.c_str());
+        else if (arg == "--frames")
+            options.frames = std::atoi(value.c_str());
+        else if (arg == "--camera-path")
+            options.cameraPathFile = value;
+        else if (arg == "--objects")
+            options.scene.objectCount = std::atoi(value.c_str());
+        else if (arg == "--triangles")
+            options.scene.trianglesPerObject = std::atoi(value.c_str());
+        else if (arg == "--ngon-ratio")
+            options.scene.ngonRatio = std::atof(value.c_str());
+        else if (arg == "--textured-ratio")
+            options.scene.texturedRatio = std::atof(value.c_str());
+        else if (arg == "--duplicate-ratio")
+            options.scene.duplicateRatio = std::atof(value.c_str());
+        else if (arg == "--seed")
+            options.scene.seed = std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--scene-dir")
+            options.sceneDirectory = value;
+        else if (arg == "--benchmark")
+            options.benchmarkFile = value;
+        else if (arg == "--png-every")
+            options.PNGEvery = std::atoi(value.c_str());
+        else if (arg == "--png")
+            options.PNGPrefix = value;
+        else if (arg == "--timings")
+            options.timingsFile = value;
+        else if (arg == "--trace")
+            options.traceFile = value;
+        else
+            return false;
+    }
+
+    return options.width > 0 && options.height > 0 && options.frames > 0 &&
+        options.PNGEvery >= 0 && options.scene.objectCount > 0 &&
+        options.scene.trianglesPerObject > 0;
+}
+
+
+static bool savePNG(HeadlessContext& context, const Options& options,
+    int frame)
+{
+    char number[16];
+    snprintf(number, sizeof(number), "%04d", frame);
+    std::string file = options.PNGPrefix + number + ".png";
+
+    if (!writePNG(file, context.readPixels(), context.getWidth(),
+        context.getHeight()))
+    {
+        std::cerr << "Could not write " << file << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+static bool writeTimings(std::string file,
+    const std::vector<FrameTiming>& timings)
+{
+    std::ofstream out(file);
+
+    if (!out)
+        return false;
+
+    out << "frame,cpu_ms,gpu_ms\n";
+    for (size_t i = 0; i < timings.size(); i++)
+        out << i << "," << timings[i].CPUTime << "," << timings[i].GPUTime
+            << "\n";
+
+    return static_cast<bool>(out);
+}
+
+
+static bool loadScene(const Options& options,
+    std::shared_ptr<GraphicsManager> graphicsManager,
+    std::shared_ptr<Benchmark> benchmark)
+{
+    // the same thread works as the UI and the render thread, commands are
+    // executed right after they are sent
+    std::function<void()> flush = [graphicsManager]{
+        graphicsManager->processCommands();
+    };
+
+    if (options.objects.empty())
+        return benchmark->generateScene(graphicsManager.get(), options.scene,
+            options.sceneDirectory, flush);
+
+    for (const std::string& file : options.objects)
+        if (!benchmark->loadObject(graphicsManager.get(), file, flush))
+            return false;
+
+    return true;
+}
+
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    if (!parseArguments(argc, argv, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    Profiler& profiler = Profiler::instance();
+    profiler.setThreadName("Render");
+    profiler.setEnabled(!options.traceFile.empty());
+
+    HeadlessContext context(options.width, options.height);
+    if (!context.contextExists())
+        return 1;
+
+    std::shared_ptr<GraphicsManager> graphicsManager =
+        std::make_shared<GraphicsManager>(&context);
+
+    if (!graphicsManager->getShadersCompiled())
+    {
+        std::cerr << "Shaders failed to compile" << std::endl;
+        graphicsManager->releaseResources();
+        return 1;
+    }
+
+    graphicsManager->setViewport(options.width, options.height);
+    graphicsManager->processCommands();
+
+    std::shared_ptr<Benchmark> benchmark = std::make_shared<Benchmark>();
+
+    if (!loadScene(options, graphicsManager, benchmark) ||
+        context.getErrorShown())
+    {
+        std::cerr << "The scene failed to load" << std::endl;
+        graphicsManager->releaseResources();
+        return 1;
+    }
+
+    std::shared_ptr<CameraPath> path = std::make_shared<CameraPath>();
+    if (!options.cameraPathFile.empty())
+    {
+        if (!path->load(options.cameraPathFile))
+        {
+            std::cerr << "Invalid camera path " << options.cameraPathFile
+                << std::endl;
+            graphicsManager->releaseResources();
+            return 1;
+        }
+    }
+    else
+        path = CameraPath::orbit(options.frames, benchmark->getSceneRadius());
+
+    benchmark->setCameraPath(path);
+    graphicsManager->runBenchmark(benchmark);
+
+    std::vector<FrameTiming> timings;
+    timings.reserve(path->size());
+    bool PNGFailed = false;
+
+    for (int frame = 0; !benchmark->finished(); frame++)
+    {
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        graphicsManager->processCommands();
+        graphicsManager->render();
+
+        float CPUTime = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count() / 1000.0f;
+
+        // GPU time belongs to the oldest frame in flight, which is the
+        // latest one whose queries are already available
+        float GPUTime = graphicsManager->getGPUFrameTime();
+        timings.push_back({CPUTime, GPUTime});
+        benchmark->addFrame(CPUTime, GPUTime,
+            graphicsManager->getFrameStats());
+
+        bool savedFrame = options.PNGEvery > 0 ?
+            frame % options.PNGEvery == 0 : benchmark->finished();
+
+        if (!options.PNGPrefix.empty() && savedFrame)
+            PNGFailed |= !savePNG(context, options, frame);
+    }
+
+    graphicsManager->endBenchmark();
+    glFinish();
+
+    std::cout << options.width << "x" << options.height << ", "
+        << benchmark->summary() << std::endl;
+
+    bool failed = PNGFailed;
+
+    if (!options.benchmarkFile.empty() &&
+        !benchmark->writeJSON(options.benchmarkFile))
+    {
+        std::cerr << "Could not write " << options.benchmarkFile << std::endl;
+        failed = true;
+    }
+
+    if (!options.timingsFile.empty() &&
+        !writeTimings(options.timingsFile, timings))
+    {
+        std::cerr << "Could not write " << options.timingsFile << std::endl;
+        failed = true;
+    }
+
+    if (!options.traceFile.empty() &&
+        !profiler.exportTrace(options.traceFile))
+    {
+        std::cerr << "Could not write " << options.traceFile << std::endl;
+        failed = true;
+    }
+
+    graphicsManager->releaseResources();
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+#include "hud.hpp"
+
+#include <algorithm>
+
+
+// the HUD has its own texture unit, so the objects' texture arrays stay bound
+static const GLuint glyphUnit = 1;
+static const float margin = 6.0f;
+
+
+HUD::HUD()
+{
+    shaders = new ShaderManager();
+    shaders->addShader("hud.vert");
+    shaders->addShader("hud.frag");
+    shadersLinked = shaders->linkProgram();
+
+    texture = 0;
+    bufferCapacity = 0;
+
+    glCreateBuffers(1, &buffer);
+    glCreateVertexArrays(1, &vertexArray);
+
+    glVertexArrayVertexBuffer(vertexArray, 0, buffer, 0, sizeof(Vertex));
+
+    // data structure inside vertex array
+    // pos | tex
+    // X Y | X Y
+    for (GLuint attrib = 0; attrib < 2; attrib++)
+    {
+        glVertexArrayAttribFormat(vertexArray, attrib, 2, GL_FLOAT, GL_FALSE,
+            attrib * 2 * sizeof(GLfloat));
+        glVertexArrayAttribBinding(vertexArray, attrib, 0);
+        glEnableVertexArrayAttrib(vertexArray, attrib);
+    }
+}
+
+
+HUD::~HUD()
+{
+    delete shaders;
+}
+
+
+// the atlas has a single level, the text is never scaled
+void HUD::setFont(std::shared_ptr<FontAtlas> atlas)
+{
+    if (texture != 0)
+    {
+        GLState::instance().forgetTexture(texture);
+        glDeleteTextures(1, &texture);
+    }
+
+    font = atlas;
+    int width = font->glyphWidth * FontAtlas::glyphCount;
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureStorage2D(texture, 1, GL_R8, width, font->glyphHeight);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTextureSubImage2D(texture, 0, 0, 0, width, font->glyphHeight, GL_RED,
+        GL_UNSIGNED_BYTE, font->coverage.data());
+}
+
+
+bool HUD::hasFont()
+{
+    return font != nullptr && shadersLinked;
+}
+
+
+void HUD::addQuad(float x, float y, float width, float height, float u0,
+    float v0, float u1, float v1)
+{
+    Vertex corners[] = {
+        {x, y, u0, v0}, {x + width, y, u1, v0},
+        {x + width, y + height, u1, v1}, {x, y + height, u0, v1}
+    };
+
+    for (int corner : {0, 1, 2, 0, 2, 3})
+        vertices.push_back(corners[corner]);
+}
+
+
+// the text is drawn in the top left corner over everything rendered before
+void HUD::draw(const std::vector<std::string>& lines, int viewportWidth,
+    int viewportHeight)
+{
+    if (!hasFont() || lines.empty())
+        return;
+
+    PROFILE_SCOPE("HUD::draw");
+
+    float glyphWidth = font->glyphWidth;
+    float glyphHeight = font->glyphHeight;
+    float glyphU = 1.0f / FontAtlas::glyphCount;
+
+    size_t longest = 0;
+    for (const std::string& line : lines)
+        longest = std::max(longest, line.size());
+
+    vertices.clear();
+    addQuad(0.0f, 0.0f, longest * glyphWidth + 2 * margin,
+        lines.size() * glyphHeight + 2 * margin, -1.0f, -1.0f, -1.0f, -1.0f);
+
+    for (size_t row = 0; row < lines.size(); row++)
+        for (size_t column = 0; column < lines[row].size(); column++)
+        {
+            int glyph = lines[row][column] - FontAtlas::firstGlyph;
+
+            // spaces and unknown characters leave a gap
+            if (glyph <= 0 || glyph >= FontAtlas::glyphCount)
+                continue;
+
+            addQuad(margin + column * glyphWidth, margin + row * glyphHeight,
+                glyphWidth, glyphHeight, glyph * glyphU, 0.0f,
+                (glyph + 1) * glyphU, 1.0f);
+        }
+
+    // the buffer grows only when the text gets longer
+    size_t size = vertices.size() * sizeof(Vertex);
+    if (size > bufferCapacity)
+    {
+        bufferCapacity = std::max(size, 2 * bufferCapacity);
+        glNamedBufferData(buffer, bufferCapacity, nullptr, GL_STREAM_DRAW);
+    }
+    glNamedBufferSubData(buffer, 0, size, vertices.data());
+
+    GLState& state = GLState::instance();
+    state.useProgram(shaders->getID());
+    state.bindVertexArray(vertexArray);
+    state.bindTexture(glyphUnit, texture);
+    state.setPolygonMode(GL_FILL);
+    state.setDepthTest(false);
+    state.setBlend(true);
+    state.setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    state.setUniform(GLState::GLYPHS, static_cast<GLint>(glyphUnit));
+    state.setUniform(GLState::SCREEN, glm::ortho(0.0f,
+        static_cast<float>(viewportWidth), static_cast<float>(viewportHeight),
+        0.0f));
+
+    glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+
+    state.setBlend(false);
+    state.setDepthTest(true);
+}
+
+
+void HUD::release()
+{
+    GLState& state = GLState::instance();
+
+    if (texture != 0)
+    {
+        state.forgetTexture(texture);
+        glDeleteTextures(1, &texture);
+        texture = 0;
+    }
+
+    state.forgetVertexArray(vertexArray);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteBuffers(1, &buffer);
+
+    delete shaders;
+    shaders = nullptr;
+}
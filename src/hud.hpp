@@ -0,0 +1,63 @@
+#ifndef HUD_HPP_
+#define HUD_HPP_
+
+#include "graphics.hpp"
+
+#include <GL/glew.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ShaderManager;
+
+
+// printable ASCII characters rendered by the UI toolkit into a single row of
+// cells, the core gets only the coverage of every pixel
+struct FontAtlas
+{
+    static const char firstGlyph = ' ';
+    static const int glyphCount = 95;
+
+    int glyphWidth;
+    int glyphHeight;
+    std::vector<unsigned char> coverage;
+};
+
+
+// text drawn over the rendered frame, the whole text is a single draw call
+class HUD
+{
+public:
+    HUD();
+    ~HUD();
+
+    void setFont(std::shared_ptr<FontAtlas> atlas);
+    bool hasFont();
+    void draw(const std::vector<std::string>& lines, int viewportWidth,
+        int viewportHeight);
+    void release();
+
+private:
+    // vertices of every glyph quad, a negative texture coordinate marks
+    // the background
+    struct Vertex
+    {
+        GLfloat x, y;
+        GLfloat u, v;
+    };
+
+    ShaderManager* shaders;
+    bool shadersLinked;
+    GLuint texture;
+    GLuint buffer;
+    GLuint vertexArray;
+    size_t bufferCapacity;
+    std::shared_ptr<FontAtlas> font;
+    std::vector<Vertex> vertices;
+
+    void addQuad(float x, float y, float width, float height, float u0,
+        float v0, float u1, float v1);
+};
+
+
+#endif /* HUD_HPP_ */
@@ -0,0 +1,309 @@
+#include "jobs.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+
+struct Job
+{
+    std::function<void()> function;
+
+    // unfinished dependencies and one more until the job is started, so it
+    // can't be scheduled while its dependencies are being added
+    std::atomic<int> waiting;
+
+    std::mutex mutex;
+    std::condition_variable finishedCondition;
+    bool finished;
+    std::vector<JobHandle> dependents;
+};
+
+
+// -1 for the threads outside of the pool
+static thread_local int currentWorker = -1;
+
+
+JobSystem& JobSystem::instance()
+{
+    static JobSystem jobSystem;
+    return jobSystem;
+}
+
+
+// one core is left for the thread which creates the jobs, it helps with
+// them while it waits
+JobSystem::JobSystem()
+{
+    int count = std::max(static_cast<int>(
+        std::thread::hardware_concurrency()) - 1, 1);
+
+    queued = 0;
+    nextWorker = 0;
+    stopping = false;
+
+    for (int i = 0; i < count; i++)
+        workers.push_back(std::make_unique<Worker>());
+
+    for (int i = 0; i < count; i++)
+        threads.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+
+// the queued jobs are dropped, only the running ones are finished
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    sleepCondition.notify_all();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+
+JobHandle JobSystem::run(std::function<void()> function,
+    const std::vector<JobHandle>& dependencies)
+{
+    JobHandle job = std::make_shared<Job>();
+    job->function = function;
+    return start(job, dependencies);
+}
+
+
+// empty when no thread owns the context, the continuations are dropped then
+void JobSystem::setRenderThread(Dispatcher dispatch)
+{
+    std::lock_guard<std::mutex> lock(renderThreadMutex);
+    renderThread = dispatch;
+}
+
+
+// the function is handed to the render thread when the dependencies finish,
+// the returned job finishes when the function is handed over, not when it
+// runs, so even the render thread can wait for it, the function then runs
+// with the next commands
+JobHandle JobSystem::continueOnRenderThread(std::function<void()> function,
+    const std::vector<JobHandle>& dependencies)
+{
+    return run([this, function]{
+        Dispatcher dispatch;
+        {
+            std::lock_guard<std::mutex> lock(renderThreadMutex);
+            dispatch = renderThread;
+        }
+
+        if (dispatch)
+            dispatch(function);
+    }, dependencies);
+}
+
+
+bool JobSystem::isFinished(JobHandle job)
+{
+    std::lock_guard<std::mutex> lock(job->mutex);
+    return job->finished;
+}
+
+
+// the waiting thread runs other jobs in the meantime, so jobs can wait for
+// the jobs they created
+void JobSystem::wait(JobHandle job)
+{
+    while (true)
+    {
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            if (job->finished)
+                return;
+        }
+
+        if (runOne(currentWorker))
+            continue;
+
+        // the job is running on another thread
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finishedCondition.wait_for(lock, std::chrono::milliseconds(1),
+            [&job]{ return job->finished; });
+    }
+}
+
+
+void JobSystem::wait(const std::vector<JobHandle>& jobs)
+{
+    for (const JobHandle& job : jobs)
+        wait(job);
+}
+
+
+// the range is split into chunks of the grain size, the calling thread
+// takes the first one and helps with the rest
+void JobSystem::parallelFor(size_t count, size_t grain,
+    std::function<void(size_t begin, size_t end)> function)
+{
+    grain = std::max(grain, static_cast<size_t>(1));
+
+    if (count <= grain)
+    {
+        if (count > 0)
+            function(0, count);
+        return;
+    }
+
+    std::vector<JobHandle> chunks;
+    for (size_t begin = grain; begin < count; begin += grain)
+    {
+        size_t end = std::min(begin + grain, count);
+        chunks.push_back(run([&function, begin, end]{
+            function(begin, end);
+        }));
+    }
+
+    function(0, grain);
+    wait(chunks);
+}
+
+
+int JobSystem::getWorkerCount()
+{
+    return workers.size();
+}
+
+
+void JobSystem::workerLoop(int index)
+{
+    currentWorker = index;
+    Profiler::instance().setThreadName("Worker " + std::to_string(index));
+
+    while (true)
+    {
+        if (runOne(index))
+            continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this]{ return stopping || queued > 0; });
+
+        if (stopping)
+            return;
+    }
+}
+
+
+JobHandle JobSystem::start(JobHandle job,
+    const std::vector<JobHandle>& dependencies)
+{
+    job->waiting = 1;
+    job->finished = false;
+
+    for (const JobHandle& dependency : dependencies)
+    {
+        if (dependency == nullptr)
+            continue;
+
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->finished)
+            continue;
+
+        job->waiting++;
+        dependency->dependents.push_back(job);
+    }
+
+    if (--job->waiting == 0)
+        schedule(job);
+
+    return job;
+}
+
+
+// a worker keeps the jobs it creates, the other threads spread theirs over
+// the workers
+void JobSystem::schedule(JobHandle job)
+{
+    int index = currentWorker;
+    if (index == -1)
+        index = nextWorker++ % workers.size();
+
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->jobs.push_back(job);
+    }
+
+    // the counter is raised before the lock, so a worker checking it can't
+    // miss the notification
+    queued++;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    sleepCondition.notify_one();
+}
+
+
+// the own deque is used as a stack, the others are robbed from the front
+JobHandle JobSystem::take(int index)
+{
+    if (index != -1)
+    {
+        Worker& worker = *workers[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (!worker.jobs.empty())
+        {
+            JobHandle job = worker.jobs.back();
+            worker.jobs.pop_back();
+            return job;
+        }
+    }
+
+    size_t count = workers.size();
+    size_t first = index == -1 ? 0 : index + 1;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        Worker& victim = *workers[(first + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            JobHandle job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+
+bool JobSystem::runOne(int index)
+{
+    JobHandle job = take(index);
+    if (job == nullptr)
+        return false;
+
+    queued--;
+    job->function();
+    finish(job);
+    return true;
+}
+
+
+// the dependents whose last dependency this was are scheduled
+void JobSystem::finish(JobHandle job)
+{
+    std::vector<JobHandle> dependents;
+
+    // the captures can hold a lot of memory and the handle can live long
+    job->function = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished = true;
+        dependents.swap(job->dependents);
+    }
+    job->finishedCondition.notify_all();
+
+    for (JobHandle& dependent : dependents)
+        if (--dependent->waiting == 0)
+            schedule(dependent);
+}
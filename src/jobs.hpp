@@ -0,0 +1,75 @@
+#ifndef JOBS_HPP_
+#define JOBS_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+typedef std::shared_ptr<Job> JobHandle;
+
+
+// thread pool shared by the whole app, there is one worker per core and every
+// worker has its own deque, it takes its newest jobs from the back and the
+// idle workers steal the oldest jobs of the others from the front, a job
+// starts when all the jobs it depends on are finished, the jobs mustn't throw
+class JobSystem
+{
+public:
+    // hands a function to the thread which owns the OpenGL context,
+    // GraphicsManager::post is the one used by the app
+    typedef std::function<void(std::function<void()>)> Dispatcher;
+
+    static JobSystem& instance();
+
+    JobHandle run(std::function<void()> function,
+        const std::vector<JobHandle>& dependencies = {});
+    void setRenderThread(Dispatcher dispatch);
+    JobHandle continueOnRenderThread(std::function<void()> function,
+        const std::vector<JobHandle>& dependencies = {});
+    bool isFinished(JobHandle job);
+    void wait(JobHandle job);
+    void wait(const std::vector<JobHandle>& jobs);
+    void parallelFor(size_t count, size_t grain,
+        std::function<void(size_t begin, size_t end)> function);
+    int getWorkerCount();
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    JobSystem();
+    ~JobSystem();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<int> queued;
+    std::atomic<size_t> nextWorker;
+
+    std::mutex renderThreadMutex;
+    Dispatcher renderThread;
+
+    // the workers sleep only when all deques are empty
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    bool stopping;
+
+    void workerLoop(int index);
+    JobHandle start(JobHandle job, const std::vector<JobHandle>& dependencies);
+    void schedule(JobHandle job);
+    JobHandle take(int index);
+    bool runOne(int index);
+    void finish(JobHandle job);
+};
+
+
+#endif /* JOBS_HPP_ */
@@ -0,0 +1,484 @@
+#include "kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef DEBUG
+    #include <iostream>
+#endif /* DEBUG */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define KERNELS_X86
+    #include <immintrin.h>
+#endif
+
+
+// the vectorized versions do the same operations in the same order, so the
+// results match the scalar ones to the bit, the max instructions return
+// their second operand for NaNs like std::max returns its first one
+
+static void interleaveScalar(const float* positions, const float* texCoords,
+    const float* normals, const float* color, size_t count, float* out)
+{
+    for (size_t vertex = 0; vertex < count; vertex++)
+    {
+        float* target = out + vertex * 11;
+
+        for (int i = 0; i < 3; i++)
+        {
+            target[i] = positions[vertex * 3 + i];
+            target[3 + i] = color[i];
+            target[8 + i] = normals[vertex * 3 + i];
+        }
+
+        target[6] = texCoords[vertex * 2];
+        target[7] = texCoords[vertex * 2 + 1];
+    }
+}
+
+
+static float maxLengthScalar(const float* positions, size_t count)
+{
+    float longest = 0.0f;
+
+    for (size_t vertex = 0; vertex < count; vertex++)
+    {
+        const float* v = positions + vertex * 3;
+        longest = std::max(longest, v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    }
+
+    return std::sqrt(longest);
+}
+
+
+static size_t cullSpheresScalar(const glm::vec4* planes,
+    const glm::vec4* spheres, const uint8_t* visible, size_t count,
+    uint8_t* drawn)
+{
+    size_t culled = 0;
+
+    for (size_t sphere = 0; sphere < count; sphere++)
+    {
+        const glm::vec4& s = spheres[sphere];
+        bool outside = false;
+
+        for (int i = 0; i < 6; i++)
+        {
+            const glm::vec4& p = planes[i];
+            if (p.x * s.x + p.y * s.y + p.z * s.z + p.w < -s.w)
+                outside = true;
+        }
+
+        drawn[sphere] = visible[sphere] && !outside;
+        if (visible[sphere] && outside)
+            culled++;
+    }
+
+    return culled;
+}
+
+
+#ifdef KERNELS_X86
+
+// SSE2 is a part of x86-64, the 32-bit builds get it only with -msse2
+#ifdef __SSE2__
+
+// the 4-float stores of a vertex overlap and each one overwrites the garbage
+// of the previous one, the last vertex would write and read past the arrays
+static void interleaveSSE2(const float* positions, const float* texCoords,
+    const float* normals, const float* color, size_t count, float* out)
+{
+    if (count == 0)
+        return;
+
+    __m128 colorVec = _mm_setr_ps(color[0], color[1], color[2], 0.0f);
+
+    for (size_t vertex = 0; vertex + 1 < count; vertex++)
+    {
+        float* target = out + vertex * 11;
+
+        _mm_storeu_ps(target, _mm_loadu_ps(positions + vertex * 3));
+        _mm_storeu_ps(target + 3, colorVec);
+        _mm_storeu_ps(target + 6, _mm_loadu_ps(texCoords + vertex * 2));
+        _mm_storeu_ps(target + 8, _mm_loadu_ps(normals + vertex * 3));
+    }
+
+    interleaveScalar(positions + (count - 1) * 3, texCoords + (count - 1) * 2,
+        normals + (count - 1) * 3, color, 1, out + (count - 1) * 11);
+}
+
+
+// four vertices are three vectors, they are shuffled into x, y and z
+static float maxLengthSSE2(const float* positions, size_t count)
+{
+    __m128 longest = _mm_setzero_ps();
+    size_t vertex = 0;
+
+    for (; vertex + 4 <= count; vertex += 4)
+    {
+        const float* v = positions + vertex * 3;
+        __m128 a = _mm_loadu_ps(v);
+        __m128 b = _mm_loadu_ps(v + 4);
+        __m128 c = _mm_loadu_ps(v + 8);
+
+        __m128 x = _mm_shuffle_ps(a,
+            _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 1, 0, 2)),
+            _MM_SHUFFLE(2, 0, 3, 0));
+        __m128 y = _mm_shuffle_ps(
+            _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1)),
+            _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 2, 0, 3)),
+            _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 z = _mm_shuffle_ps(
+            _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 1, 0, 2)),
+            _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 0, 0)),
+            _MM_SHUFFLE(2, 0, 2, 0));
+
+        __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x),
+            _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        longest = _mm_max_ps(squared, longest);
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, longest);
+    float rest = maxLengthScalar(positions + vertex * 3, count - vertex);
+
+    return std::max(std::sqrt(std::max(std::max(lanes[0], lanes[1]),
+        std::max(lanes[2], lanes[3]))), rest);
+}
+
+
+// four spheres are transposed, so every lane tests one of them
+static size_t cullSpheresSSE2(const glm::vec4* planes,
+    const glm::vec4* spheres, const uint8_t* visible, size_t count,
+    uint8_t* drawn)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t culled = 0;
+    size_t sphere = 0;
+
+    for (; sphere + 4 <= count; sphere += 4)
+    {
+        __m128 x = _mm_loadu_ps(&spheres[sphere].x);
+        __m128 y = _mm_loadu_ps(&spheres[sphere + 1].x);
+        __m128 z = _mm_loadu_ps(&spheres[sphere + 2].x);
+        __m128 r = _mm_loadu_ps(&spheres[sphere + 3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, r);
+
+        __m128 negRadius = _mm_xor_ps(r, sign);
+        __m128 outside = _mm_setzero_ps();
+
+        for (int i = 0; i < 6; i++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(planes[i].x), x),
+                _mm_mul_ps(_mm_set1_ps(planes[i].y), y)),
+                _mm_mul_ps(_mm_set1_ps(planes[i].z), z)),
+                _mm_set1_ps(planes[i].w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negRadius));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            bool out = (mask >> lane) & 1;
+            drawn[sphere + lane] = visible[sphere + lane] && !out;
+            if (visible[sphere + lane] && out)
+                culled++;
+        }
+    }
+
+    return culled + cullSpheresScalar(planes, spheres + sphere,
+        visible + sphere, count - sphere, drawn + sphere);
+}
+
+#endif /* __SSE2__ */
+
+
+// the vertices are gathered, every eighth coordinate of each axis
+__attribute__((target("avx2")))
+static float maxLengthAVX2(const float* positions, size_t count)
+{
+    const __m256i indices = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    __m256 longest = _mm256_setzero_ps();
+    size_t vertex = 0;
+
+    for (; vertex + 8 <= count; vertex += 8)
+    {
+        const float* v = positions + vertex * 3;
+        __m256 x = _mm256_i32gather_ps(v, indices, 4);
+        __m256 y = _mm256_i32gather_ps(v + 1, indices, 4);
+        __m256 z = _mm256_i32gather_ps(v + 2, indices, 4);
+
+        __m256 squared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x),
+            _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+        longest = _mm256_max_ps(squared, longest);
+    }
+
+    float lanes[8];
+    _mm256_storeu_ps(lanes, longest);
+    float rest = maxLengthScalar(positions + vertex * 3, count - vertex);
+
+    float squared = 0.0f;
+    for (float lane : lanes)
+        squared = std::max(squared, lane);
+
+    return std::max(std::sqrt(squared), rest);
+}
+
+
+// the sphere in the low half and the fourth one after it in the high half
+__attribute__((target("avx2")))
+static inline __m256 loadSpherePair(const glm::vec4* sphere)
+{
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(
+        _mm_loadu_ps(&sphere[0].x)), _mm_loadu_ps(&sphere[4].x), 1);
+}
+
+
+// spheres i and i + 4 share a register, the transpose works in both halves
+__attribute__((target("avx2")))
+static size_t cullSpheresAVX2(const glm::vec4* planes,
+    const glm::vec4* spheres, const uint8_t* visible, size_t count,
+    uint8_t* drawn)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    size_t culled = 0;
+    size_t sphere = 0;
+
+    for (; sphere + 8 <= count; sphere += 8)
+    {
+        __m256 s0 = loadSpherePair(spheres + sphere);
+        __m256 s1 = loadSpherePair(spheres + sphere + 1);
+        __m256 s2 = loadSpherePair(spheres + sphere + 2);
+        __m256 s3 = loadSpherePair(spheres + sphere + 3);
+
+        __m256 t0 = _mm256_unpacklo_ps(s0, s1);
+        __m256 t1 = _mm256_unpacklo_ps(s2, s3);
+        __m256 t2 = _mm256_unpackhi_ps(s0, s1);
+        __m256 t3 = _mm256_unpackhi_ps(s2, s3);
+        __m256 x = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 y = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 z = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+        __m256 r = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+        __m256 negRadius = _mm256_xor_ps(r, sign);
+        __m256 outside = _mm256_setzero_ps();
+
+        for (int i = 0; i < 6; i++)
+        {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(planes[i].x), x),
+                _mm256_mul_ps(_mm256_set1_ps(planes[i].y), y)),
+                _mm256_mul_ps(_mm256_set1_ps(planes[i].z), z)),
+                _mm256_set1_ps(planes[i].w));
+            outside = _mm256_or_ps(outside,
+                _mm256_cmp_ps(distance, negRadius, _CMP_LT_OQ));
+        }
+
+        // the low half holds spheres 0 to 3, the high one 4 to 7
+        int mask = _mm256_movemask_ps(outside);
+        for (int lane = 0; lane < 8; lane++)
+        {
+            bool out = (mask >> lane) & 1;
+            drawn[sphere + lane] = visible[sphere + lane] && !out;
+            if (visible[sphere + lane] && out)
+                culled++;
+        }
+    }
+
+    return culled + cullSpheresScalar(planes, spheres + sphere,
+        visible + sphere, count - sphere, drawn + sphere);
+}
+
+#endif /* KERNELS_X86 */
+
+
+MeshKernels& MeshKernels::instance()
+{
+    static MeshKernels kernels;
+    return kernels;
+}
+
+
+const char* MeshKernels::levelName(Level level)
+{
+    switch (level)
+    {
+        case SCALAR:
+            return "scalar";
+
+        case SSE2:
+            return "SSE2";
+
+        case AVX2:
+            return "AVX2";
+
+        default:
+            return "unknown";
+    }
+}
+
+
+MeshKernels::MeshKernels()
+{
+    level = SCALAR;
+
+    #if defined(KERNELS_X86) && defined(__SSE2__)
+        level = SSE2;
+
+        // checks that the OS saves the AVX registers too
+        if (__builtin_cpu_supports("avx2"))
+            level = AVX2;
+    #endif
+
+    table = tableOf(level);
+    fallback = false;
+}
+
+
+// the interleaving is bound by the stores, the AVX2 level uses the SSE2
+// version of it
+const MeshKernels::Table* MeshKernels::tableOf(Level level)
+{
+    static const Table scalar = {
+        interleaveScalar, maxLengthScalar, cullSpheresScalar
+    };
+
+    #if defined(KERNELS_X86) && defined(__SSE2__)
+        static const Table sse2 = {
+            interleaveSSE2, maxLengthSSE2, cullSpheresSSE2
+        };
+        static const Table avx2 = {
+            interleaveSSE2, maxLengthAVX2, cullSpheresAVX2
+        };
+
+        if (level == SSE2)
+            return &sse2;
+
+        if (level == AVX2)
+            return &avx2;
+    #endif
+
+    return &scalar;
+}
+
+
+MeshKernels::Level MeshKernels::getLevel()
+{
+    return level;
+}
+
+
+// runs every level the CPU supports on the same generated data and compares
+// the results with the scalar versions, the counts don't divide into whole
+// vectors, so the remainders are checked too, the scalar versions are used
+// from then on if any level differs
+bool MeshKernels::verify()
+{
+    const size_t count = 1001;
+
+    // a fixed LCG, the data is the same in every run
+    uint32_t seed = 12345;
+    auto next = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / (1 << 24) * 20.0f - 10.0f;
+    };
+
+    std::vector<float> positions(count * 3), texCoords(count * 2),
+        normals(count * 3);
+    std::vector<glm::vec4> spheres(count);
+    std::vector<uint8_t> visible(count);
+    const float color[3] = {0.25f, 0.5f, 0.75f};
+    glm::vec4 planes[6];
+
+    for (float& value : positions)
+        value = next();
+    for (float& value : texCoords)
+        value = next();
+    for (float& value : normals)
+        value = next();
+    for (size_t i = 0; i < count; i++)
+    {
+        spheres[i] = glm::vec4(next(), next(), next(), std::abs(next()) / 4);
+        visible[i] = i % 7 != 0;
+    }
+    for (glm::vec4& plane : planes)
+        plane = glm::vec4(next(), next(), next(), next());
+
+    std::vector<float> expectedVertices(count * 11);
+    std::vector<uint8_t> expectedDrawn(count);
+    interleaveScalar(positions.data(), texCoords.data(), normals.data(),
+        color, count, expectedVertices.data());
+    float expectedLength = maxLengthScalar(positions.data(), count);
+    size_t expectedCulled = cullSpheresScalar(planes, spheres.data(),
+        visible.data(), count, expectedDrawn.data());
+
+    bool matching = true;
+
+    for (int checked = SSE2; checked <= level; checked++)
+    {
+        const Table* kernels = tableOf(static_cast<Level>(checked));
+        std::vector<float> vertices(count * 11);
+        std::vector<uint8_t> drawn(count);
+
+        kernels->interleave(positions.data(), texCoords.data(),
+            normals.data(), color, count, vertices.data());
+        float length = kernels->maxLength(positions.data(), count);
+        size_t culled = kernels->cullSpheres(planes, spheres.data(),
+            visible.data(), count, drawn.data());
+
+        bool same = memcmp(vertices.data(), expectedVertices.data(),
+            vertices.size() * sizeof(float)) == 0 &&
+            length == expectedLength && culled == expectedCulled &&
+            drawn == expectedDrawn;
+
+        #ifdef DEBUG
+            if (!same)
+                std::cout << "Mesh kernels don't match the scalar versions: "
+                    << levelName(static_cast<Level>(checked)) << std::endl;
+        #endif /* DEBUG */
+
+        matching = matching && same;
+    }
+
+    if (!matching)
+    {
+        level = SCALAR;
+        table = tableOf(level);
+        fallback = true;
+    }
+
+    return matching;
+}
+
+
+// true when the scalar versions are used because the vectorized ones gave
+// different results
+bool MeshKernels::getFallback()
+{
+    return fallback;
+}
+
+
+void MeshKernels::interleave(const float* positions, const float* texCoords,
+    const float* normals, const float color[3], size_t count, float* out)
+{
+    table->interleave(positions, texCoords, normals, color, count, out);
+}
+
+
+float MeshKernels::maxLength(const float* positions, size_t count)
+{
+    return table->maxLength(positions, count);
+}
+
+
+size_t MeshKernels::cullSpheres(const glm::vec4 planes[6],
+    const glm::vec4* spheres, const uint8_t* visible, size_t count,
+    uint8_t* drawn)
+{
+    return table->cullSpheres(planes, spheres, visible, count, drawn);
+}
@@ -0,0 +1,61 @@
+#ifndef KERNELS_HPP_
+#define KERNELS_HPP_
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+
+// loops over whole arrays of the mesh and scene data, every kernel has a
+// scalar version and vectorized ones, the best level supported by the CPU is
+// picked when the kernels are first used, all levels give the same results
+class MeshKernels
+{
+public:
+    enum Level
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    static MeshKernels& instance();
+    static const char* levelName(Level level);
+
+    Level getLevel();
+    bool verify();
+    bool getFallback();
+
+    // vertices in the layout of the Object's buffer with the same color for
+    // all of them
+    void interleave(const float* positions, const float* texCoords,
+        const float* normals, const float color[3], size_t count, float* out);
+    // length of the longest of the count vectors (x, y, z)
+    float maxLength(const float* positions, size_t count);
+    // spheres are (center, radius), drawn is set for the visible spheres
+    // inside the frustum, returns the number of the visible ones outside
+    size_t cullSpheres(const glm::vec4 planes[6], const glm::vec4* spheres,
+        const uint8_t* visible, size_t count, uint8_t* drawn);
+
+private:
+    struct Table
+    {
+        void (*interleave)(const float*, const float*, const float*,
+            const float*, size_t, float*);
+        float (*maxLength)(const float*, size_t);
+        size_t (*cullSpheres)(const glm::vec4*, const glm::vec4*,
+            const uint8_t*, size_t, uint8_t*);
+    };
+
+    MeshKernels();
+
+    Level level;
+    const Table* table;
+    // the vectorized versions failed the verification
+    bool fallback;
+
+    static const Table* tableOf(Level level);
+};
+
+
+#endif /* KERNELS_HPP_ */
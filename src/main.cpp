@@ -9,6 +9,8 @@ bool App::OnInit()
     // wxWidgets image handlers are used to open texture images
     wxInitAllImageHandlers();
 
+    Profiler::instance().setThreadName("UI");
+
     frame = new MainFrame();
 
     if (!frame->openGLInitialized())
@@ -24,6 +26,20 @@ wxDEFINE_EVENT(NEW_OBJECT, wxCommandEvent);
 wxBEGIN_EVENT_TABLE(MainFrame, wxFrame)
     EVT_COMMAND(wxID_ANY, NEW_OBJECT, MainFrame::onObjLoad)
     EVT_MENU(LOAD_OBJ, MainFrame::onObjLoad)
+    EVT_MENU(OPEN_SCENE, MainFrame::onOpenScene)
+    EVT_MENU(SAVE_SCENE, MainFrame::onSaveScene)
+    EVT_MENU(CONTINUOUS_RENDERING, MainFrame::onContinuousRendering)
+    EVT_MENU(FPS_LIMIT, MainFrame::onFPSLimit)
+    EVT_MENU(FRAMES_IN_FLIGHT, MainFrame::onFramesInFlight)
+    EVT_MENU(TEXTURE_BUDGET, MainFrame::onTextureBudget)
+    EVT_MENU(SHOW_STATISTICS, MainFrame::onShowStatistics)
+    EVT_MENU(RECORD_TRACE, MainFrame::onRecordTrace)
+    EVT_MENU(PER_OBJECT_GPU, MainFrame::onPerObjectGPU)
+    EVT_MENU(EXPORT_TRACE, MainFrame::onExportTrace)
+    EVT_MENU(RUN_BENCHMARK, MainFrame::onRunBenchmark)
+    EVT_MENU(RECORD_CAMERA_PATH, MainFrame::onRecordCameraPath)
+    EVT_MENU(LOAD_CAMERA_PATH, MainFrame::onLoadCameraPath)
+    EVT_MENU(SAVE_CAMERA_PATH, MainFrame::onSaveCameraPath)
     EVT_MENU(wxID_ABOUT, MainFrame::onAbout)
     EVT_MENU(wxID_EXIT, MainFrame::onExit)
     EVT_CLOSE(MainFrame::onClose)
@@ -44,13 +60,54 @@ MainFrame::MainFrame()
     menuContextFile->Append(Event::LOAD_OBJ, "Load &object...\tCtrl-O",
         "Load OBJ file");
     menuContextFile->AppendSeparator();
+    menuContextFile->Append(Event::OPEN_SCENE, "Op&en scene...\tCtrl-Shift-O",
+        "Replace the scene with a saved one");
+    menuContextFile->Append(Event::SAVE_SCENE, "&Save scene...\tCtrl-S",
+        "Save the objects and textures into a single file");
+    menuContextFile->AppendSeparator();
     menuContextFile->Append(wxID_EXIT);
 
+    wxMenu* menuContextView = new wxMenu;
+    menuContextView->AppendCheckItem(Event::CONTINUOUS_RENDERING,
+        "&Continuous rendering", "Redraw the scene even if nothing changed");
+    menuContextView->Append(Event::FPS_LIMIT, "&FPS limit...",
+        "Set the frame rate limit of continuous rendering");
+    menuContextView->Append(Event::FRAMES_IN_FLIGHT, "Frames in f&light...",
+        "Set how many frames the CPU can prepare ahead of the GPU");
+    menuContextView->Append(Event::TEXTURE_BUDGET, "&Texture memory...",
+        "Set how much GPU memory the textures can use");
+    menuContextView->AppendCheckItem(Event::SHOW_STATISTICS,
+        "Frame &statistics", "Show the frame counters over the scene");
+    menuContextView->Check(Event::SHOW_STATISTICS, true);
+
+    wxMenu* menuContextProfiling = new wxMenu;
+    menuContextProfiling->AppendCheckItem(Event::RECORD_TRACE,
+        "&Record trace", "Record CPU and GPU timings");
+    menuContextProfiling->AppendCheckItem(Event::PER_OBJECT_GPU,
+        "&Per-object GPU timing", "Measure GPU time of every object");
+    menuContextProfiling->AppendSeparator();
+    menuContextProfiling->Append(Event::EXPORT_TRACE, "&Export trace...",
+        "Save recorded timings as Chrome trace JSON");
+
+    wxMenu* menuContextBenchmark = new wxMenu;
+    menuContextBenchmark->Append(Event::RUN_BENCHMARK, "&Run benchmark...",
+        "Replace the scene with a generated one and measure frame times");
+    menuContextBenchmark->AppendSeparator();
+    menuContextBenchmark->AppendCheckItem(Event::RECORD_CAMERA_PATH,
+        "Re&cord camera path", "Record the camera pose of every frame");
+    menuContextBenchmark->Append(Event::LOAD_CAMERA_PATH,
+        "&Load camera path...", "Load a camera path used by the benchmark");
+    menuContextBenchmark->Append(Event::SAVE_CAMERA_PATH,
+        "&Save camera path...", "Save the recorded camera path");
+
     wxMenu* menuContextHelp = new wxMenu;
     menuContextHelp->Append(wxID_ABOUT);
 
     wxMenuBar* menuBar = new wxMenuBar;
     menuBar->Append(menuContextFile, "&File");
+    menuBar->Append(menuContextView, "&View");
+    menuBar->Append(menuContextProfiling, "&Profiling");
+    menuBar->Append(menuContextBenchmark, "&Benchmark");
     menuBar->Append(menuContextHelp, "&Help");
 
     SetMenuBar(menuBar);
@@ -118,6 +175,281 @@ void MainFrame::onObjLoad(wxCommandEvent&)
 }
 
 
+void MainFrame::onOpenScene(wxCommandEvent&)
+{
+    std::shared_ptr<GraphicsManager> manager = canvas->getGraphicsManager();
+    int oldObjects = manager->getObjectCount();
+
+    if (oldObjects > 0 && wxMessageBox("Opening a scene deletes all objects "
+        "in the current one. Do you wish to continue?", "Open scene",
+        wxICON_QUESTION | wxYES_NO, this) != wxYES)
+        return;
+
+    wxFileDialog fileDialog(this, "Open scene", "", "",
+        "Whisk scene (*.whisk)|*.whisk", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+
+    if (fileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    std::shared_ptr<SceneFile> saved;
+    {
+        wxBusyCursor busy;
+        saved = SceneFile::read(fileDialog.GetPath().ToStdString());
+    }
+
+    if (saved == nullptr)
+    {
+        wxMessageBox("The scene file is not valid", "Scene load error",
+            wxOK | wxICON_ERROR, this);
+        return;
+    }
+
+    // from the end, so the list doesn't move
+    for (int i = oldObjects - 1; i >= 0; i--)
+        manager->deleteObject(manager->getObjectAt(i));
+
+    manager->restoreScene(saved);
+}
+
+
+// the render thread collects the geometry, the file is written after it
+// comes back
+void MainFrame::onSaveScene(wxCommandEvent&)
+{
+    wxFileDialog fileDialog(this, "Save scene", "", "scene.whisk",
+        "Whisk scene (*.whisk)|*.whisk", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+    if (fileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    std::string path = fileDialog.GetPath().ToStdString();
+
+    canvas->getGraphicsManager()->requestSceneFile(
+        [this, path](std::shared_ptr<SceneFile> saved){
+            CallAfter([this, path, saved]{
+                wxBusyCursor busy;
+                if (!saved->write(path))
+                    wxMessageBox("The scene failed to save",
+                        "Scene save error", wxOK | wxICON_ERROR, this);
+            });
+        });
+}
+
+
+void MainFrame::onContinuousRendering(wxCommandEvent& event)
+{
+    canvas->setContinuousRendering(event.IsChecked());
+}
+
+
+void MainFrame::onFPSLimit(wxCommandEvent&)
+{
+    long cap = wxGetNumberFromUser("Frame rate limit of continuous rendering",
+        "FPS:", "FPS limit", canvas->getFPSCap(), 1, 1000, this);
+
+    // -1 is returned when the user cancels the dialog
+    if (cap == -1)
+        return;
+
+    canvas->setFPSCap(cap);
+}
+
+
+void MainFrame::onFramesInFlight(wxCommandEvent&)
+{
+    long count = wxGetNumberFromUser("Number of frames the CPU can prepare "
+        "before waiting for the GPU", "Frames:", "Frames in flight",
+        canvas->getFramesInFlight(), 1, 3, this);
+
+    if (count == -1)
+        return;
+
+    canvas->setFramesInFlight(count);
+}
+
+
+void MainFrame::onTextureBudget(wxCommandEvent&)
+{
+    std::shared_ptr<GraphicsManager> manager = canvas->getGraphicsManager();
+
+    long budget = wxGetNumberFromUser("GPU memory the textures can use, "
+        "the textures lose their detailed levels above it", "Megabytes:",
+        "Texture memory", manager->getTextureBudget(), 16, 16384, this);
+
+    if (budget == -1)
+        return;
+
+    manager->setTextureBudget(budget);
+}
+
+
+void MainFrame::onShowStatistics(wxCommandEvent& event)
+{
+    canvas->getGraphicsManager()->setHUDEnabled(event.IsChecked());
+}
+
+
+void MainFrame::onRecordTrace(wxCommandEvent& event)
+{
+    Profiler::instance().setEnabled(event.IsChecked());
+}
+
+
+void MainFrame::onPerObjectGPU(wxCommandEvent& event)
+{
+    Profiler::instance().setPerObjectGPU(event.IsChecked());
+}
+
+
+void MainFrame::onExportTrace(wxCommandEvent&)
+{
+    wxFileDialog fileDialog(this, "Export trace", "", "trace.json",
+        "JSON (*.json)|*.json", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+    if (fileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    if (!Profiler::instance().exportTrace(
+        fileDialog.GetPath().ToStdString()))
+        wxMessageBox("The trace file failed to save", "Trace export error",
+        wxOK | wxICON_ERROR, this);
+}
+
+
+void MainFrame::onRunBenchmark(wxCommandEvent&)
+{
+    if (canvas->getBenchmarkRunning())
+        return;
+
+    std::shared_ptr<GraphicsManager> manager = canvas->getGraphicsManager();
+    int oldObjects = manager->getObjectCount();
+
+    if (oldObjects > 0 && wxMessageBox("The benchmark deletes all objects in "
+        "the scene. Do you wish to continue?", "Benchmark",
+        wxICON_QUESTION | wxYES_NO, this) != wxYES)
+        return;
+
+    SceneParams params;
+
+    long objects = wxGetNumberFromUser("Number of generated objects",
+        "Objects:", "Benchmark scene", params.objectCount, 1, 10000, this);
+    if (objects == -1)
+        return;
+
+    long triangles = wxGetNumberFromUser("Number of triangles of every object",
+        "Triangles:", "Benchmark scene", params.trianglesPerObject, 2, 1000000,
+        this);
+    if (triangles == -1)
+        return;
+
+    params.objectCount = objects;
+    params.trianglesPerObject = triangles;
+
+    // from the end, so the list doesn't move
+    for (int i = oldObjects - 1; i >= 0; i--)
+        manager->deleteObject(manager->getObjectAt(i));
+
+    std::shared_ptr<Benchmark> benchmark = std::make_shared<Benchmark>();
+
+    wxBusyCursor busy;
+    if (!benchmark->generateScene(manager.get(), params,
+        wxFileName::GetTempDir().ToStdString()))
+    {
+        wxMessageBox("The benchmark scene failed to generate",
+            "Benchmark error", wxOK | wxICON_ERROR, this);
+        return;
+    }
+
+    // without a recorded path the camera circles around the scene
+    if (cameraPath != nullptr && cameraPath->size() > 0)
+        benchmark->setCameraPath(cameraPath);
+    else
+        benchmark->setCameraPath(CameraPath::orbit(600,
+            benchmark->getSceneRadius()));
+
+    SetStatusText("Running benchmark...");
+    canvas->runBenchmark(benchmark);
+}
+
+
+void MainFrame::benchmarkFinished(std::shared_ptr<Benchmark> benchmark)
+{
+    SetStatusText("");
+
+    if (wxMessageBox(benchmark->summary() + "\n\nDo you wish to save the "
+        "results?", "Benchmark finished", wxICON_INFORMATION | wxYES_NO,
+        this) != wxYES)
+        return;
+
+    wxFileDialog fileDialog(this, "Save benchmark results", "",
+        "benchmark.json", "JSON (*.json)|*.json",
+        wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+    if (fileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    if (!benchmark->writeJSON(fileDialog.GetPath().ToStdString()))
+        wxMessageBox("The benchmark results failed to save",
+            "Benchmark error", wxOK | wxICON_ERROR, this);
+}
+
+
+void MainFrame::decodeTexture(std::string path, int key)
+{
+    canvas->decodeTexture(path, key);
+}
+
+
+void MainFrame::onRecordCameraPath(wxCommandEvent& event)
+{
+    // a new recording replaces the previous path
+    if (event.IsChecked())
+        cameraPath = std::make_shared<CameraPath>();
+
+    canvas->getGraphicsManager()->recordCameraPath(
+        event.IsChecked() ? cameraPath : nullptr);
+}
+
+
+void MainFrame::onLoadCameraPath(wxCommandEvent&)
+{
+    wxFileDialog fileDialog(this, "Load camera path", "", "",
+        "Camera path (*.path)|*.path", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+
+    if (fileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    std::shared_ptr<CameraPath> path = std::make_shared<CameraPath>();
+
+    if (path->load(fileDialog.GetPath().ToStdString()))
+        cameraPath = path;
+    else
+        wxMessageBox("The camera path file is not valid", "Camera path error",
+            wxOK | wxICON_ERROR, this);
+}
+
+
+void MainFrame::onSaveCameraPath(wxCommandEvent&)
+{
+    if (cameraPath == nullptr || cameraPath->size() == 0)
+    {
+        wxMessageBox("No camera path was recorded", "Camera path error",
+            wxOK | wxICON_ERROR, this);
+        return;
+    }
+
+    wxFileDialog fileDialog(this, "Save camera path", "", "camera.path",
+        "Camera path (*.path)|*.path", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+    if (fileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    if (!cameraPath->save(fileDialog.GetPath().ToStdString()))
+        wxMessageBox("The camera path failed to save", "Camera path error",
+            wxOK | wxICON_ERROR, this);
+}
+
+
 void MainFrame::onAbout(wxCommandEvent&)
 {
     wxMessageBox("This is a programming project for maturita exam",
@@ -154,119 +486,333 @@ SidePanel::SidePanel(MainFrame* parent,
     ObjectList* objects = new ObjectList(this, parent, manager);
     sizer->Add(objects, 1, wxEXPAND);
 
-    ObjectSettings* settings = new ObjectSettings(this, objects->getListbox(),
-        manager);
+    ObjectSettings* settings = new ObjectSettings(this, manager);
     sizer->Add(settings, 0, wxUP, 10);
 
+    MemoryPanel* memory = new MemoryPanel(this, manager);
+    sizer->Add(memory, 0, wxEXPAND | wxUP, 10);
+
     SetMaxSize(wxSize(290, -1));
 
     SetSizer(sizer);
+}
+
 
-    timer = new SidePanelRefreshTimer(manager, settings, objects->getListbox());
+ObjectListModel::ObjectListModel(std::shared_ptr<GraphicsManager> manager)
+    : wxDataViewVirtualListModel(manager->getObjectCount()),
+    graphicsManager(manager)
+{
 }
 
 
-SidePanel::~SidePanel()
+unsigned ObjectListModel::GetColumnCount() const
 {
-    delete timer;
+    return COLUMNS;
 }
 
 
-wxBEGIN_EVENT_TABLE(ObjectList, wxPanel)
-    EVT_CHECKLISTBOX(wxID_ANY, ObjectList::onCheckBox)
-wxEND_EVENT_TABLE()
+wxString ObjectListModel::GetColumnType(unsigned column) const
+{
+    return column == SHOW ? "bool" : "string";
+}
 
 
-// https://zetcode.com/gui/wxwidgets/widgetsII/
-ObjectList::ObjectList(SidePanel* parent, MainFrame* main, 
-    std::shared_ptr<GraphicsManager> manager)
-    : wxPanel(parent, wxID_ANY), graphicsManager(manager)
+unsigned ObjectListModel::GetCount() const
 {
-    wxBoxSizer* sizer = new wxBoxSizer(wxHORIZONTAL);
+    return filtered() ? rows.size() : graphicsManager->getObjectCount();
+}
 
-    listbox = new wxCheckListBox(this, wxID_ANY);
-    sizer->Add(listbox, 3, wxEXPAND | wxALL, 5);
 
-    buttons = new ObjectButtonPanel(graphicsManager, this, main, listbox);
-    sizer->Add(buttons, 1, wxEXPAND | wxRIGHT, 5);
+void ObjectListModel::GetValueByRow(wxVariant& value, unsigned row,
+    unsigned column) const
+{
+    ObjectHandle object = graphicsManager->getObjectAt(objectAt(row));
 
-    SetSizer(sizer);
+    if (column == SHOW)
+        value = graphicsManager->getObjectShow(object);
+    else
+        value = wxString(graphicsManager->getObjectName(object));
 }
 
 
-wxCheckListBox* ObjectList::getListbox()
+// the check box changes the visibility through the manager, the row is
+// updated when its event comes back
+bool ObjectListModel::SetValueByRow(const wxVariant& value, unsigned row,
+    unsigned column)
 {
-    return listbox;
+    ObjectHandle object = graphicsManager->getObjectAt(objectAt(row));
+
+    if (column != SHOW ||
+        value.GetBool() == graphicsManager->getObjectShow(object))
+        return false;
+
+    graphicsManager->showOrHideObject(object);
+    return true;
 }
 
 
+// the names are compared without case, an empty text shows every object
+void ObjectListModel::setFilter(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+    filter = text;
+
+    rows.clear();
+    rows.shrink_to_fit();
+
+    if (filtered())
+        for (int idx = 0; idx < graphicsManager->getObjectCount(); idx++)
+            if (matches(idx))
+                rows.push_back(idx);
+
+    Reset(GetCount());
+}
+
 
-SidePanelRefreshTimer::SidePanelRefreshTimer(
-    std::shared_ptr<GraphicsManager> manager, ObjectSettings* settings,
-    wxCheckListBox* list)
-    : graphicsManager(manager), objectSettings(settings), listbox(list)
+bool ObjectListModel::filtered() const
 {
-    lastSelected = wxNOT_FOUND;
+    return !filter.empty();
+}
+
 
-    // refreshes every ~48 ms
-    StartOnce(48);
+int ObjectListModel::objectAt(unsigned row) const
+{
+    return filtered() ? rows[row] : row;
 }
 
 
-SidePanelRefreshTimer::~SidePanelRefreshTimer()
+// -1 when the object doesn't match the filter
+int ObjectListModel::rowOf(int idx) const
 {
-    Stop();
+    if (!filtered())
+        return idx;
+
+    auto it = std::lower_bound(rows.begin(), rows.end(), idx);
+    if (it == rows.end() || *it != idx)
+        return -1;
+
+    return it - rows.begin();
 }
 
 
-wxDEFINE_EVENT(REFRESH_OBJECT_SETTINGS, wxCommandEvent);
+bool ObjectListModel::matches(int idx) const
+{
+    std::string name =
+        graphicsManager->getObjectName(graphicsManager->getObjectAt(idx));
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    return name.find(filter) != std::string::npos;
+}
 
-void SidePanelRefreshTimer::Notify()
+
+// the objects after the new one move by one index
+void ObjectListModel::objectAdded(int idx)
 {
-    std::vector<std::string> newNames = graphicsManager->getAllObjectNames();
+    if (!filtered())
+    {
+        RowInserted(idx);
+        return;
+    }
+
+    auto it = std::lower_bound(rows.begin(), rows.end(), idx);
+    for (auto moved = it; moved != rows.end(); moved++)
+        (*moved)++;
 
-    // check every item in the listbox and edit the list if anything changed
-    for (size_t i = 0; i < newNames.size(); i++)
+    if (matches(idx))
     {
-        if (i >= names.GetCount())
-        {
-            names.Add(newNames[i]);
-            listbox->InsertItems(1, &names[i], i);
-        }
-        else if (newNames[i] != names[i])
-        {
-            names[i] = newNames[i];
-            listbox->SetString(i, names[i]);
-        }
-            
-        if (graphicsManager->getObjectShow(i) != listbox->IsChecked(i))
-            listbox->Check(i, graphicsManager->getObjectShow(i));
+        int row = it - rows.begin();
+        rows.insert(it, idx);
+        RowInserted(row);
     }
+}
+
 
-    for (size_t i = newNames.size(); i < names.GetCount(); i++)
+void ObjectListModel::objectRemoved(int idx)
+{
+    if (!filtered())
     {
-        names.RemoveAt(i, 1);
-        listbox->Delete(i);
+        RowDeleted(idx);
+        return;
     }
 
-    int idx = listbox->GetSelection();
-    if (lastSelected != listbox->GetSelection())
+    int row = rowOf(idx);
+    auto it = std::upper_bound(rows.begin(), rows.end(), idx);
+    for (auto moved = it; moved != rows.end(); moved++)
+        (*moved)--;
+
+    if (row != -1)
     {
-        // refreshing is done by ObjectSettings itself
-        wxEvent* event = new wxCommandEvent(REFRESH_OBJECT_SETTINGS);
-        wxQueueEvent(objectSettings, event);
-        lastSelected = idx;
+        rows.erase(rows.begin() + row);
+        RowDeleted(row);
     }
+}
+
 
-    // launch the time again
-    StartOnce();
+// a new name can start or stop matching the filter
+void ObjectListModel::objectRenamed(int idx)
+{
+    int row = rowOf(idx);
+
+    if (!filtered() || (row != -1 && matches(idx)))
+        RowValueChanged(row, NAME);
+    else if (row != -1)
+    {
+        rows.erase(rows.begin() + row);
+        RowDeleted(row);
+    }
+    else if (matches(idx))
+    {
+        auto it = std::lower_bound(rows.begin(), rows.end(), idx);
+        row = it - rows.begin();
+        rows.insert(it, idx);
+        RowInserted(row);
+    }
 }
 
 
-void ObjectList::onCheckBox(wxCommandEvent& event)
+void ObjectListModel::objectChanged(int idx, Column column)
 {
-    int itemIdx = event.GetInt();
-    graphicsManager->showOrHideObject(itemIdx);
+    int row = rowOf(idx);
+    if (row != -1)
+        RowValueChanged(row, column);
+}
+
+
+wxBEGIN_EVENT_TABLE(ObjectList, wxPanel)
+    EVT_DATAVIEW_SELECTION_CHANGED(wxID_ANY, ObjectList::onSelect)
+    EVT_TEXT(wxID_ANY, ObjectList::onSearch)
+    EVT_SEARCH(wxID_ANY, ObjectList::onSearchNext)
+wxEND_EVENT_TABLE()
+
+
+// https://docs.wxwidgets.org/3.1/classwx_data_view_virtual_list_model.html
+ObjectList::ObjectList(SidePanel* parent, MainFrame* main, 
+    std::shared_ptr<GraphicsManager> manager)
+    : wxPanel(parent, wxID_ANY), graphicsManager(manager)
+{
+    wxBoxSizer* sizer = new wxBoxSizer(wxHORIZONTAL);
+    wxBoxSizer* listSizer = new wxBoxSizer(wxVERTICAL);
+
+    search = new wxSearchCtrl(this, wxID_ANY, "", wxDefaultPosition,
+        wxDefaultSize, wxTE_PROCESS_ENTER);
+    search->SetDescriptiveText("Filter by name");
+    search->ShowCancelButton(true);
+    listSizer->Add(search, 0, wxEXPAND | wxBOTTOM, 5);
+
+    view = new wxDataViewCtrl(this, wxID_ANY, wxDefaultPosition,
+        wxDefaultSize, wxDV_SINGLE | wxDV_NO_HEADER | wxDV_ROW_LINES);
+    model = new ObjectListModel(graphicsManager);
+    view->AssociateModel(model);
+    // the view owns the model from now on
+    model->DecRef();
+
+    view->AppendToggleColumn("", ObjectListModel::SHOW,
+        wxDATAVIEW_CELL_ACTIVATABLE, 24);
+    view->AppendTextColumn("Name", ObjectListModel::NAME);
+    listSizer->Add(view, 1, wxEXPAND);
+
+    sizer->Add(listSizer, 3, wxEXPAND | wxALL, 5);
+
+    buttons = new ObjectButtonPanel(graphicsManager, this, main);
+    sizer->Add(buttons, 1, wxEXPAND | wxRIGHT, 5);
+
+    SetSizer(sizer);
+
+    subscription = graphicsManager->subscribe(
+        [this](const SceneEvent& event){ onSceneEvent(event); });
+}
+
+
+ObjectList::~ObjectList()
+{
+    graphicsManager->unsubscribe(subscription);
+}
+
+
+void ObjectList::selectRow(int row)
+{
+    if (row == -1)
+    {
+        view->UnselectAll();
+        return;
+    }
+
+    wxDataViewItem item = model->GetItem(row);
+    view->Select(item);
+    view->EnsureVisible(item);
+}
+
+
+// only the changed row is updated, the rows are read again when they are
+// drawn
+void ObjectList::onSceneEvent(const SceneEvent& event)
+{
+    int idx = event.index;
+
+    switch (event.type)
+    {
+        case SceneEvent::OBJECT_ADDED:
+            model->objectAdded(idx);
+            break;
+
+        case SceneEvent::OBJECT_REMOVED:
+            model->objectRemoved(idx);
+            break;
+
+        case SceneEvent::OBJECT_RENAMED:
+            model->objectRenamed(idx);
+            break;
+
+        case SceneEvent::OBJECT_VISIBILITY:
+            model->objectChanged(idx, ObjectListModel::SHOW);
+            break;
+
+        case SceneEvent::OBJECT_SELECTED:
+            selectRow(idx == -1 ? -1 : model->rowOf(idx));
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void ObjectList::onSelect(wxDataViewEvent& event)
+{
+    wxDataViewItem item = event.GetItem();
+    graphicsManager->selectObject(item.IsOk() ? graphicsManager->getObjectAt(
+        model->objectAt(model->GetRow(item))) : ObjectHandle());
+}
+
+
+// type-ahead, the first matching object gets selected while typing
+void ObjectList::onSearch(wxCommandEvent&)
+{
+    model->setFilter(search->GetValue().ToStdString());
+
+    int selected = graphicsManager->getObjectPosition(
+        graphicsManager->getSelectedObject());
+    int row = selected == -1 ? -1 : model->rowOf(selected);
+
+    if (row == -1 && model->filtered() && model->GetCount() > 0)
+        graphicsManager->selectObject(
+            graphicsManager->getObjectAt(model->objectAt(0)));
+    else
+        selectRow(row);
+}
+
+
+// enter jumps to the next match
+void ObjectList::onSearchNext(wxCommandEvent&)
+{
+    if (model->GetCount() == 0)
+        return;
+
+    int selected = graphicsManager->getObjectPosition(
+        graphicsManager->getSelectedObject());
+    int row = selected == -1 ? -1 : model->rowOf(selected);
+
+    graphicsManager->selectObject(graphicsManager->getObjectAt(
+        model->objectAt((row + 1) % model->GetCount())));
 }
 
 
@@ -280,10 +826,9 @@ wxBEGIN_EVENT_TABLE(ObjectButtonPanel, wxPanel)
 wxEND_EVENT_TABLE()
 
 ObjectButtonPanel::ObjectButtonPanel(std::shared_ptr<GraphicsManager> manager,
-    wxPanel* parentPanel, MainFrame* main, wxCheckListBox* target)
+    wxPanel* parentPanel, MainFrame* main)
     : wxPanel(parentPanel, wxID_ANY), mainFrame(main), graphicsManager(manager)
 {
-    targetListbox = target;
     wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
     
     wxStaticText* label = new wxStaticText(this, wxID_ANY, "Objects");
@@ -320,11 +865,11 @@ void ObjectButtonPanel::onNew(wxCommandEvent&)
 
 void ObjectButtonPanel::onRename(wxCommandEvent&)
 {
-    int idx = targetListbox->GetSelection();
-    if (idx == wxNOT_FOUND)
+    ObjectHandle object = graphicsManager->getSelectedObject();
+    if (object.isNull())
         return;
     
-    RenameFrame* frame = new RenameFrame(mainFrame, graphicsManager, idx);
+    RenameFrame* frame = new RenameFrame(mainFrame, graphicsManager, object);
     frame->Show();
 
     // prevent user from interacting with the main frame
@@ -334,12 +879,12 @@ void ObjectButtonPanel::onRename(wxCommandEvent&)
 
 void ObjectButtonPanel::onColor(wxCommandEvent&)
 {
-    int idx = targetListbox->GetSelection();
-    if (idx == wxNOT_FOUND)
+    ObjectHandle object = graphicsManager->getSelectedObject();
+    if (object.isNull())
         return;
     
     std::tuple<GLfloat, GLfloat, GLfloat> oldClrTuple =
-        graphicsManager->getObjectColor(idx);
+        graphicsManager->getObjectColor(object);
     
     wxColourData oldClrData;
     oldClrData.SetColour(wxColour(
@@ -354,18 +899,18 @@ void ObjectButtonPanel::onColor(wxCommandEvent&)
 
     wxColour clr = dialog.GetColourData().GetColour();
 
-    graphicsManager->setObjectColor(idx, clr.Red() / 255.0f,
+    graphicsManager->setObjectColor(object, clr.Red() / 255.0f,
         clr.Green() / 255.0f, clr.Blue() / 255.0f);
 }
 
 
 void ObjectButtonPanel::onTexture(wxCommandEvent&)
 {
-    int idx = targetListbox->GetSelection();
-    if (idx == wxNOT_FOUND)
+    ObjectHandle object = graphicsManager->getSelectedObject();
+    if (object.isNull())
         return;
     
-    TextureFrame* frame = new TextureFrame(mainFrame, graphicsManager, idx);
+    TextureFrame* frame = new TextureFrame(mainFrame, graphicsManager, object);
     frame->Show();
     mainFrame->Disable();
 }
@@ -373,21 +918,21 @@ void ObjectButtonPanel::onTexture(wxCommandEvent&)
 
 void ObjectButtonPanel::onDuplicate(wxCommandEvent&)
 {
-    int idx = targetListbox->GetSelection();
-    if (idx == wxNOT_FOUND)
+    ObjectHandle object = graphicsManager->getSelectedObject();
+    if (object.isNull())
         return;
     
-    graphicsManager->duplicateObject(idx);
+    graphicsManager->duplicateObject(object);
 }
 
 
 void ObjectButtonPanel::onDelete(wxCommandEvent&)
 {
-    int idx = targetListbox->GetSelection();
-    if (idx == wxNOT_FOUND)
+    ObjectHandle object = graphicsManager->getSelectedObject();
+    if (object.isNull())
         return;
 
-    graphicsManager->deleteObject(idx);
+    graphicsManager->deleteObject(object);
 }
 
 
@@ -396,14 +941,14 @@ wxBEGIN_EVENT_TABLE(RenameFrame, wxFrame)
 wxEND_EVENT_TABLE()
 
 RenameFrame::RenameFrame(MainFrame* parent,
-    std::shared_ptr<GraphicsManager> manager, int idx)
+    std::shared_ptr<GraphicsManager> manager, ObjectHandle object)
     : wxFrame(parent, wxID_ANY, "Rename", wxDefaultPosition, wxDefaultSize,
     wxCAPTION | wxFRAME_FLOAT_ON_PARENT), mainFrame(parent),
-    graphicsManager(manager), objIdx(idx)
+    graphicsManager(manager), targetObject(object)
 {
     wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
 
-    textField = new wxTextCtrl(this, wxID_ANY, manager->getObjectName(idx),
+    textField = new wxTextCtrl(this, wxID_ANY, manager->getObjectName(object),
         wxDefaultPosition, wxDefaultSize, wxTE_PROCESS_ENTER);
     textField->SetMaxLength(24);
     sizer->Add(textField, 0, wxEXPAND);
@@ -431,7 +976,9 @@ RenameFrame::~RenameFrame()
 
 void RenameFrame::onEnter(wxCommandEvent&)
 {
-    graphicsManager->renameObject(objIdx, textField->GetValue().ToStdString());
+    // the manager ignores the handle if the object was deleted meanwhile
+    graphicsManager->renameObject(targetObject,
+        textField->GetValue().ToStdString());
     Close();
 }
 
@@ -470,9 +1017,10 @@ void RenameFrameButtonPanel::onCancel(wxCommandEvent&)
 
 
 TextureFrame::TextureFrame(MainFrame* parent, 
-    std::shared_ptr<GraphicsManager> manager, int idx)
+    std::shared_ptr<GraphicsManager> manager, ObjectHandle object)
     : wxFrame(parent, wxID_ANY, "Textures", wxDefaultPosition, wxDefaultSize,
-    wxCAPTION | wxFRAME_FLOAT_ON_PARENT), mainFrame(parent)
+    wxCAPTION | wxFRAME_FLOAT_ON_PARENT), mainFrame(parent),
+    graphicsManager(manager)
 {
     wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
 
@@ -489,7 +1037,7 @@ TextureFrame::TextureFrame(MainFrame* parent,
     }
 
     TextureFrameButtonPanel* buttons = new TextureFrameButtonPanel(this,
-        manager, listBox, idx);
+        manager, listBox, object);
     sizer->Add(buttons, 0, wxTOP, 2);
 
     SetBackgroundColour(wxSystemSettings::GetColour(wxSYS_COLOUR_MENU));
@@ -503,15 +1051,29 @@ TextureFrame::TextureFrame(MainFrame* parent,
         (parent->GetSize().GetWidth() - GetSize().GetWidth())/2,
         (parent->GetSize().GetHeight() - GetSize().GetHeight())/2);
     SetPosition(newRect.GetPosition());
+
+    subscription = graphicsManager->subscribe(
+        [this](const SceneEvent& event){ onSceneEvent(event); });
 }
 
 
 TextureFrame::~TextureFrame()
 {
+    graphicsManager->unsubscribe(subscription);
     mainFrame->Enable();
 }
 
 
+// the textures are also removed when a decoded file turns out to be in the
+// library already
+void TextureFrame::onSceneEvent(const SceneEvent& event)
+{
+    if (event.type == SceneEvent::TEXTURE_REMOVED &&
+        static_cast<unsigned int>(event.index) < listBox->GetCount())
+        listBox->Delete(event.index);
+}
+
+
 wxBEGIN_EVENT_TABLE(TextureFrameButtonPanel, wxPanel)
     EVT_BUTTON(wxID_NEW, TextureFrameButtonPanel::onNew)
     EVT_BUTTON(wxID_DELETE, TextureFrameButtonPanel::onDelete)
@@ -520,9 +1082,10 @@ wxBEGIN_EVENT_TABLE(TextureFrameButtonPanel, wxPanel)
 wxEND_EVENT_TABLE()
 
 TextureFrameButtonPanel::TextureFrameButtonPanel(TextureFrame* parent,
-    std::shared_ptr<GraphicsManager> manager, wxListBox* target, int idx)
+    std::shared_ptr<GraphicsManager> manager, wxListBox* target,
+    ObjectHandle object)
     : wxPanel(parent), parentFrame(parent), graphicsManager(manager),
-    targetListBox(target), objIdx(idx)
+    targetListBox(target), targetObject(object)
 {
     wxGridSizer* sizer = new wxGridSizer(2, 12, 6);
 
@@ -551,32 +1114,33 @@ void TextureFrameButtonPanel::onNew(wxCommandEvent&)
     if (loadFileDialog.ShowModal() == wxID_CANCEL)
         return;
 
-    wxImage image(loadFileDialog.GetPath());
-
-    if (!image.IsOk())
+    // only the header is read here, the image is decoded by a job
+    if (!wxImage::CanRead(loadFileDialog.GetPath()))
     {
         wxMessageBox("The texture file is not a valid image file",
                 "Texture load error", wxOK | wxICON_ERROR, this);
         return;
     }
 
-    // texture need to be vertically mirrored for OpenGL to show them correctly
-    image = image.Mirror(false);
-
     std::string path(loadFileDialog.GetPath());
 
     #ifdef DEBUG
         std::cout << "Texture file opened: " << path << std::endl;
     #endif /* DEBUG */
-    
+
     std::regex fileNameRegex("[^\\\\]*$");
     std::smatch fileName;
 
     std::regex_search(path, fileName, fileNameRegex);
 
     wxString name(fileName[0]);
-    graphicsManager->addTexture(image.GetData(),
-        image.GetWidth(), image.GetHeight(), name.ToStdString());
+
+    // a placeholder is shown until the image is decoded and uploaded, the
+    // file is hashed by the decoder too, a file which is already in the
+    // library is removed again then
+    int key = graphicsManager->reserveTexture(name.ToStdString(), 0);
+    static_cast<MainFrame*>(parentFrame->GetParent())->decodeTexture(path,
+        key);
 
     targetListBox->InsertItems(1, &name, targetListBox->GetCount());
 }
@@ -589,8 +1153,8 @@ void TextureFrameButtonPanel::onDelete(wxCommandEvent&)
     if (idx == wxNOT_FOUND)
         return;
     
+    // the list box is updated by the frame's subscription
     graphicsManager->deleteTexture(idx);
-    targetListBox->Delete(idx);
 }
 
 
@@ -601,7 +1165,7 @@ void TextureFrameButtonPanel::onOk(wxCommandEvent&)
     if (idx == wxNOT_FOUND)
         return;
     
-    graphicsManager->setObjectTex(objIdx, graphicsManager->getTexPtr(idx));
+    graphicsManager->setObjectTex(targetObject, idx);
     parentFrame->Close();
 }
 
@@ -612,17 +1176,135 @@ void TextureFrameButtonPanel::onCancel(wxCommandEvent&)
 }
 
 
+wxBEGIN_EVENT_TABLE(MemoryPanel, wxPanel)
+    EVT_BUTTON(wxID_SAVE, MemoryPanel::onExport)
+    EVT_TIMER(wxID_ANY, MemoryPanel::onTimer)
+wxEND_EVENT_TABLE()
+
+MemoryPanel::MemoryPanel(wxPanel* parent,
+    std::shared_ptr<GraphicsManager> manager)
+    : wxPanel(parent, wxID_ANY), graphicsManager(manager), refreshTimer(this)
+{
+    reportPending = false;
+
+    wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
+    wxBoxSizer* topSizer = new wxBoxSizer(wxHORIZONTAL);
+
+    totals = new wxStaticText(this, wxID_ANY, "Memory");
+    topSizer->Add(totals, 1, wxALIGN_CENTER_VERTICAL | wxLEFT, 3);
+
+    wxButton* exportButton = new wxButton(this, wxID_SAVE, "Export...");
+    topSizer->Add(exportButton, 0);
+
+    sizer->Add(topSizer, 0, wxEXPAND | wxLEFT | wxRIGHT, 5);
+
+    list = new wxListCtrl(this, wxID_ANY, wxDefaultPosition, wxSize(-1, 130),
+        wxLC_REPORT | wxLC_SINGLE_SEL);
+    list->InsertColumn(0, "Name", wxLIST_FORMAT_LEFT, 130);
+    list->InsertColumn(1, "CPU", wxLIST_FORMAT_RIGHT, 65);
+    list->InsertColumn(2, "GPU", wxLIST_FORMAT_RIGHT, 65);
+    sizer->Add(list, 0, wxEXPAND | wxALL, 5);
+
+    SetSizer(sizer);
+
+    // the streaming changes the memory without any scene event
+    refreshTimer.Start(1000);
+}
+
+
+void MemoryPanel::onTimer(wxTimerEvent&)
+{
+    requestReport();
+}
+
+
+// a new report isn't requested until the previous one arrives, so a busy
+// render thread doesn't get a queue of them
+void MemoryPanel::requestReport()
+{
+    if (reportPending)
+        return;
+
+    reportPending = true;
+    graphicsManager->requestMemoryReport(
+        [this](std::shared_ptr<MemoryReport> newReport){
+            CallAfter([this, newReport]{ showReport(newReport); });
+        });
+}
+
+
+static wxString formatBytes(size_t bytes)
+{
+    if (bytes < 1024 * 1024)
+        return wxString::Format("%.1f kB", bytes / 1024.0f);
+
+    return wxString::Format("%.1f MB", bytes / (1024.0f * 1024.0f));
+}
+
+
+void MemoryPanel::showReport(std::shared_ptr<MemoryReport> newReport)
+{
+    reportPending = false;
+    report = newReport;
+
+    totals->SetLabel("Memory: CPU " + formatBytes(report->getCPUTotal()) +
+        ", GPU " + formatBytes(report->getGPUTotal()));
+
+    // objects are listed first, then textures
+    std::vector<std::pair<wxString, MemoryReport::Entry>> rows;
+    for (MemoryReport::Entry& entry : report->objects)
+        rows.push_back(std::make_pair(wxString(entry.name), entry));
+    for (MemoryReport::Entry& entry : report->textures)
+        rows.push_back(std::make_pair("Texture: " + entry.name, entry));
+
+    while (list->GetItemCount() > static_cast<int>(rows.size()))
+        list->DeleteItem(list->GetItemCount() - 1);
+
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        if (static_cast<int>(i) >= list->GetItemCount())
+            list->InsertItem(i, rows[i].first);
+        else
+            list->SetItem(i, 0, rows[i].first);
+
+        list->SetItem(i, 1, formatBytes(rows[i].second.CPUBytes));
+        list->SetItem(i, 2, formatBytes(rows[i].second.GPUBytes));
+    }
+}
+
+
+void MemoryPanel::onExport(wxCommandEvent&)
+{
+    if (report == nullptr)
+        return;
+
+    // the exported report is the one shown, so the numbers match
+    std::shared_ptr<MemoryReport> shown = report;
+
+    wxFileDialog fileDialog(this, "Export memory report", "", "memory.json",
+        "JSON (*.json)|*.json", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+
+    if (fileDialog.ShowModal() == wxID_CANCEL)
+        return;
+
+    if (!shown->writeJSON(fileDialog.GetPath().ToStdString()))
+        wxMessageBox("The memory report failed to save", "Memory report error",
+            wxOK | wxICON_ERROR, this);
+}
+
+
 wxBEGIN_EVENT_TABLE(ObjectSettings, wxPanel)
-    EVT_COMMAND(wxID_ANY, REFRESH_OBJECT_SETTINGS, ObjectSettings::onRefresh)
     EVT_TEXT_ENTER(wxID_ANY, ObjectSettings::onEnter)
     EVT_SPINCTRLDOUBLE(wxID_ANY, ObjectSettings::onSpinChange)
     EVT_CHOICE(wxID_ANY, ObjectSettings::onModeChange)
 wxEND_EVENT_TABLE()
 
-ObjectSettings::ObjectSettings(wxPanel* parent, wxCheckListBox* list,
+ObjectSettings::ObjectSettings(wxPanel* parent,
     std::shared_ptr<GraphicsManager> manager)
-    : wxPanel(parent, wxID_ANY), listbox(list), graphicsManager(manager)
+    : wxPanel(parent, wxID_ANY), graphicsManager(manager)
 {
+    applying = false;
+
     wxFlexGridSizer* sizer = new wxFlexGridSizer(7, 10, 5);
 
     wxSize fieldSize = wxSize(61, -1);
@@ -711,32 +1393,54 @@ ObjectSettings::ObjectSettings(wxPanel* parent, wxCheckListBox* list,
     sizer->Add(renderModeChoice);
 
     SetSizer(sizer);
+
+    subscription = graphicsManager->subscribe(
+        [this](const SceneEvent& event){ onSceneEvent(event); });
 };
 
 
-void ObjectSettings::onRefresh(wxCommandEvent&)
+ObjectSettings::~ObjectSettings()
+{
+    graphicsManager->unsubscribe(subscription);
+}
+
+
+// the fields show the selected object, other objects don't matter
+void ObjectSettings::onSceneEvent(const SceneEvent& event)
+{
+    if (applying)
+        return;
+
+    bool selectedChanged = (event.type == SceneEvent::OBJECT_TRANSFORM ||
+        event.type == SceneEvent::OBJECT_APPEARANCE) &&
+        event.object == graphicsManager->getSelectedObject();
+
+    if (event.type == SceneEvent::OBJECT_SELECTED || selectedChanged)
+        refresh();
+}
+
+
+void ObjectSettings::refresh()
 {
-    int idx = listbox->GetSelection();
+    ObjectHandle object = graphicsManager->getSelectedObject();
     
-    if (idx == wxNOT_FOUND)
+    if (object.isNull())
     {
         for (size_t i = 0; i < textFields.size(); i++)
             textFields[i]->SetValue(0);
         return;
     }
 
-    glm::vec3* pos = graphicsManager->getObjectPosVec(idx);
-    glm::vec3* rot = graphicsManager->getObjectRotVec(idx);
-    glm::vec3* size = graphicsManager->getObjectSize(idx);
-    int* mode = graphicsManager->getObjectMode(idx);
+    glm::vec3 pos = graphicsManager->getObjectPos(object);
+    glm::vec3 rot = graphicsManager->getObjectRot(object);
+    glm::vec3 size = graphicsManager->getObjectSize(object);
 
-    float values[] = {(*pos).x, (*pos).y, (*pos).z,
-        (*rot).x, (*rot).y, (*rot).z, (*size).x};
+    float values[] = {pos.x, pos.y, pos.z, rot.x, rot.y, rot.z, size.x};
 
     for (size_t i = 0; i < textFields.size(); i++)
         textFields[i]->SetValue(wxString::Format("%f", values[i]));
 
-    renderModeChoice->SetSelection(*mode);
+    renderModeChoice->SetSelection(graphicsManager->getObjectMode(object));
 }
 
 
@@ -751,53 +1455,59 @@ void ObjectSettings::onSpinChange(wxSpinDoubleEvent& event)
 {
     int fieldID = event.GetId();
 
-    int idx = listbox->GetSelection();
+    ObjectHandle object = graphicsManager->getSelectedObject();
 
-    if (idx == wxNOT_FOUND)
+    if (object.isNull())
     {
         textFields[fieldID]->SetValue(0);
         return;
     }
 
-    glm::vec3* pos = graphicsManager->getObjectPosVec(idx);
-    glm::vec3* rot = graphicsManager->getObjectRotVec(idx);
-    glm::vec3* size = graphicsManager->getObjectSize(idx);
+    glm::vec3 pos = graphicsManager->getObjectPos(object);
+    glm::vec3 rot = graphicsManager->getObjectRot(object);
 
-    float* values[] = {&pos->x, &pos->y, &pos->z,  &rot->x, &rot->y, &rot->z,
-        &size->x, &size->y, &size->z};
+    float* values[] = {&pos.x, &pos.y, &pos.z,  &rot.x, &rot.y, &rot.z};
     
     float fieldValue = textFields[fieldID]->GetValue();
-    
-    *values[fieldID] = fieldValue;
+    applying = true;
 
-    // user edits all 3 size dimensions at once
-    if (fieldID == SIZE)
+    // the changes are sent to the render thread through the manager
+    if (fieldID <= POS_Z)
     {
-        *values[SIZE + 1] = fieldValue;
-        *values[SIZE + 2] = fieldValue;
+        *values[fieldID] = fieldValue;
+        graphicsManager->setObjectPos(object, pos);
     }
+    else if (fieldID <= ROT_Z)
+    {
+        *values[fieldID] = fieldValue;
+        graphicsManager->setObjectRot(object, rot);
+    }
+    // user edits all 3 size dimensions at once
+    else if (fieldID == SIZE)
+        graphicsManager->setObjectSize(object,
+            glm::vec3(fieldValue, fieldValue, fieldValue));
+
+    applying = false;
 }
 
 
 void ObjectSettings::onModeChange(wxCommandEvent&)
 {
-    int idx = listbox->GetSelection();
+    ObjectHandle object = graphicsManager->getSelectedObject();
 
-    if (idx == wxNOT_FOUND)
+    if (object.isNull())
     {
         renderModeChoice->SetSelection(wxNOT_FOUND);
         return;
     }
 
-    int* mode = graphicsManager->getObjectMode(idx);
-    *mode = renderModeChoice->GetSelection();
+    applying = true;
+    graphicsManager->setObjectMode(object, renderModeChoice->GetSelection());
+    applying = false;
 }
 
 
-wxDEFINE_EVENT(RENDER, wxCommandEvent);
-
 wxBEGIN_EVENT_TABLE(Canvas, wxGLCanvas)
-    EVT_COMMAND(wxID_ANY, RENDER, Canvas::onRender)
     EVT_CLOSE(Canvas::onClose)
     EVT_PAINT(Canvas::onPaint)
     EVT_SIZE(Canvas::onSize)
@@ -807,6 +1517,7 @@ wxBEGIN_EVENT_TABLE(Canvas, wxGLCanvas)
     EVT_LEFT_UP(Canvas::onLMBUp)
     EVT_RIGHT_DOWN(Canvas::onRMBDown)
     EVT_RIGHT_UP(Canvas::onRMBUp)
+    EVT_MOTION(Canvas::onMouseMove)
     EVT_MOUSEWHEEL(Canvas::onWheel)
 wxEND_EVENT_TABLE()
 
@@ -818,13 +1529,16 @@ Canvas::Canvas(MainFrame* parent, const wxGLAttributes& canvasAttrs)
 {
     wxGLCtx = nullptr;
     graphicsManager = nullptr;
+    renderThread = nullptr;
     done = false;
     debuggingExt = false;
     cameraSpinning = false;
     cameraMoving = false;
     mouseWheelPos = 0;
-    FPSSmoothing = 0.9f;
-    FPS = 0.0f;
+    continuousRendering = false;
+    FPSCap = 60;
+    framesInFlight = 2;
+    benchmarkRunning = false;
 
     wxGLContextAttrs ctxAttrs;
     ctxAttrs.PlatformDefaults().OGLVersion(OGL_MAJOR_VERSION,
@@ -882,16 +1596,35 @@ Canvas::Canvas(MainFrame* parent, const wxGLAttributes& canvasAttrs)
             return;
     }
 
+    wxString shaderCache = wxStandardPaths::Get().GetUserLocalDataDir() +
+        "/shader_cache";
+    if (!wxFileName::DirExists(shaderCache) &&
+        !wxFileName::Mkdir(shaderCache, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+        shaderCache.clear();
+    ShaderManager::setCacheDirectory(shaderCache.ToStdString());
+
     graphicsManager = std::make_shared<GraphicsManager>(this);
+    graphicsManager->setHUDFont(renderHUDFont());
 
-    renderEvent = new wxCommandEvent(RENDER);
-    lastFlip = std::chrono::steady_clock::now();
-    wxQueueEvent(this, renderEvent);
+    // v-sync
+    if (WGLEW_EXT_swap_control_tear)
+        wglSwapIntervalEXT(-1);
+    else
+        wglSwapIntervalEXT(1);
+
+    // from now on the context is used only by the render thread
+    releaseCurrent();
+    renderThread = new RenderThread(this, graphicsManager);
 }
 
 
 Canvas::~Canvas()
 {
+    // decoded images are still sent to the render thread
+    JobSystem::instance().wait(decoders);
+
+    // the render thread deletes all GL objects and releases the context
+    delete renderThread;
     done = true;
     delete wxGLCtx;
 }
@@ -920,20 +1653,18 @@ bool Canvas::graphicsManagerExists()
 }
 
 
-void Canvas::flip()
+void Canvas::makeCurrent()
 {
-    wxClientDC dc(this);
-
-    graphicsManager->render();
-    SwapBuffers();
+    SetCurrent(*wxGLCtx);
 }
 
 
-float Canvas::viewportAspectRatio()
+// the context can be current only in one thread at a time
+void Canvas::releaseCurrent()
 {
-    float width = static_cast<float>(viewportDims.first);
-    float height = static_cast<float>(viewportDims.second);
-    return width / height;
+    #ifdef _WIN32
+        wglMakeCurrent(NULL, NULL);
+    #endif /* _WIN32 */
 }
 
 
@@ -965,7 +1696,8 @@ MouseInfo Canvas::getMouseInfo()
     MouseInfo ret;
     ret.spinning = cameraSpinning;
     ret.moving = cameraMoving;
-    ret.mousePos = wxGetMousePosition();
+    wxPoint mousePos = wxGetMousePosition();
+    ret.mousePos = glm::ivec2(mousePos.x, mousePos.y);
     ret.wheelPos = mouseWheelPos;
     return ret;
 }
@@ -976,30 +1708,209 @@ void Canvas::showErrorMessage(std::string title, std::string msg)
 }
 
 
-// https://stackoverflow.com/a/87333
-// https://stackoverflow.com/a/27739925
-void Canvas::onRender(wxCommandEvent&)
+// can be called from any thread; all requests made before the frame is
+// rendered are merged into a single frame
+void Canvas::requestRender()
 {
-    flip();
+    if (renderThread != nullptr)
+        renderThread->requestFrame();
+}
 
-    std::chrono::steady_clock::time_point currentFlip;
-    currentFlip = std::chrono::steady_clock::now();
 
-    float difference = std::chrono::duration_cast<std::chrono::microseconds>
-        (currentFlip - lastFlip).count();
-    FPS = (FPS * FPSSmoothing) + (1000000/difference * (1.0-FPSSmoothing));
-    lastFlip = currentFlip;
+// the glyphs are drawn by wxWidgets only once, the render thread draws the
+// text from their coverage
+std::shared_ptr<FontAtlas> Canvas::renderHUDFont()
+{
+    wxFont font(wxFontInfo(9).Family(wxFONTFAMILY_TELETYPE));
+    wxMemoryDC dc;
+    dc.SetFont(font);
+
+    // every glyph of a monospaced font has the same size
+    wxSize glyph = dc.GetTextExtent("M");
+    wxBitmap bitmap(glyph.GetWidth() * FontAtlas::glyphCount,
+        glyph.GetHeight());
+    dc.SelectObject(bitmap);
+    dc.SetBackground(*wxBLACK_BRUSH);
+    dc.Clear();
+    dc.SetTextForeground(*wxWHITE);
+
+    for (int i = 0; i < FontAtlas::glyphCount; i++)
+        dc.DrawText(wxString(static_cast<char>(FontAtlas::firstGlyph + i)),
+            i * glyph.GetWidth(), 0);
+
+    dc.SelectObject(wxNullBitmap);
+    wxImage image = bitmap.ConvertToImage();
+
+    std::shared_ptr<FontAtlas> atlas = std::make_shared<FontAtlas>();
+    atlas->glyphWidth = glyph.GetWidth();
+    atlas->glyphHeight = glyph.GetHeight();
+    atlas->coverage.resize(image.GetWidth() * image.GetHeight());
+
+    // the text is white, so any channel is the coverage
+    for (size_t i = 0; i < atlas->coverage.size(); i++)
+        atlas->coverage[i] = image.GetData()[i * 3];
+
+    return atlas;
+}
 
-    parentFrame->SetStatusText(wxString::Format(wxT("%.1f FPS"), FPS));
 
-    // give control back to the app to handle all UI elements and events
-    wxYield();
+void Canvas::setContinuousRendering(bool enable)
+{
+    continuousRendering = enable;
+
+    // the setting is applied after the benchmark finishes
+    if (!benchmarkRunning)
+        renderThread->setContinuous(continuousRendering, FPSCap);
+}
 
-    if (done)
-        return;
 
-    renderEvent = new wxCommandEvent(RENDER);
-    wxQueueEvent(this, renderEvent);
+bool Canvas::getContinuousRendering()
+{
+    return continuousRendering;
+}
+
+
+void Canvas::setFPSCap(int cap)
+{
+    FPSCap = cap;
+
+    if (!benchmarkRunning)
+        renderThread->setContinuous(continuousRendering, FPSCap);
+}
+
+
+int Canvas::getFPSCap()
+{
+    return FPSCap;
+}
+
+
+void Canvas::setFramesInFlight(int count)
+{
+    framesInFlight = count;
+    graphicsManager->setFramesInFlight(framesInFlight);
+}
+
+
+int Canvas::getFramesInFlight()
+{
+    return framesInFlight;
+}
+
+
+// the benchmark renders frames as fast as possible until its camera path
+// ends, the stats are shown only after it finishes
+void Canvas::runBenchmark(std::shared_ptr<Benchmark> benchmark)
+{
+    benchmarkRunning = true;
+    graphicsManager->runBenchmark(benchmark);
+    renderThread->setContinuous(true, 1000);
+}
+
+
+void Canvas::benchmarkFinished(std::shared_ptr<Benchmark> benchmark)
+{
+    benchmarkRunning = false;
+    renderThread->setContinuous(continuousRendering, FPSCap);
+    parentFrame->benchmarkFinished(benchmark);
+}
+
+
+bool Canvas::getBenchmarkRunning()
+{
+    return benchmarkRunning;
+}
+
+
+// wxImage doesn't depend on the GUI, so it can load the image in a job, the
+// reserved texture keeps its placeholder if the decoding fails,
+// the images are compressed to BC1 and cached, so the next load of the same
+// file skips both the decoding and the compression, the hash of the file is
+// the name of the cached image, a file which can't be hashed isn't cached
+void Canvas::decodeTexture(std::string path, int key)
+{
+    std::shared_ptr<GraphicsManager> manager = graphicsManager;
+
+    wxString cacheDir = wxStandardPaths::Get().GetUserLocalDataDir() +
+        "/texture_cache";
+    if (!wxFileName::DirExists(cacheDir) &&
+        !wxFileName::Mkdir(cacheDir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+        cacheDir.clear();
+
+    std::string cache(cacheDir.ToStdString());
+
+    // only the unfinished decoders are kept for the destructor
+    decoders.erase(std::remove_if(decoders.begin(), decoders.end(),
+        [](JobHandle& decoder){
+            return JobSystem::instance().isFinished(decoder);
+        }), decoders.end());
+
+    decoders.push_back(JobSystem::instance().run(
+        [this, manager, path, key, cache]{
+        // the whole file is read, so it isn't hashed on the UI thread
+        bool hashed;
+        uint64_t hash = hashFile(path, hashed);
+        if (!hashed)
+            hash = 0;
+
+        std::string cacheFile;
+        if (hash != 0 && !cache.empty())
+        {
+            char name[24];
+            snprintf(name, sizeof(name), "%016llx.ktx",
+                static_cast<unsigned long long>(hash));
+            cacheFile = cache + "/" + name;
+        }
+
+        std::shared_ptr<TextureImage> texture;
+        if (!cacheFile.empty())
+            texture = TextureImage::readKTX(cacheFile);
+
+        if (texture == nullptr)
+        {
+            wxImage image;
+
+            if (!image.LoadFile(path) || !image.IsOk())
+            {
+                CallAfter([this, path]{
+                    showErrorMessage("Texture load error",
+                        "The texture file " + path + " failed to decode");
+                });
+                return;
+            }
+
+            // the rows stay in the order of the file, the shader flips them
+            texture = TextureImage::compressBC1(image.GetData(),
+                image.GetWidth(), image.GetHeight());
+
+            if (!cacheFile.empty() && !texture->writeKTX(cacheFile))
+            {
+                #ifdef DEBUG
+                    std::cout << "Texture cache failed to write: "
+                        << cacheFile << std::endl;
+                #endif /* DEBUG */
+            }
+        }
+
+        manager->setTextureImage(key, texture);
+
+        // the scenes find the texture by its image, the library by its file
+        uint64_t imageHash = texture->hash;
+        CallAfter([manager, key, imageHash, hash]{
+            manager->setTextureHash(key, imageHash, hash);
+        });
+
+        #ifdef DEBUG
+            std::cout << "Texture decoded: " << path << std::endl;
+        #endif /* DEBUG */
+    }));
+}
+
+
+void Canvas::sendMouseInfo()
+{
+    if (graphicsManager)
+        graphicsManager->setMouseInfo(getMouseInfo());
 }
 
 
@@ -1011,46 +1922,63 @@ void Canvas::onClose(wxCloseEvent&)
 
 void Canvas::onPaint(wxPaintEvent&)
 {
-    // this is mandatory to be able to draw in the window
+    // this is mandatory to be able to draw in the window, the frame itself
+    // is drawn by the render thread
     wxPaintDC dc(this);
 
-    graphicsManager->render();
-    SwapBuffers();
+    requestRender();
 }
 
 
 void Canvas::onSize(wxSizeEvent&)
 {
-    GetClientSize(&viewportDims.first, &viewportDims.second);
-    glViewport(0, 0, viewportDims.first, viewportDims.second);
+    int width, height;
+    GetClientSize(&width, &height);
+
+    if (graphicsManager)
+        graphicsManager->setViewport(width, height);
 }
 
 
 void Canvas::onLMBDown(wxMouseEvent&)
 {
     cameraSpinning = true;
+    sendMouseInfo();
 }
 
 
 void Canvas::onLMBUp(wxMouseEvent&)
 {
     cameraSpinning = false;
+    sendMouseInfo();
 }
 
 
 void Canvas::onRMBDown(wxMouseEvent&)
 {
     cameraMoving = true;
+    sendMouseInfo();
 }
 
 
 void Canvas::onRMBUp(wxMouseEvent&)
 {
     cameraMoving = false;
+    sendMouseInfo();
+}
+
+
+void Canvas::onMouseMove(wxMouseEvent&)
+{
+    // the camera moves only while one of the mouse buttons is held
+    if (cameraSpinning || cameraMoving)
+        sendMouseInfo();
 }
 
 
 void Canvas::onWheel(wxMouseEvent& event)
 {
     mouseWheelPos += event.GetWheelRotation() * event.GetWheelDelta();
+    sendMouseInfo();
 }
+
@@ -4,6 +4,15 @@
 #include "graphics.hpp"
 #include "shaders.hpp"
 #include "vertices.hpp"
+#include "commands.hpp"
+#include "renderer.hpp"
+#include "profiler.hpp"
+#include "benchmark.hpp"
+#include "renderqueue.hpp"
+#include "glstate.hpp"
+#include "uploader.hpp"
+#include "teximage.hpp"
+#include "streamer.hpp"
 
 #ifdef DEBUG
     #include <iostream>
@@ -13,17 +22,31 @@
 #include <wx/glcanvas.h>
 #include <wx/spinctrl.h>
 #include <wx/colordlg.h>
+#include <wx/numdlg.h>
+#include <wx/filename.h>
+#include <wx/stdpaths.h>
+#include <wx/listctrl.h>
+#include <wx/dcmemory.h>
+#include <wx/dataview.h>
+#include <wx/srchctrl.h>
 #include <wx/wx.h>
 #include <GL/glew.h>
 #include <GL/wglew.h>
 #include <glm/glm.hpp>
+#include <algorithm>
 #include <fstream>
 #include <memory>
 #include <vector>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <regex>
 
+#ifdef _WIN32
+    #include <windows.h>
+    #include <mmsystem.h>
+#endif /* _WIN32 */
+
 // must be defined for wxCheckListBox to work
 #define wxUSE_OWNER_DRAWN 1
 
@@ -38,7 +61,9 @@ class RenameFrame;
 class ObjectSettings;
 class Canvas;
 class GraphicsManager;
-class SidePanelRefreshTimer;
+class MemoryPanel;
+class RenderThread;
+struct MouseInfo;
 
 
 class App : public wxApp
@@ -56,21 +81,52 @@ class MainFrame : public wxFrame
 public:
     MainFrame();
     bool openGLInitialized();
+    void benchmarkFinished(std::shared_ptr<Benchmark> benchmark);
+    void decodeTexture(std::string path, int key);
 
 private:
     #ifdef DEBUG
         wxLog* logger;
     #endif /* DEBUG */
     Canvas* canvas;
+    std::shared_ptr<CameraPath> cameraPath;
 
     void onObjLoad(wxCommandEvent&);
+    void onOpenScene(wxCommandEvent&);
+    void onSaveScene(wxCommandEvent&);
+    void onContinuousRendering(wxCommandEvent& event);
+    void onFPSLimit(wxCommandEvent&);
+    void onFramesInFlight(wxCommandEvent&);
+    void onTextureBudget(wxCommandEvent&);
+    void onShowStatistics(wxCommandEvent& event);
+    void onRecordTrace(wxCommandEvent& event);
+    void onPerObjectGPU(wxCommandEvent& event);
+    void onExportTrace(wxCommandEvent&);
+    void onRunBenchmark(wxCommandEvent&);
+    void onRecordCameraPath(wxCommandEvent& event);
+    void onLoadCameraPath(wxCommandEvent&);
+    void onSaveCameraPath(wxCommandEvent&);
     void onAbout(wxCommandEvent&);
     void onExit(wxCommandEvent&);
     void onClose(wxCloseEvent& event);
 
     enum Event
     {
-        LOAD_OBJ
+        LOAD_OBJ,
+        OPEN_SCENE,
+        SAVE_SCENE,
+        CONTINUOUS_RENDERING,
+        FPS_LIMIT,
+        FRAMES_IN_FLIGHT,
+        TEXTURE_BUDGET,
+        SHOW_STATISTICS,
+        RECORD_TRACE,
+        PER_OBJECT_GPU,
+        EXPORT_TRACE,
+        RUN_BENCHMARK,
+        RECORD_CAMERA_PATH,
+        LOAD_CAMERA_PATH,
+        SAVE_CAMERA_PATH
     };
 
     wxDECLARE_EVENT_TABLE();
@@ -81,46 +137,73 @@ class SidePanel : public wxPanel
 {
 public:
     SidePanel(MainFrame* parent, std::shared_ptr<GraphicsManager> manager);
-    ~SidePanel();
-
-private:
-    SidePanelRefreshTimer* timer;
 };
 
 
-class ObjectList : public wxPanel
+// rows of the outliner are read from the manager only when they are drawn,
+// so the list costs the same for any number of objects, the filter keeps
+// the indices of the matching objects
+class ObjectListModel : public wxDataViewVirtualListModel
 {
 public:
-    ObjectList(SidePanel* parent, MainFrame* main,
-        std::shared_ptr<GraphicsManager> manager);
+    enum Column
+    {
+        SHOW = 0,
+        NAME = 1,
+        COLUMNS = 2
+    };
 
-    wxCheckListBox* getListbox();
+    ObjectListModel(std::shared_ptr<GraphicsManager> manager);
+
+    virtual unsigned GetColumnCount() const override;
+    virtual wxString GetColumnType(unsigned column) const override;
+    virtual unsigned GetCount() const override;
+    virtual void GetValueByRow(wxVariant& value, unsigned row,
+        unsigned column) const override;
+    virtual bool SetValueByRow(const wxVariant& value, unsigned row,
+        unsigned column) override;
+
+    void setFilter(std::string text);
+    bool filtered() const;
+    int objectAt(unsigned row) const;
+    int rowOf(int idx) const;
+    void objectAdded(int idx);
+    void objectRemoved(int idx);
+    void objectRenamed(int idx);
+    void objectChanged(int idx, Column column);
 
 private:
     std::shared_ptr<GraphicsManager> graphicsManager;
-    ObjectButtonPanel* buttons;
-    wxCheckListBox* listbox;
-
-    void onCheckBox(wxCommandEvent& event);
+    std::string filter;
+    // sorted list positions of the matching objects, empty without a filter
+    std::vector<int> rows;
 
-    wxDECLARE_EVENT_TABLE();
+    bool matches(int idx) const;
 };
 
 
-class SidePanelRefreshTimer : public wxTimer
+class ObjectList : public wxPanel
 {
 public:
-    SidePanelRefreshTimer(std::shared_ptr<GraphicsManager> manager,
-        ObjectSettings* settings, wxCheckListBox* list);
-    ~SidePanelRefreshTimer();
-    virtual void Notify() override;
+    ObjectList(SidePanel* parent, MainFrame* main,
+        std::shared_ptr<GraphicsManager> manager);
+    ~ObjectList();
 
 private:
     std::shared_ptr<GraphicsManager> graphicsManager;
-    ObjectSettings* objectSettings;
-    wxCheckListBox* listbox;
-    wxArrayString names;
-    int lastSelected;
+    ObjectButtonPanel* buttons;
+    wxSearchCtrl* search;
+    wxDataViewCtrl* view;
+    ObjectListModel* model;
+    int subscription;
+
+    void selectRow(int row);
+    void onSceneEvent(const SceneEvent& event);
+    void onSelect(wxDataViewEvent& event);
+    void onSearch(wxCommandEvent&);
+    void onSearchNext(wxCommandEvent&);
+
+    wxDECLARE_EVENT_TABLE();
 };
 
 
@@ -128,12 +211,11 @@ class ObjectButtonPanel : public wxPanel
 {
 public:
     ObjectButtonPanel(std::shared_ptr<GraphicsManager> manager,
-        wxPanel* parentPanel, MainFrame* main, wxCheckListBox* target);
+        wxPanel* parentPanel, MainFrame* main);
 
 private:
     MainFrame* mainFrame;
     std::shared_ptr<GraphicsManager> graphicsManager;
-    wxCheckListBox* targetListbox;
 
     void onNew(wxCommandEvent&);
     void onRename(wxCommandEvent&);
@@ -158,14 +240,14 @@ class RenameFrame : public wxFrame
 {
 public:
     RenameFrame(MainFrame* parent, std::shared_ptr<GraphicsManager> manager,
-        int idx);
+        ObjectHandle object);
     ~RenameFrame();
 
 private:
     MainFrame* mainFrame;
     std::shared_ptr<GraphicsManager> graphicsManager;
     wxTextCtrl* textField;
-    int objIdx;
+    ObjectHandle targetObject;
 
     void onEnter(wxCommandEvent&);
 
@@ -192,12 +274,16 @@ class TextureFrame : public wxFrame
 {
 public:
     TextureFrame(MainFrame* parent, std::shared_ptr<GraphicsManager> manager,
-        int idx);
+        ObjectHandle object);
     ~TextureFrame();
 
 private:
     MainFrame* mainFrame;
+    std::shared_ptr<GraphicsManager> graphicsManager;
     wxListBox* listBox;
+    int subscription;
+
+    void onSceneEvent(const SceneEvent& event);
 };
 
 
@@ -205,13 +291,14 @@ class TextureFrameButtonPanel : public wxPanel
 {
 public:
     TextureFrameButtonPanel(TextureFrame* parent, 
-    std::shared_ptr<GraphicsManager> manager, wxListBox* target, int idx);
+    std::shared_ptr<GraphicsManager> manager, wxListBox* target,
+    ObjectHandle object);
 
 private:
     TextureFrame* parentFrame;
     std::shared_ptr<GraphicsManager> graphicsManager;
     wxListBox* targetListBox;
-    int objIdx;
+    ObjectHandle targetObject;
 
     void onNew(wxCommandEvent&);
     void onDelete(wxCommandEvent&);
@@ -225,16 +312,19 @@ private:
 class ObjectSettings : public wxPanel
 {
 public:
-    ObjectSettings(wxPanel* parent, wxCheckListBox* list,
-        std::shared_ptr<GraphicsManager> manager);
+    ObjectSettings(wxPanel* parent, std::shared_ptr<GraphicsManager> manager);
+    ~ObjectSettings();
 
 private:
-    wxCheckListBox* listbox;
     std::shared_ptr<GraphicsManager> graphicsManager;
     std::vector<wxSpinCtrlDouble*> textFields;
     wxChoice* renderModeChoice;
+    int subscription;
+    // changes made by the panel itself don't refresh it
+    bool applying;
 
-    void onRefresh(wxCommandEvent&);
+    void refresh();
+    void onSceneEvent(const SceneEvent& event);
     void onEnter(wxCommandEvent&);
     void onSpinChange(wxSpinDoubleEvent& event);
     void onModeChange(wxCommandEvent&);
@@ -261,15 +351,31 @@ private:
 };
 
 
-struct MouseInfo
+// memory of every object and texture, the report is requested from the
+// render thread about once a second and shown when it arrives
+class MemoryPanel : public wxPanel
 {
-    bool spinning;
-    bool moving;
-    wxPoint mousePos;
-    int wheelPos;
+public:
+    MemoryPanel(wxPanel* parent, std::shared_ptr<GraphicsManager> manager);
+
+private:
+    std::shared_ptr<GraphicsManager> graphicsManager;
+    wxStaticText* totals;
+    wxListCtrl* list;
+    std::shared_ptr<MemoryReport> report;
+    bool reportPending;
+    wxTimer refreshTimer;
+
+    void requestReport();
+    void showReport(std::shared_ptr<MemoryReport> newReport);
+    void onTimer(wxTimerEvent&);
+    void onExport(wxCommandEvent&);
+
+    wxDECLARE_EVENT_TABLE();
 };
 
-class Canvas : public wxGLCanvas
+
+class Canvas : public wxGLCanvas, public RenderHost
 {
 public:
     Canvas(MainFrame* parent, const wxGLAttributes& canvasAttrs);
@@ -277,29 +383,42 @@ public:
 
     bool wxGLCtxExists();
     bool graphicsManagerExists();
-    void flip();
-    float viewportAspectRatio();
+    void makeCurrent();
+    void releaseCurrent();
     bool extCheck(std::pair<bool, std::string> in);
     std::shared_ptr<GraphicsManager> getGraphicsManager();
     MouseInfo getMouseInfo();
-    void showErrorMessage(std::string title, std::string msg);
+    void showErrorMessage(std::string title, std::string msg) override;
+    void requestRender() override;
+    void setContinuousRendering(bool enable);
+    bool getContinuousRendering();
+    void setFPSCap(int cap);
+    int getFPSCap();
+    void setFramesInFlight(int count);
+    int getFramesInFlight();
+    void runBenchmark(std::shared_ptr<Benchmark> benchmark);
+    void benchmarkFinished(std::shared_ptr<Benchmark> benchmark);
+    bool getBenchmarkRunning();
+    void decodeTexture(std::string path, int key);
 
 private:
     MainFrame* parentFrame;
     wxGLContext* wxGLCtx;
     std::shared_ptr<GraphicsManager> graphicsManager;
+    RenderThread* renderThread;
     bool done;
     bool debuggingExt;
-    std::pair<int, int> viewportDims;
     bool cameraSpinning;
     bool cameraMoving;
     int mouseWheelPos;
-    wxEvent* renderEvent;
-    std::chrono::steady_clock::time_point lastFlip;
-    float FPSSmoothing;
-    float FPS;
+    bool continuousRendering;
+    int FPSCap;
+    int framesInFlight;
+    bool benchmarkRunning;
+    std::vector<JobHandle> decoders;
     
-    void onRender(wxCommandEvent&);
+    void sendMouseInfo();
+    std::shared_ptr<FontAtlas> renderHUDFont();
     void onClose(wxCloseEvent&);
     void onPaint(wxPaintEvent&);
     void onSize(wxSizeEvent&);
@@ -307,6 +426,7 @@ private:
     void onLMBUp(wxMouseEvent&);
     void onRMBDown(wxMouseEvent&);
     void onRMBUp(wxMouseEvent&);
+    void onMouseMove(wxMouseEvent&);
     void onWheel(wxMouseEvent& event);
 
     wxDECLARE_EVENT_TABLE();
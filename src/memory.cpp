@@ -0,0 +1,241 @@
+#include "memory.hpp"
+
+#include <fstream>
+
+
+MemoryTracker& MemoryTracker::instance()
+{
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+
+MemoryTracker::MemoryTracker()
+{
+    for (int tag = 0; tag < TAG_COUNT; tag++)
+    {
+        current[tag] = 0;
+        peak[tag] = 0;
+        allocations[tag] = 0;
+    }
+
+    loadAllocations = 0;
+    loadFilePeak = 0;
+    loadFacePeak = 0;
+}
+
+
+// names used in the JSON export
+const char* MemoryTracker::tagName(Tag tag)
+{
+    static const char* names[] = {"mesh_cpu", "mesh_gpu", "texture_cpu",
+        "texture_gpu", "upload_staging", "loader"};
+
+    return names[tag];
+}
+
+
+void MemoryTracker::allocate(Tag tag, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+
+    size_t now = current[tag].fetch_add(bytes) + bytes;
+    allocations[tag]++;
+
+    // another thread can raise the peak in the meantime
+    size_t oldPeak = peak[tag];
+    while (now > oldPeak && !peak[tag].compare_exchange_weak(oldPeak, now));
+}
+
+
+void MemoryTracker::release(Tag tag, size_t bytes)
+{
+    current[tag] -= bytes;
+}
+
+
+size_t MemoryTracker::getCurrent(Tag tag)
+{
+    return current[tag];
+}
+
+
+size_t MemoryTracker::getPeak(Tag tag)
+{
+    return peak[tag];
+}
+
+
+uint64_t MemoryTracker::getAllocations(Tag tag)
+{
+    return allocations[tag];
+}
+
+
+// the peaks are of the arena with the parsed file and of the largest arena
+// used for a single face
+void MemoryTracker::recordLoad(uint64_t arenaAllocations, size_t filePeak,
+    size_t facePeak)
+{
+    loadAllocations = arenaAllocations;
+    loadFilePeak = filePeak;
+    loadFacePeak = facePeak;
+}
+
+
+uint64_t MemoryTracker::getLoadAllocations()
+{
+    return loadAllocations;
+}
+
+
+size_t MemoryTracker::getLoadFilePeak()
+{
+    return loadFilePeak;
+}
+
+
+size_t MemoryTracker::getLoadFacePeak()
+{
+    return loadFacePeak;
+}
+
+
+TrackedAllocation::TrackedAllocation(MemoryTracker::Tag allocationTag,
+    size_t bytes)
+    : tag(allocationTag), size(bytes)
+{
+    MemoryTracker::instance().allocate(tag, size);
+}
+
+
+TrackedAllocation::TrackedAllocation(const TrackedAllocation& other)
+    : tag(other.tag), size(other.size)
+{
+    MemoryTracker::instance().allocate(tag, size);
+}
+
+
+TrackedAllocation& TrackedAllocation::operator=(const TrackedAllocation& other)
+{
+    MemoryTracker::instance().release(tag, size);
+    tag = other.tag;
+    size = other.size;
+    MemoryTracker::instance().allocate(tag, size);
+    return *this;
+}
+
+
+TrackedAllocation::~TrackedAllocation()
+{
+    MemoryTracker::instance().release(tag, size);
+}
+
+
+// a resize counts as a new allocation, the old memory is usually freed
+void TrackedAllocation::resize(size_t bytes)
+{
+    if (bytes == size)
+        return;
+
+    MemoryTracker::instance().release(tag, size);
+    size = bytes;
+    MemoryTracker::instance().allocate(tag, size);
+}
+
+
+size_t TrackedAllocation::getSize() const
+{
+    return size;
+}
+
+
+void MemoryReport::readCounters()
+{
+    MemoryTracker& tracker = MemoryTracker::instance();
+
+    for (int tag = 0; tag < MemoryTracker::TAG_COUNT; tag++)
+    {
+        MemoryTracker::Tag trackerTag = static_cast<MemoryTracker::Tag>(tag);
+        current[tag] = tracker.getCurrent(trackerTag);
+        peak[tag] = tracker.getPeak(trackerTag);
+        allocations[tag] = tracker.getAllocations(trackerTag);
+    }
+
+    loadAllocations = tracker.getLoadAllocations();
+    loadFilePeak = tracker.getLoadFilePeak();
+    loadFacePeak = tracker.getLoadFacePeak();
+}
+
+
+size_t MemoryReport::getCPUTotal()
+{
+    return current[MemoryTracker::MESH_CPU] +
+        current[MemoryTracker::TEXTURE_CPU] + current[MemoryTracker::LOADER];
+}
+
+
+size_t MemoryReport::getGPUTotal()
+{
+    return current[MemoryTracker::MESH_GPU] +
+        current[MemoryTracker::TEXTURE_GPU] +
+        current[MemoryTracker::UPLOAD_STAGING];
+}
+
+
+static std::string escapeJSON(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+
+static void writeEntriesJSON(std::ofstream& out,
+    const std::vector<MemoryReport::Entry>& entries)
+{
+    out << "[";
+    for (size_t i = 0; i < entries.size(); i++)
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \""
+            << escapeJSON(entries[i].name) << "\", \"cpu_bytes\": "
+            << entries[i].CPUBytes << ", \"gpu_bytes\": "
+            << entries[i].GPUBytes << "}";
+    out << (entries.empty() ? "]" : "\n  ]");
+}
+
+
+bool MemoryReport::writeJSON(std::string file)
+{
+    std::ofstream out(file);
+
+    if (!out)
+        return false;
+
+    out << "{\n  \"tags\": {";
+    for (int tag = 0; tag < MemoryTracker::TAG_COUNT; tag++)
+        out << (tag == 0 ? "\n" : ",\n") << "    \""
+            << MemoryTracker::tagName(static_cast<MemoryTracker::Tag>(tag))
+            << "\": {\"bytes\": " << current[tag] << ", \"peak_bytes\": "
+            << peak[tag] << ", \"allocations\": " << allocations[tag] << "}";
+    out << "\n  },\n";
+
+    out << "  \"cpu_bytes\": " << getCPUTotal() << ",\n";
+    out << "  \"gpu_bytes\": " << getGPUTotal() << ",\n";
+    out << "  \"last_load\": {\"arena_allocations\": " << loadAllocations
+        << ", \"file_arena_peak_bytes\": " << loadFilePeak
+        << ", \"face_arena_peak_bytes\": " << loadFacePeak << "},\n";
+
+    out << "  \"objects\": ";
+    writeEntriesJSON(out, objects);
+    out << ",\n  \"textures\": ";
+    writeEntriesJSON(out, textures);
+    out << "\n}\n";
+
+    return out.good();
+}
@@ -0,0 +1,100 @@
+#ifndef MEMORY_HPP_
+#define MEMORY_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// counts the memory held by the scene, every allocation is tagged by what it
+// holds, the counters are updated by the render, UI and decoder threads
+class MemoryTracker
+{
+public:
+    enum Tag
+    {
+        MESH_CPU,
+        MESH_GPU,
+        TEXTURE_CPU,
+        TEXTURE_GPU,
+        UPLOAD_STAGING,
+        LOADER,
+        TAG_COUNT
+    };
+
+    static MemoryTracker& instance();
+    static const char* tagName(Tag tag);
+
+    void allocate(Tag tag, size_t bytes);
+    void release(Tag tag, size_t bytes);
+    size_t getCurrent(Tag tag);
+    size_t getPeak(Tag tag);
+    uint64_t getAllocations(Tag tag);
+
+    // arena statistics of the last loaded file
+    void recordLoad(uint64_t arenaAllocations, size_t filePeak,
+        size_t facePeak);
+    uint64_t getLoadAllocations();
+    size_t getLoadFilePeak();
+    size_t getLoadFacePeak();
+
+private:
+    MemoryTracker();
+
+    std::atomic<size_t> current[TAG_COUNT];
+    std::atomic<size_t> peak[TAG_COUNT];
+    std::atomic<uint64_t> allocations[TAG_COUNT];
+    std::atomic<uint64_t> loadAllocations;
+    std::atomic<size_t> loadFilePeak;
+    std::atomic<size_t> loadFacePeak;
+};
+
+
+// allocation which is counted for as long as its owner exists, copies are
+// counted separately, because they hold their own copy of the data
+class TrackedAllocation
+{
+public:
+    TrackedAllocation(MemoryTracker::Tag allocationTag, size_t bytes = 0);
+    TrackedAllocation(const TrackedAllocation& other);
+    TrackedAllocation& operator=(const TrackedAllocation& other);
+    ~TrackedAllocation();
+
+    void resize(size_t bytes);
+    size_t getSize() const;
+
+private:
+    MemoryTracker::Tag tag;
+    size_t size;
+};
+
+
+// snapshot of the counters and of the memory of every object and texture,
+// it is made by the render thread and read by the UI
+struct MemoryReport
+{
+    struct Entry
+    {
+        std::string name;
+        size_t CPUBytes;
+        size_t GPUBytes;
+    };
+
+    size_t current[MemoryTracker::TAG_COUNT];
+    size_t peak[MemoryTracker::TAG_COUNT];
+    uint64_t allocations[MemoryTracker::TAG_COUNT];
+    uint64_t loadAllocations;
+    size_t loadFilePeak;
+    size_t loadFacePeak;
+    std::vector<Entry> objects;
+    std::vector<Entry> textures;
+
+    void readCounters();
+    size_t getCPUTotal();
+    size_t getGPUTotal();
+    bool writeJSON(std::string file);
+};
+
+
+#endif /* MEMORY_HPP_ */
@@ -0,0 +1,269 @@
+#include "profiler.hpp"
+
+
+Profiler& Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+
+Profiler::Profiler()
+{
+    writeIdx = 0;
+    enabled = false;
+    perObjectGPU = false;
+    nextThreadID = GPUThreadID + 1;
+
+    for (ProfileEvent& event : events)
+        event.sequence = 0;
+}
+
+
+// nanoseconds from an arbitrary point in time
+int64_t Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// can be called from any thread
+void Profiler::record(const char* name, int64_t start, int64_t duration,
+    int threadID)
+{
+    uint64_t idx = writeIdx.fetch_add(1, std::memory_order_relaxed);
+    ProfileEvent& event = events[idx % capacity];
+
+    // the slot is marked as being written, so the exporter skips it
+    event.sequence.store(idx * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    strncpy(event.name, name, sizeof(event.name) - 1);
+    event.name[sizeof(event.name) - 1] = '\0';
+    event.start = start;
+    event.duration = duration;
+    event.threadID = threadID;
+
+    event.sequence.store(idx * 2 + 2, std::memory_order_release);
+}
+
+
+void Profiler::setThreadName(std::string name)
+{
+    std::lock_guard<std::mutex> lock(threadNamesMutex);
+    threadNames.push_back(std::make_pair(getThreadID(), name));
+}
+
+
+int Profiler::getThreadID()
+{
+    thread_local int threadID = nextThreadID++;
+    return threadID;
+}
+
+
+void Profiler::setEnabled(bool enable)
+{
+    enabled = enable;
+
+    #ifdef DEBUG
+        std::cout << "Profiling " << (enable ? "started" : "stopped")
+            << std::endl;
+    #endif /* DEBUG */
+}
+
+
+bool Profiler::getEnabled()
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+
+// every object gets its own timer queries, which costs some GPU time itself
+void Profiler::setPerObjectGPU(bool enable)
+{
+    perObjectGPU = enable;
+}
+
+
+bool Profiler::getPerObjectGPU()
+{
+    return perObjectGPU.load(std::memory_order_relaxed);
+}
+
+
+// object names can contain characters which are not allowed in JSON strings
+static std::string escapeJSON(const char* text)
+{
+    std::string escaped;
+
+    for (const char* c = text; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            escaped += '\\';
+
+        if (static_cast<unsigned char>(*c) >= 0x20)
+            escaped += *c;
+    }
+
+    return escaped;
+}
+
+
+// the format is described here:
+// https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU
+bool Profiler::exportTrace(std::string file)
+{
+    std::ofstream out(file);
+
+    if (!out)
+        return false;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << GPUThreadID << ",\"args\":{\"name\":\"GPU\"}}";
+
+    {
+        std::lock_guard<std::mutex> lock(threadNamesMutex);
+        for (auto& thread : threadNames)
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                << "\"tid\":" << thread.first << ",\"args\":{\"name\":\""
+                << escapeJSON(thread.second.c_str()) << "\"}}";
+    }
+
+    uint64_t end = writeIdx.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+
+    ProfileEvent copy;
+    uint64_t sequence;
+    out.precision(3);
+    out << std::fixed;
+
+    for (uint64_t idx = begin; idx < end; idx++)
+    {
+        ProfileEvent& event = events[idx % capacity];
+
+        // events which are being written or were overwritten are skipped
+        sequence = event.sequence.load(std::memory_order_acquire);
+        if (sequence != idx * 2 + 2)
+            continue;
+
+        memcpy(copy.name, event.name, sizeof(copy.name));
+        copy.start = event.start;
+        copy.duration = event.duration;
+        copy.threadID = event.threadID;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (event.sequence.load(std::memory_order_relaxed) != sequence)
+            continue;
+
+        // trace timestamps are in microseconds
+        out << ",\n{\"name\":\"" << escapeJSON(copy.name) << "\",\"cat\":\""
+            << (copy.threadID == GPUThreadID ? "GPU" : "CPU")
+            << "\",\"ph\":\"X\",\"ts\":" << copy.start / 1000.0
+            << ",\"dur\":" << copy.duration / 1000.0
+            << ",\"pid\":1,\"tid\":" << copy.threadID << "}";
+    }
+
+    out << "\n]}\n";
+
+    #ifdef DEBUG
+        std::cout << "Trace exported: " << file << std::endl;
+    #endif /* DEBUG */
+
+    return static_cast<bool>(out);
+}
+
+
+ProfileScope::ProfileScope(const char* scopeName) : name(scopeName)
+{
+    // the check is done only once, so the scope is recorded whole
+    start = Profiler::instance().getEnabled() ? Profiler::now() : 0;
+}
+
+
+ProfileScope::~ProfileScope()
+{
+    if (start == 0)
+        return;
+
+    Profiler& profiler = Profiler::instance();
+    profiler.record(name, start, Profiler::now() - start,
+        profiler.getThreadID());
+}
+
+
+GPUTimers::GPUTimers()
+{
+    usedZones = 0;
+    clockOffset = 0;
+}
+
+
+// called at the start of the frame, GPU timestamps are converted to the CPU
+// time, so both can be shown in the same trace
+void GPUTimers::calibrate()
+{
+    GLint64 GPUTime;
+    glGetInteger64v(GL_TIMESTAMP, &GPUTime);
+    clockOffset = Profiler::now() - GPUTime;
+}
+
+
+void GPUTimers::begin(const std::string& name)
+{
+    // queries are reused in the next frames
+    if (usedZones == zones.size())
+    {
+        zones.push_back(Zone());
+        glCreateQueries(GL_TIMESTAMP, 2, zones.back().queries);
+    }
+
+    Zone& zone = zones[usedZones];
+    zone.name = name;
+    glQueryCounter(zone.queries[0], GL_TIMESTAMP);
+
+    openZones.push_back(usedZones);
+    usedZones++;
+}
+
+
+void GPUTimers::end()
+{
+    if (openZones.empty())
+        return;
+
+    glQueryCounter(zones[openZones.back()].queries[1], GL_TIMESTAMP);
+    openZones.pop_back();
+}
+
+
+// must be called only after the frame's fence was signaled
+void GPUTimers::collect()
+{
+    Profiler& profiler = Profiler::instance();
+    GLuint64 start, end;
+
+    for (size_t i = 0; i < usedZones; i++)
+    {
+        glGetQueryObjectui64v(zones[i].queries[0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(zones[i].queries[1], GL_QUERY_RESULT, &end);
+
+        profiler.record(zones[i].name.c_str(), start + clockOffset,
+            end - start, Profiler::GPUThreadID);
+    }
+
+    usedZones = 0;
+    openZones.clear();
+}
+
+
+void GPUTimers::release()
+{
+    for (Zone& zone : zones)
+        glDeleteQueries(2, zone.queries);
+
+    zones.clear();
+    usedZones = 0;
+}
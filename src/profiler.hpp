@@ -0,0 +1,114 @@
+#ifndef PROFILER_HPP_
+#define PROFILER_HPP_
+
+#include "graphics.hpp"
+
+#include <GL/glew.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// measures the CPU time spent in the rest of the enclosing block, the line
+// number makes the variable name unique
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) \
+    ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+
+struct ProfileEvent
+{
+    // even values mark a finished write, odd values a write in progress
+    std::atomic<uint64_t> sequence;
+    char name[48];
+    int64_t start;
+    int64_t duration;
+    int threadID;
+};
+
+
+// collects timing events from all threads into a lock-free ring buffer,
+// the oldest events are overwritten when the buffer is full
+class Profiler
+{
+public:
+    static const int GPUThreadID = 0;
+
+    static Profiler& instance();
+    static int64_t now();
+
+    void record(const char* name, int64_t start, int64_t duration,
+        int threadID);
+    void setThreadName(std::string name);
+    int getThreadID();
+    void setEnabled(bool enable);
+    bool getEnabled();
+    void setPerObjectGPU(bool enable);
+    bool getPerObjectGPU();
+    bool exportTrace(std::string file);
+
+private:
+    static const size_t capacity = 1 << 16;
+
+    Profiler();
+
+    ProfileEvent events[capacity];
+    std::atomic<uint64_t> writeIdx;
+    std::atomic<bool> enabled;
+    std::atomic<bool> perObjectGPU;
+    std::atomic<int> nextThreadID;
+
+    // thread names are only written when a thread starts, the mutex doesn't
+    // affect recording
+    std::mutex threadNamesMutex;
+    std::vector<std::pair<int, std::string>> threadNames;
+};
+
+
+class ProfileScope
+{
+public:
+    ProfileScope(const char* scopeName);
+    ~ProfileScope();
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+
+// timestamp queries of a single frame, they are read once the frame's fence
+// is signaled, so reading them never stalls the CPU
+class GPUTimers
+{
+public:
+    GPUTimers();
+
+    void calibrate();
+    void begin(const std::string& name);
+    void end();
+    void collect();
+    void release();
+
+private:
+    struct Zone
+    {
+        std::string name;
+        GLuint queries[2];
+    };
+
+    std::vector<Zone> zones;
+    std::vector<size_t> openZones;
+    size_t usedZones;
+
+    // difference between the CPU and the GPU clock in nanoseconds
+    int64_t clockOffset;
+};
+
+
+#endif /* PROFILER_HPP_ */
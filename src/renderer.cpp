@@ -0,0 +1,168 @@
+#include "renderer.hpp"
+
+
+RenderThread::RenderThread(Canvas* target,
+    std::shared_ptr<GraphicsManager> manager)
+    : canvas(target), graphicsManager(manager)
+{
+    running = true;
+    framePending = true;
+    continuous = false;
+    FPSCap = 60;
+    FPSSmoothing = 0.9f;
+    FPS = 0.0f;
+    CPUFrameTime = 0.0f;
+    GPUFrameTime = 0.0f;
+
+    thread = std::thread(&RenderThread::loop, this);
+}
+
+
+RenderThread::~RenderThread()
+{
+    stop();
+}
+
+
+// the flag is set under the lock, so it can't change between the check of the
+// waiting thread and its sleep
+void RenderThread::requestFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        framePending = true;
+    }
+    wakeCondition.notify_one();
+}
+
+
+void RenderThread::setContinuous(bool enable, int cap)
+{
+    FPSCap = cap;
+    continuous = enable;
+    requestFrame();
+}
+
+
+void RenderThread::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+    }
+    wakeCondition.notify_one();
+
+    if (thread.joinable())
+        thread.join();
+}
+
+
+// the timer resolution is raised to 1 ms in loop(), so the thread wakes at
+// most about a millisecond late, a slightly late frame shortens the next
+// sleep, the frames missed completely are dropped rather than caught up
+void RenderThread::sleepUntil(std::chrono::steady_clock::time_point deadline)
+{
+    std::this_thread::sleep_until(deadline);
+}
+
+
+void RenderThread::waitForFrame(
+    std::chrono::steady_clock::time_point nextFrame)
+{
+    if (continuous)
+    {
+        sleepUntil(nextFrame);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCondition.wait(lock, [this]{ return framePending || !running; });
+}
+
+
+void RenderThread::loop()
+{
+    #ifdef _WIN32
+        // the default timer resolution on Windows is ~15.6 ms
+        timeBeginPeriod(1);
+    #endif /* _WIN32 */
+
+    canvas->makeCurrent();
+    Profiler::instance().setThreadName("Render");
+
+    std::chrono::steady_clock::time_point nextFrame, frameStart, lastFlip,
+        now;
+    nextFrame = lastFlip = std::chrono::steady_clock::now();
+
+    while (running)
+    {
+        waitForFrame(nextFrame);
+
+        if (!running)
+            break;
+
+        framePending = false;
+        frameStart = std::chrono::steady_clock::now();
+
+        // apply all changes made by the UI since the last frame
+        graphicsManager->processCommands();
+        graphicsManager->render();
+
+        // CPU time doesn't include waiting for v-sync in SwapBuffers
+        now = std::chrono::steady_clock::now();
+        float renderTime = std::chrono::duration_cast<
+            std::chrono::microseconds>(now - frameStart).count();
+
+        canvas->SwapBuffers();
+
+        CPUFrameTime = (CPUFrameTime * FPSSmoothing) +
+            (renderTime / 1000 * (1.0 - FPSSmoothing));
+        GPUFrameTime = (GPUFrameTime * FPSSmoothing) +
+            (graphicsManager->getGPUFrameTime() * (1.0 - FPSSmoothing));
+
+        // benchmark frames are counted here, so the camera path is played
+        // exactly once no matter how fast the frames are
+        std::shared_ptr<Benchmark> benchmark = graphicsManager->getBenchmark();
+        if (benchmark != nullptr)
+        {
+            benchmark->addFrame(renderTime / 1000,
+                graphicsManager->getGPUFrameTime(),
+                graphicsManager->getFrameStats());
+
+            if (benchmark->finished())
+            {
+                graphicsManager->endBenchmark();
+                Canvas* target = canvas;
+                canvas->CallAfter([target, benchmark]{
+                    target->benchmarkFinished(benchmark);
+                });
+            }
+        }
+
+        now = std::chrono::steady_clock::now();
+
+        float difference = std::chrono::duration_cast<
+            std::chrono::microseconds>(now - lastFlip).count();
+        FPS = (FPS * FPSSmoothing) + (1000000/difference * (1.0-FPSSmoothing));
+        lastFlip = now;
+
+        // the times are drawn into the frame by the HUD, so the UI thread
+        // doesn't have to repaint the status bar every frame
+        graphicsManager->setHUDTimes(continuous ? FPS : 0.0f, CPUFrameTime,
+            GPUFrameTime);
+
+        nextFrame += std::chrono::microseconds(1000000 / FPSCap);
+
+        // don't try to catch up with frames that were missed
+        if (nextFrame < now)
+            nextFrame = now;
+    }
+
+    // GL objects have to be deleted while the context is still current
+    graphicsManager->releaseResources();
+    canvas->releaseCurrent();
+
+    #ifdef _WIN32
+        timeEndPeriod(1);
+    #endif /* _WIN32 */
+}
@@ -0,0 +1,55 @@
+#ifndef RENDERER_HPP_
+#define RENDERER_HPP_
+
+#include "main.hpp"
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+
+class Canvas;
+class GraphicsManager;
+
+
+// the render thread owns the OpenGL context, the UI thread only sends it
+// commands and asks it for frames
+class RenderThread
+{
+public:
+    RenderThread(Canvas* target, std::shared_ptr<GraphicsManager> manager);
+    ~RenderThread();
+
+    void requestFrame();
+    void setContinuous(bool enable, int cap);
+    void stop();
+    static void sleepUntil(std::chrono::steady_clock::time_point deadline);
+
+private:
+    Canvas* canvas;
+    std::shared_ptr<GraphicsManager> graphicsManager;
+    std::thread thread;
+
+    std::atomic<bool> running;
+    std::atomic<bool> framePending;
+    std::atomic<bool> continuous;
+    std::atomic<int> FPSCap;
+
+    // the mutex is used only for putting the thread to sleep, commands are
+    // passed through the lock-free queue
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+
+    float FPSSmoothing;
+    float FPS;
+    float CPUFrameTime;
+    float GPUFrameTime;
+
+    void loop();
+    void waitForFrame(std::chrono::steady_clock::time_point nextFrame);
+};
+
+
+#endif /* RENDERER_HPP_ */
@@ -0,0 +1,128 @@
+#include "renderqueue.hpp"
+
+#include <algorithm>
+
+
+// from the most significant bits:
+// render mode (2) | program (10) | texture array (20) | mesh (20) | depth (12)
+// names which don't fit only make the grouping worse, the order stays valid
+static const int depthBits = 12;
+static const int meshBits = 20;
+static const int textureBits = 20;
+static const int programBits = 10;
+
+static const int meshShift = depthBits;
+static const int textureShift = meshShift + meshBits;
+static const int programShift = textureShift + textureBits;
+static const int modeShift = programShift + programBits;
+
+
+RenderQueue::RenderQueue()
+{
+    rebuild = true;
+    resorted = 0;
+}
+
+
+// must be called whenever an object is added or removed
+void RenderQueue::invalidate()
+{
+    rebuild = true;
+}
+
+
+// all objects are opaque, so the depth sorts them front-to-back and hidden
+// surfaces fail the early depth test, the program is the variant of the
+// object's triangles
+uint64_t RenderQueue::makeKey(const Scene& scene, int object,
+    const ShaderManager& shaders, const glm::mat4& view, float farPlane)
+{
+    glm::vec4 center = view * glm::vec4(glm::vec3(scene.getBounds(object)),
+        1.0f);
+
+    // the camera looks along the negative z axis
+    float depth = std::min(std::max(-center.z / farPlane, 0.0f), 1.0f);
+    uint64_t depthKey = static_cast<uint64_t>(
+        depth * ((1 << depthBits) - 1));
+
+    auto field = [](uint64_t value, int bits, int shift)
+    {
+        return (value & ((1ull << bits) - 1)) << shift;
+    };
+
+    Texture* texture = scene.getTexture(object);
+    GLuint textureID = texture != nullptr ? texture->getID() : 0;
+    GLuint program = shaders.getID(textureID != 0 ?
+        Object::TEXTURED | Object::LIT : Object::LIT);
+
+    return field(scene.getMode(object), 2, modeShift) |
+        field(program, programBits, programShift) |
+        field(textureID, textureBits, textureShift) |
+        field(scene.getMesh(object), meshBits, meshShift) |
+        depthKey;
+}
+
+
+// the order of the last frame is reused, only the objects whose key changed
+// are sorted again and merged back, so a still scene costs a single pass
+void RenderQueue::build(const Scene& scene, const ShaderManager& shaders,
+    const glm::mat4& view, float farPlane)
+{
+    PROFILE_SCOPE("RenderQueue::build");
+
+    if (rebuild || items.size() != scene.size())
+    {
+        items.clear();
+        for (size_t object = 0; object < scene.size(); object++)
+            items.push_back(Item{makeKey(scene, object, shaders, view,
+                farPlane), static_cast<int>(object)});
+
+        std::sort(items.begin(), items.end());
+        resorted = items.size();
+        rebuild = false;
+        return;
+    }
+
+    unchanged.clear();
+    changed.clear();
+
+    // the unchanged items keep their keys, so they stay sorted
+    for (Item& item : items)
+    {
+        uint64_t key = makeKey(scene, item.object, shaders, view,
+            farPlane);
+
+        if (key == item.key)
+            unchanged.push_back(item);
+        else
+            changed.push_back(Item{key, item.object});
+    }
+
+    resorted = changed.size();
+    if (changed.empty())
+        return;
+
+    std::sort(changed.begin(), changed.end());
+    std::merge(unchanged.begin(), unchanged.end(), changed.begin(),
+        changed.end(), items.begin());
+}
+
+
+size_t RenderQueue::size()
+{
+    return items.size();
+}
+
+
+// dense index of the object in the scene
+int RenderQueue::at(size_t idx)
+{
+    return items[idx].object;
+}
+
+
+// number of items sorted in the last build
+size_t RenderQueue::getResorted()
+{
+    return resorted;
+}
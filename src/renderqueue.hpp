@@ -0,0 +1,53 @@
+#ifndef RENDERQUEUE_HPP_
+#define RENDERQUEUE_HPP_
+
+#include "graphics.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Scene;
+class ShaderManager;
+
+
+// draw order of a frame, objects are sorted by a 64-bit key so the objects
+// sharing the same state are drawn one after another, the items are the
+// dense indices of the scene, so they change when an object is removed
+class RenderQueue
+{
+public:
+    RenderQueue();
+
+    void invalidate();
+    void build(const Scene& scene, const ShaderManager& shaders,
+        const glm::mat4& view, float farPlane);
+    size_t size();
+    int at(size_t idx);
+    size_t getResorted();
+
+private:
+    struct Item
+    {
+        uint64_t key;
+        int object;
+
+        bool operator<(const Item& other) const { return key < other.key; }
+    };
+
+    std::vector<Item> items;
+    bool rebuild;
+    size_t resorted;
+
+    // reused every frame, so the sorting doesn't allocate
+    std::vector<Item> unchanged;
+    std::vector<Item> changed;
+
+    static uint64_t makeKey(const Scene& scene, int object,
+        const ShaderManager& shaders, const glm::mat4& view, float farPlane);
+};
+
+
+#endif /* RENDERQUEUE_HPP_ */
@@ -0,0 +1,292 @@
+#include "scene.hpp"
+#include "graphics.hpp"
+
+#include <algorithm>
+
+
+HandleTable::HandleTable()
+{
+    mirror = false;
+}
+
+
+ObjectHandle HandleTable::create()
+{
+    uint32_t slot;
+
+    if (freeSlots.empty())
+    {
+        slot = slots.size();
+        slots.push_back(Slot{1, -1});
+    }
+    else
+    {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    ObjectHandle handle(slot, slots[slot].generation);
+    slots[slot].dense = handles.size();
+    handles.push_back(handle);
+    return handle;
+}
+
+
+// the handle was created by another table, the render thread mirrors the
+// handles of the UI thread this way
+void HandleTable::insert(ObjectHandle handle)
+{
+    mirror = true;
+
+    if (handle.slot >= slots.size())
+        slots.resize(handle.slot + 1, Slot{0, -1});
+
+    slots[handle.slot].generation = handle.generation;
+    slots[handle.slot].dense = handles.size();
+    handles.push_back(handle);
+}
+
+
+// returns the dense index of the removed handle, the owner moves the last
+// element of its arrays there, -1 if the handle isn't valid
+int HandleTable::remove(ObjectHandle handle)
+{
+    int dense = find(handle);
+    if (dense == -1)
+        return -1;
+
+    ObjectHandle last = handles.back();
+    slots[last.slot].dense = dense;
+    removeAt(handles, dense);
+
+    // handles of the removed object stop matching the slot
+    Slot& slot = slots[handle.slot];
+    slot.generation++;
+    slot.dense = -1;
+    freeSlot(handle.slot);
+
+    return dense;
+}
+
+
+// -1 for handles of deleted objects
+int HandleTable::find(ObjectHandle handle) const
+{
+    if (handle.isNull() || handle.slot >= slots.size())
+        return -1;
+
+    const Slot& slot = slots[handle.slot];
+    if (slot.generation != handle.generation)
+        return -1;
+
+    return slot.dense;
+}
+
+
+ObjectHandle HandleTable::at(int dense) const
+{
+    return handles[dense];
+}
+
+
+size_t HandleTable::size() const
+{
+    return handles.size();
+}
+
+
+// the generations are kept, so the old handles stay invalid
+void HandleTable::clear()
+{
+    for (ObjectHandle handle : handles)
+    {
+        slots[handle.slot].generation++;
+        slots[handle.slot].dense = -1;
+        freeSlot(handle.slot);
+    }
+
+    handles.clear();
+}
+
+
+void HandleTable::freeSlot(uint32_t slot)
+{
+    if (!mirror)
+        freeSlots.push_back(slot);
+}
+
+
+Scene::Scene()
+{
+}
+
+
+// the destructor has to see the whole Object
+Scene::~Scene()
+{
+}
+
+
+void Scene::add(ObjectHandle handle, std::unique_ptr<Object> object)
+{
+    table.insert(handle);
+
+    // the same values are set in the ObjectInfo's constructor
+    visible.push_back(1);
+    models.push_back(glm::mat4(1.0f));
+    bounds.push_back(glm::vec4(0.0f, 0.0f, 0.0f,
+        object->getBoundingRadius()));
+    modes.push_back(0);
+    meshes.push_back(object->getMeshID());
+    textures.push_back(nullptr);
+    positions.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+    rotations.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
+    sizes.push_back(glm::vec3(1.0f, 1.0f, 1.0f));
+    objects.push_back(std::move(object));
+}
+
+
+// the copy gets its own buffers, everything else is the same
+void Scene::duplicate(ObjectHandle source, ObjectHandle handle)
+{
+    int from = find(source);
+    if (from == -1)
+        return;
+
+    add(handle, std::make_unique<Object>(*objects[from]));
+    int to = size() - 1;
+
+    visible[to] = visible[from];
+    models[to] = models[from];
+    bounds[to] = bounds[from];
+    modes[to] = modes[from];
+    textures[to] = textures[from];
+    positions[to] = positions[from];
+    rotations[to] = rotations[from];
+    sizes[to] = sizes[from];
+}
+
+
+void Scene::remove(ObjectHandle handle)
+{
+    int dense = table.remove(handle);
+    if (dense == -1)
+        return;
+
+    HandleTable::removeAt(visible, dense);
+    HandleTable::removeAt(models, dense);
+    HandleTable::removeAt(bounds, dense);
+    HandleTable::removeAt(modes, dense);
+    HandleTable::removeAt(meshes, dense);
+    HandleTable::removeAt(textures, dense);
+    HandleTable::removeAt(positions, dense);
+    HandleTable::removeAt(rotations, dense);
+    HandleTable::removeAt(sizes, dense);
+    HandleTable::removeAt(objects, dense);
+}
+
+
+void Scene::clear()
+{
+    table.clear();
+    visible.clear();
+    models.clear();
+    bounds.clear();
+    modes.clear();
+    meshes.clear();
+    textures.clear();
+    positions.clear();
+    rotations.clear();
+    sizes.clear();
+    objects.clear();
+}
+
+
+int Scene::find(ObjectHandle handle) const
+{
+    return table.find(handle);
+}
+
+
+size_t Scene::size() const
+{
+    return table.size();
+}
+
+
+void Scene::setVisible(int dense, bool show)
+{
+    visible[dense] = show ? 1 : 0;
+}
+
+
+void Scene::setPosition(int dense, glm::vec3 position)
+{
+    positions[dense] = position;
+    updateModel(dense);
+}
+
+
+void Scene::setRotation(int dense, glm::vec3 rotation)
+{
+    rotations[dense] = rotation;
+    updateModel(dense);
+}
+
+
+void Scene::setSize(int dense, glm::vec3 size)
+{
+    sizes[dense] = size;
+    updateModel(dense);
+}
+
+
+void Scene::setTransform(int dense, glm::vec3 position, glm::vec3 rotation,
+    glm::vec3 size)
+{
+    positions[dense] = position;
+    rotations[dense] = rotation;
+    sizes[dense] = size;
+    updateModel(dense);
+}
+
+
+void Scene::setMode(int dense, int mode)
+{
+    modes[dense] = mode;
+}
+
+
+// the object keeps the texture alive, the frames use only the pointer
+void Scene::setTexture(int dense, std::shared_ptr<Texture> texture)
+{
+    objects[dense]->tex = texture;
+    textures[dense] = texture.get();
+}
+
+
+// the model matrix and the bounds are computed only when the object moves,
+// the bounding sphere is scaled by the largest axis of the object
+void Scene::updateModel(int dense)
+{
+    glm::vec3 position = positions[dense];
+    glm::vec3 rotation = rotations[dense];
+    glm::vec3 size = sizes[dense];
+
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::rotate(model, glm::radians(rotation.x),
+        glm::vec3(1.0f, 0.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(rotation.y),
+        glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(model, glm::radians(rotation.z),
+        glm::vec3(0.0f, 0.0f, 1.0f));
+    model = glm::translate(model, position);
+    model = glm::scale(model, size);
+    models[dense] = model;
+
+    size = glm::abs(size);
+    glm::vec3 center = glm::vec3(model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+
+    bounds[dense] = glm::vec4(center, objects[dense]->getBoundingRadius() *
+        std::max(size.x, std::max(size.y, size.z)));
+}
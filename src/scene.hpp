@@ -0,0 +1,144 @@
+#ifndef SCENE_HPP_
+#define SCENE_HPP_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Object;
+class Texture;
+
+
+// identifies an object for as long as it exists, the generation changes when
+// the slot is reused, so a handle of a deleted object never finds another one
+struct ObjectHandle
+{
+    uint32_t slot;
+    uint32_t generation;
+
+    ObjectHandle() : slot(0), generation(0) {}
+    ObjectHandle(uint32_t handleSlot, uint32_t handleGeneration)
+        : slot(handleSlot), generation(handleGeneration) {}
+
+    // the generations start at 1, so the default handle is never valid
+    bool isNull() const { return generation == 0; }
+
+    bool operator==(const ObjectHandle& other) const
+    {
+        return slot == other.slot && generation == other.generation;
+    }
+
+    bool operator!=(const ObjectHandle& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+
+// maps handles to indices of densely packed arrays, the owner keeps its data
+// in the arrays and moves the last element into the removed one, so the
+// arrays never have holes and nothing else moves
+class HandleTable
+{
+public:
+    HandleTable();
+
+    ObjectHandle create();
+    void insert(ObjectHandle handle);
+    int remove(ObjectHandle handle);
+    int find(ObjectHandle handle) const;
+    ObjectHandle at(int dense) const;
+    size_t size() const;
+    void clear();
+
+    // the same removal for every array of the owner
+    template<typename T>
+    static void removeAt(std::vector<T>& data, int dense)
+    {
+        if (static_cast<size_t>(dense) + 1 != data.size())
+            data[dense] = std::move(data.back());
+        data.pop_back();
+    }
+
+private:
+    struct Slot
+    {
+        uint32_t generation;
+        int dense;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<ObjectHandle> handles;
+    // the mirrors only insert the handles of another table, so they never
+    // reuse their free slots
+    bool mirror;
+
+    void freeSlot(uint32_t slot);
+};
+
+
+// objects of the render thread, the data read for every object in every
+// frame is kept in separate arrays, the Objects hold the rest (name, color,
+// buffers), all arrays are indexed by the dense index from the handle table
+class Scene
+{
+public:
+    Scene();
+    ~Scene();
+
+    void add(ObjectHandle handle, std::unique_ptr<Object> object);
+    void duplicate(ObjectHandle source, ObjectHandle handle);
+    void remove(ObjectHandle handle);
+    void clear();
+    int find(ObjectHandle handle) const;
+    size_t size() const;
+
+    void setVisible(int dense, bool show);
+    void setPosition(int dense, glm::vec3 position);
+    void setRotation(int dense, glm::vec3 rotation);
+    void setSize(int dense, glm::vec3 size);
+    void setTransform(int dense, glm::vec3 position, glm::vec3 rotation,
+        glm::vec3 size);
+    void setMode(int dense, int mode);
+    void setTexture(int dense, std::shared_ptr<Texture> texture);
+
+    // called for every object in every frame, so they are inlined
+    bool isVisible(int dense) const { return visible[dense] != 0; }
+    const glm::mat4& getModel(int dense) const { return models[dense]; }
+    const glm::vec4& getBounds(int dense) const { return bounds[dense]; }
+    int getMode(int dense) const { return modes[dense]; }
+    GLuint getMesh(int dense) const { return meshes[dense]; }
+    Texture* getTexture(int dense) const { return textures[dense]; }
+    Object* getObject(int dense) const { return objects[dense].get(); }
+
+    // the whole arrays for the kernels which go through all objects
+    const uint8_t* getVisibleData() const { return visible.data(); }
+    const glm::vec4* getBoundsData() const { return bounds.data(); }
+
+private:
+    HandleTable table;
+
+    // hot data
+    std::vector<uint8_t> visible;
+    std::vector<glm::mat4> models;
+    // center in the world space and radius of the bounding sphere
+    std::vector<glm::vec4> bounds;
+    std::vector<int> modes;
+    std::vector<GLuint> meshes;
+    std::vector<Texture*> textures;
+
+    // cold data, the transform is kept only to be edited, the frames use the
+    // model matrices
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> rotations;
+    std::vector<glm::vec3> sizes;
+    std::vector<std::unique_ptr<Object>> objects;
+
+    void updateModel(int dense);
+};
+
+
+#endif /* SCENE_HPP_ */
@@ -0,0 +1,413 @@
+#include "scenefile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+
+// the file layout, all numbers are little-endian:
+// header | texture records | level records | object records | names |
+// texture payloads | object payloads
+static const char sceneIdentifier[8] = {
+    'W', 'H', 'I', 'S', 'K', 'S', 'C', 'N'
+};
+// the texture hashes are XXH64 since version 3
+static const uint32_t sceneVersion = 3;
+static const uint32_t byteOrder = 0x04030201;
+
+// every payload starts on a page, so a mapped file can be handed to the
+// driver without copying
+static const uint64_t payloadAlignment = 4096;
+
+
+struct FileHeader
+{
+    char identifier[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t textureCount;
+    uint32_t levelCount;
+    uint32_t objectCount;
+    uint32_t namesSize;
+    uint64_t fileSize;
+};
+
+
+struct TextureRecord
+{
+    uint64_t payloadOffset;
+    uint64_t payloadSize;
+    uint64_t hash;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t format;
+    int32_t width;
+    int32_t height;
+    int32_t baseLevel;
+    uint32_t firstLevel;
+    uint32_t levelCount;
+};
+
+
+// the offset is relative to the texture's payload
+struct LevelRecord
+{
+    int32_t width;
+    int32_t height;
+    uint64_t offset;
+    uint64_t size;
+};
+
+
+// the line count is 64-bit since version 2, the meshes can be bigger than
+// 2^31 floats
+struct ObjectRecord
+{
+    uint64_t payloadOffset;
+    uint64_t payloadSize;
+    uint64_t lineCount;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    int32_t texture;
+    int32_t renderMode;
+    uint32_t show;
+    float boundingRadius;
+    float color[3];
+    float position[3];
+    float rotation[3];
+    float size[3];
+};
+
+
+// the records are written as they are, so their layout can't change
+static_assert(sizeof(FileHeader) == 40, "FileHeader layout changed");
+static_assert(sizeof(TextureRecord) == 56, "TextureRecord layout changed");
+static_assert(sizeof(LevelRecord) == 24, "LevelRecord layout changed");
+static_assert(sizeof(ObjectRecord) == 96, "ObjectRecord layout changed");
+
+
+static uint64_t alignPayload(uint64_t offset)
+{
+    return (offset + payloadAlignment - 1) / payloadAlignment *
+        payloadAlignment;
+}
+
+
+// size of a level in the image's data, RGB rows have no padding there
+static uint64_t levelSize(GLenum format, int width, int height)
+{
+    if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+        return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * 8;
+
+    return static_cast<uint64_t>(width) * height * 3;
+}
+
+
+static void copyVec3(float* target, glm::vec3 value)
+{
+    target[0] = value.x;
+    target[1] = value.y;
+    target[2] = value.z;
+}
+
+
+SceneFile::SceneFile() : memory(MemoryTracker::LOADER)
+{
+}
+
+
+// the file is written under another name first, so a reader never sees
+// half of it
+bool SceneFile::write(std::string file)
+{
+    PROFILE_SCOPE("SceneFile::write");
+
+    FileHeader header;
+    memcpy(header.identifier, sceneIdentifier, sizeof(sceneIdentifier));
+    header.version = sceneVersion;
+    header.byteOrder = byteOrder;
+
+    std::string names;
+    std::vector<TextureRecord> textureRecords;
+    std::vector<LevelRecord> levelRecords;
+    std::vector<ObjectRecord> objectRecords;
+
+    for (TextureEntry& entry : textures)
+    {
+        TextureImage& image = *entry.image;
+
+        TextureRecord record;
+        record.payloadSize = image.data.size();
+        record.hash = image.hash;
+        record.nameOffset = names.size();
+        record.nameLength = entry.name.size();
+        record.format = image.format;
+        record.width = image.width;
+        record.height = image.height;
+        record.baseLevel = image.baseLevel;
+        record.firstLevel = levelRecords.size();
+        record.levelCount = image.levels.size();
+        textureRecords.push_back(record);
+
+        names += entry.name;
+
+        for (TextureImage::Level& level : image.levels)
+            levelRecords.push_back(LevelRecord{level.width, level.height,
+                level.offset, level.size});
+    }
+
+    for (ObjectEntry& entry : objects)
+    {
+        ObjectRecord record;
+        record.payloadSize = entry.vertices->size() * sizeof(GLfloat);
+        record.nameOffset = names.size();
+        record.nameLength = entry.name.size();
+        record.texture = entry.texture;
+        record.renderMode = entry.renderMode;
+        record.lineCount = entry.lineCount;
+        record.show = entry.show ? 1 : 0;
+        record.boundingRadius = entry.boundingRadius;
+        copyVec3(record.color, entry.color);
+        copyVec3(record.position, entry.position);
+        copyVec3(record.rotation, entry.rotation);
+        copyVec3(record.size, entry.size);
+        objectRecords.push_back(record);
+
+        names += entry.name;
+    }
+
+    header.textureCount = textureRecords.size();
+    header.levelCount = levelRecords.size();
+    header.objectCount = objectRecords.size();
+    header.namesSize = names.size();
+
+    // the payloads follow the tables in the same order as the records
+    uint64_t tablesEnd = sizeof(FileHeader) +
+        textureRecords.size() * sizeof(TextureRecord) +
+        levelRecords.size() * sizeof(LevelRecord) +
+        objectRecords.size() * sizeof(ObjectRecord) + names.size();
+    uint64_t offset = tablesEnd;
+
+    for (TextureRecord& record : textureRecords)
+    {
+        offset = alignPayload(offset);
+        record.payloadOffset = offset;
+        offset += record.payloadSize;
+    }
+
+    for (ObjectRecord& record : objectRecords)
+    {
+        offset = alignPayload(offset);
+        record.payloadOffset = offset;
+        offset += record.payloadSize;
+    }
+
+    header.fileSize = offset;
+
+    std::string tempFile = file + ".tmp";
+    std::ofstream out(tempFile, std::ios::binary);
+    if (!out.is_open())
+        return false;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(textureRecords.data()),
+        textureRecords.size() * sizeof(TextureRecord));
+    out.write(reinterpret_cast<const char*>(levelRecords.data()),
+        levelRecords.size() * sizeof(LevelRecord));
+    out.write(reinterpret_cast<const char*>(objectRecords.data()),
+        objectRecords.size() * sizeof(ObjectRecord));
+    out.write(names.data(), names.size());
+
+    const char padding[payloadAlignment] = {};
+    uint64_t written = tablesEnd;
+
+    auto writePayload = [&out, &padding, &written](uint64_t payloadOffset,
+        const void* data, uint64_t size)
+    {
+        out.write(padding, payloadOffset - written);
+        out.write(static_cast<const char*>(data), size);
+        written = payloadOffset + size;
+    };
+
+    for (size_t i = 0; i < textures.size(); i++)
+        writePayload(textureRecords[i].payloadOffset,
+            textures[i].image->data.data(), textureRecords[i].payloadSize);
+
+    for (size_t i = 0; i < objects.size(); i++)
+        writePayload(objectRecords[i].payloadOffset,
+            objects[i].vertices->data(), objectRecords[i].payloadSize);
+
+    // the previous scene is kept until the new one replaces it
+    out.close();
+    if (out.fail() || !replaceFile(tempFile, file))
+    {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+// the tables are read at once, then every payload is read straight into the
+// memory it is uploaded from, nullptr if the file isn't valid
+std::shared_ptr<SceneFile> SceneFile::read(std::string file)
+{
+    PROFILE_SCOPE("SceneFile::read");
+
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in.is_open())
+        return nullptr;
+
+    uint64_t fileSize = in.tellg();
+    in.seekg(0);
+
+    FileHeader header;
+    if (fileSize < sizeof(header))
+        return nullptr;
+
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    // files written on a machine with other endianness aren't supported
+    if (in.fail() || memcmp(header.identifier, sceneIdentifier,
+        sizeof(sceneIdentifier)) != 0 || header.version != sceneVersion ||
+        header.byteOrder != byteOrder || header.fileSize != fileSize)
+        return nullptr;
+
+    uint64_t tablesEnd = sizeof(FileHeader) +
+        static_cast<uint64_t>(header.textureCount) * sizeof(TextureRecord) +
+        static_cast<uint64_t>(header.levelCount) * sizeof(LevelRecord) +
+        static_cast<uint64_t>(header.objectCount) * sizeof(ObjectRecord) +
+        header.namesSize;
+    if (tablesEnd > fileSize)
+        return nullptr;
+
+    std::vector<TextureRecord> textureRecords(header.textureCount);
+    std::vector<LevelRecord> levelRecords(header.levelCount);
+    std::vector<ObjectRecord> objectRecords(header.objectCount);
+    std::string names(header.namesSize, '\0');
+
+    in.read(reinterpret_cast<char*>(textureRecords.data()),
+        textureRecords.size() * sizeof(TextureRecord));
+    in.read(reinterpret_cast<char*>(levelRecords.data()),
+        levelRecords.size() * sizeof(LevelRecord));
+    in.read(reinterpret_cast<char*>(objectRecords.data()),
+        objectRecords.size() * sizeof(ObjectRecord));
+    in.read(&names[0], names.size());
+
+    if (in.fail())
+        return nullptr;
+
+    auto validRange = [](uint64_t offset, uint64_t size, uint64_t limit)
+    {
+        return offset <= limit && size <= limit - offset;
+    };
+
+    std::shared_ptr<SceneFile> scene = std::make_shared<SceneFile>();
+
+    for (TextureRecord& record : textureRecords)
+    {
+        if (!validRange(record.payloadOffset, record.payloadSize, fileSize) ||
+            record.payloadOffset < tablesEnd ||
+            !validRange(record.nameOffset, record.nameLength, names.size()) ||
+            !validRange(record.firstLevel, record.levelCount,
+            levelRecords.size()) || record.levelCount == 0 ||
+            record.width <= 0 || record.height <= 0 || record.baseLevel < 0)
+            return nullptr;
+
+        if (record.format != GL_RGB8 &&
+            record.format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+            return nullptr;
+
+        // compressed images have all their levels, the others only the first
+        uint32_t levelCount = record.format == GL_RGB8 ? 1 :
+            TextureImage::levelCount(record.width, record.height);
+        if (record.levelCount != levelCount)
+            return nullptr;
+
+        std::shared_ptr<TextureImage> image =
+            std::make_shared<TextureImage>();
+        image->format = record.format;
+        image->width = record.width;
+        image->height = record.height;
+        image->baseLevel = record.baseLevel;
+
+        for (uint32_t i = 0; i < record.levelCount; i++)
+        {
+            LevelRecord& level = levelRecords[record.firstLevel + i];
+
+            if (level.width != std::max(record.width >> i, 1) ||
+                level.height != std::max(record.height >> i, 1) ||
+                level.size !=
+                levelSize(record.format, level.width, level.height) ||
+                !validRange(level.offset, level.size, record.payloadSize))
+                return nullptr;
+
+            image->levels.push_back(TextureImage::Level{level.width,
+                level.height, level.offset, level.size});
+        }
+
+        image->data.resize(record.payloadSize);
+        in.seekg(record.payloadOffset);
+        in.read(reinterpret_cast<char*>(image->data.data()),
+            image->data.size());
+        if (in.fail())
+            return nullptr;
+
+        // the identical images are shared by their hash, so a stored hash
+        // which doesn't match the pixels would alias different images
+        image->computeHash();
+        if (image->hash != record.hash)
+            return nullptr;
+
+        image->memory.resize(image->data.size());
+        scene->textures.push_back(TextureEntry{
+            names.substr(record.nameOffset, record.nameLength), image});
+    }
+
+    size_t vertexBytes = 0;
+    size_t vertexSize = Object::vertexStride * sizeof(GLfloat);
+
+    for (ObjectRecord& record : objectRecords)
+    {
+        if (!validRange(record.payloadOffset, record.payloadSize, fileSize) ||
+            record.payloadOffset < tablesEnd ||
+            !validRange(record.nameOffset, record.nameLength, names.size()) ||
+            record.payloadSize % vertexSize != 0 ||
+            record.lineCount / 3 > record.payloadSize / vertexSize ||
+            record.texture < -1 ||
+            record.texture >= static_cast<int32_t>(header.textureCount) ||
+            record.renderMode < 0 || record.renderMode > 2)
+            return nullptr;
+
+        ObjectEntry entry;
+        entry.name = names.substr(record.nameOffset, record.nameLength);
+        entry.show = record.show != 0;
+        entry.color = glm::vec3(record.color[0], record.color[1],
+            record.color[2]);
+        entry.position = glm::vec3(record.position[0], record.position[1],
+            record.position[2]);
+        entry.rotation = glm::vec3(record.rotation[0], record.rotation[1],
+            record.rotation[2]);
+        entry.size = glm::vec3(record.size[0], record.size[1],
+            record.size[2]);
+        entry.renderMode = record.renderMode;
+        entry.texture = record.texture;
+        entry.lineCount = record.lineCount;
+        entry.boundingRadius = record.boundingRadius;
+
+        entry.vertices = std::make_shared<std::vector<GLfloat>>(
+            record.payloadSize / sizeof(GLfloat));
+        in.seekg(record.payloadOffset);
+        in.read(reinterpret_cast<char*>(entry.vertices->data()),
+            record.payloadSize);
+        if (in.fail())
+            return nullptr;
+
+        vertexBytes += record.payloadSize;
+        scene->objects.push_back(entry);
+    }
+
+    scene->memory.resize(vertexBytes);
+    return scene;
+}
@@ -0,0 +1,60 @@
+#ifndef SCENEFILE_HPP_
+#define SCENEFILE_HPP_
+
+#include "graphics.hpp"
+#include "memory.hpp"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct TextureImage;
+
+
+// saved scene with the geometry and the textures in the form they are
+// uploaded in, so nothing has to be parsed, interleaved or encoded again
+// when it is restored; the file starts with fixed-size tables and every
+// payload starts on a page boundary, so it can be mapped and uploaded as
+// it is
+struct SceneFile
+{
+    struct TextureEntry
+    {
+        std::string name;
+        std::shared_ptr<TextureImage> image;
+    };
+
+    struct ObjectEntry
+    {
+        std::string name;
+        bool show;
+        glm::vec3 color;
+        glm::vec3 position;
+        glm::vec3 rotation;
+        glm::vec3 size;
+        int renderMode;
+        // index into the textures, -1 when the object has only its color
+        int texture;
+        size_t lineCount;
+        float boundingRadius;
+        // interleaved vertices as they are stored in the vertex buffer
+        std::shared_ptr<std::vector<GLfloat>> vertices;
+    };
+
+    std::vector<TextureEntry> textures;
+    std::vector<ObjectEntry> objects;
+
+    // the vertices count to the loader until the scene is uploaded
+    TrackedAllocation memory;
+
+    SceneFile();
+
+    bool write(std::string file);
+    static std::shared_ptr<SceneFile> read(std::string file);
+};
+
+
+#endif /* SCENEFILE_HPP_ */
@@ -1,12 +1,15 @@
 #include "shaders.hpp"
 
 
+// the source is only loaded here, it's compiled for every variant which
+// isn't in the cache
 Shader::Shader(const char* shaderFile, const GLenum type) : shaderType(type)
 {
     initialized = false;
-    std::string shaderString = openFile(shaderFile);
+    fileName = shaderFile;
+    source = openFile(shaderFile);
 
-    if (shaderString.empty())
+    if (source.empty())
     {
         #ifdef DEBUG
             std::cout << "Shader failed to load: " << shaderFile << std::endl;
@@ -18,11 +21,28 @@ Shader::Shader(const char* shaderFile, const GLenum type) : shaderType(type)
         std::cout << "Shader loaded: " << shaderFile << std::endl;
     #endif /* DEBUG */
 
-    const char* shaderSource = shaderString.c_str();
+    initialized = true;
+}
 
-    ID = glCreateShader(shaderType);
 
-    initialized = true;
+// the defines have to follow the #version line, the caller owns the
+// returned shader, the status isn't queried outside of debug builds, so the
+// driver can compile on its own threads until the program is linked
+GLuint Shader::compile(const std::string& defines) const
+{
+    std::string variantSource = source;
+
+    size_t version = variantSource.find("#version");
+    if (version != std::string::npos)
+    {
+        size_t lineEnd = variantSource.find('\n', version);
+        variantSource.insert(lineEnd == std::string::npos ?
+            variantSource.size() : lineEnd + 1, defines);
+    }
+
+    const char* shaderSource = variantSource.c_str();
+
+    GLuint ID = glCreateShader(shaderType);
 
     // send shader code to OpenGL
     glShaderSource(ID, 1, &shaderSource, NULL);
@@ -38,33 +58,34 @@ Shader::Shader(const char* shaderFile, const GLenum type) : shaderType(type)
             GLchar message[1024];
             glGetShaderInfoLog(ID, 1024, &logLength, message);
 
-            std::cout << "Shader compilation failed: " << shaderFile << "\n"
-                << message << std::endl;
+            std::cout << "Shader compilation failed: " << fileName << "\n"
+                << defines << message << std::endl;
         }
         else
         {
-            std::cout << "Shader compiled: " << shaderFile << std::endl;
+            std::cout << "Shader compiled: " << fileName << std::endl;
         }
     #endif /* DEBUG */
+
+    return ID;
 }
 
 
-Shader::~Shader()
+GLenum Shader::getType() const
 {
-    if (initialized)
-        glDeleteShader(ID);
+    return shaderType;
 }
 
 
-GLuint Shader::getID() const
+bool Shader::getInitialized() const
 {
-    return ID;
+    return initialized;
 }
 
 
-bool Shader::getInitialized() const
+const std::string& Shader::getSource() const
 {
-    return initialized;
+    return source;
 }
 
 
@@ -89,15 +110,30 @@ std::string Shader::openFile(const char *filename)
 }
 
 
+// the binary cache file starts with this, followed by the key, the binary
+// format and the length of the binary
+static const char binaryIdentifier[8] = {'W', 'H', 'I', 'S', 'K', 'P', 'R',
+    'G'};
+
+std::string ShaderManager::cacheDirectory;
+
+
+// the programs are created when they are linked
 ShaderManager::ShaderManager()
 {
-    ID = glCreateProgram();
 }
 
 
 ShaderManager::~ShaderManager()
 {
-    glDeleteProgram(ID);
+    for (GLuint program : programs)
+    {
+        if (program == 0)
+            continue;
+
+        GLState::instance().forgetProgram(program);
+        glDeleteProgram(program);
+    }
 }
 
 
@@ -138,44 +174,267 @@ void ShaderManager::addShader(const char* file)
 }
 
 
+void ShaderManager::addFeature(const char* define)
+{
+    features.push_back(define);
+}
+
+
+void ShaderManager::addVariant(int variant)
+{
+    variants.push_back(variant);
+}
+
+
+// all variants are linked at once, the shaders of every variant are
+// compiled before any status is queried, so the driver can work on all of
+// them in parallel, the variants loaded from the cache skip the compiling
 bool ShaderManager::linkProgram()
 {
-    for(auto it = vertexShaders.begin(); it != vertexShaders.end(); it++)
-        glAttachShader(ID, (*it)->getID());
+    size_t count = static_cast<size_t>(1) << features.size();
+    programs.assign(count, 0);
 
-    for(auto it = fragmentShaders.begin(); it != fragmentShaders.end(); it++)
-        glAttachShader(ID, (*it)->getID());
+    std::vector<int> built = variants;
+    if (built.empty())
+        for (size_t variant = 0; variant < count; variant++)
+            built.push_back(variant);
 
-    // all attached shaders are linked together into a shader program
-    glLinkProgram(ID);
+    std::vector<std::string> cacheFiles(count);
+    std::vector<uint64_t> keys(count);
+    std::vector<std::vector<GLuint>> attached(count);
+    bool compiling = false;
 
-    GLint linkStatus;
-    glGetProgramiv(ID, GL_LINK_STATUS, &linkStatus);
-    if (linkStatus != GL_TRUE)
+    for (int variant : built)
     {
-        #ifdef DEBUG
-            GLsizei logLength = 0;
-            GLchar message[1024];
-            glGetProgramInfoLog(ID, 1024, &logLength, message);
+        programs[variant] = glCreateProgram();
+        std::string variantDefines = defines(variant);
+
+        // the driver can't load binaries of other drivers or of older
+        // versions of itself, so they are a part of the key
+        if (!cacheDirectory.empty())
+        {
+            keys[variant] = cacheKey(variantDefines);
+
+            char name[24];
+            snprintf(name, sizeof(name), "%016llx.bin",
+                static_cast<unsigned long long>(keys[variant]));
+            cacheFiles[variant] = cacheDirectory + "/" + name;
+
+            if (loadBinary(programs[variant], cacheFiles[variant],
+                keys[variant]))
+            {
+                #ifdef DEBUG
+                    std::cout << "Shader program loaded from the cache"
+                        << std::endl;
+                #endif /* DEBUG */
+                continue;
+            }
+        }
+
+        // the driver may compile the shaders in parallel, the results are
+        // first needed by the link status below
+        if (!compiling && GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        compiling = true;
+
+        for (auto shaders : {&vertexShaders, &fragmentShaders})
+            for (const std::unique_ptr<Shader>& shader : *shaders)
+            {
+                GLuint ID = shader->compile(variantDefines);
+                glAttachShader(programs[variant], ID);
+                attached[variant].push_back(ID);
+            }
+
+        if (!cacheFiles[variant].empty())
+            glProgramParameteri(programs[variant],
+                GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+        // all attached shaders are linked together into a shader program
+        glLinkProgram(programs[variant]);
+    }
 
-            std::cout << "Shader program linking failed:\n" << message
-                << std::endl;
+    bool linked = true;
+
+    for (int variant : built)
+    {
+        // the binaries from the cache are already linked
+        if (attached[variant].empty())
+        {
+            GLState::instance().addProgram(programs[variant]);
+            continue;
+        }
+
+        GLint linkStatus;
+        glGetProgramiv(programs[variant], GL_LINK_STATUS, &linkStatus);
+
+        // the linked program doesn't need the shaders anymore
+        for (GLuint ID : attached[variant])
+        {
+            glDetachShader(programs[variant], ID);
+            glDeleteShader(ID);
+        }
+
+        if (linkStatus != GL_TRUE)
+        {
+            #ifdef DEBUG
+                GLsizei logLength = 0;
+                GLchar message[1024];
+                glGetProgramInfoLog(programs[variant], 1024, &logLength,
+                    message);
+
+                std::cout << "Shader program linking failed:\n"
+                    << defines(variant) << message << std::endl;
+            #endif /* DEBUG */
+            linked = false;
+            continue;
+        }
+        #ifdef DEBUG
+            std::cout << "Shader program linked" << std::endl;
         #endif /* DEBUG */
-        return false;
+
+        GLState::instance().addProgram(programs[variant]);
+
+        if (!cacheFiles[variant].empty())
+            saveBinary(programs[variant], cacheFiles[variant], keys[variant]);
     }
-    #ifdef DEBUG
-        std::cout << "Shader program linked" << std::endl;
-    #endif /* DEBUG */
-    return true;
+
+    return linked;
 }
 
 
-void ShaderManager::useProgram()
+void ShaderManager::useProgram(int variant)
 {
-    glUseProgram(ID);
+    GLState::instance().useProgram(getID(variant));
 }
 
-GLuint ShaderManager::getID() const
+
+// 0 until the programs are linked and for the variants which aren't built
+GLuint ShaderManager::getID(int variant) const
 {
-    return ID;
+    if (static_cast<size_t>(variant) >= programs.size())
+        return 0;
+
+    return programs[variant];
+}
+
+
+void ShaderManager::setCacheDirectory(std::string directory)
+{
+    cacheDirectory = directory;
+}
+
+
+std::string ShaderManager::defines(int variant)
+{
+    std::string lines;
+
+    for (size_t feature = 0; feature < features.size(); feature++)
+        if (variant & (1 << feature))
+            lines += "#define " + features[feature] + "\n";
+
+    return lines;
+}
+
+
+// hash of the sources, of the defines of the variant and of the driver which
+// compiles them
+uint64_t ShaderManager::cacheKey(const std::string& variantDefines)
+{
+    uint64_t hash = hashData(reinterpret_cast<const unsigned char*>(
+        variantDefines.data()), variantDefines.size());
+
+    for (auto shaders : {&vertexShaders, &fragmentShaders})
+        for (const std::unique_ptr<Shader>& shader : *shaders)
+        {
+            GLenum type = shader->getType();
+            const std::string& source = shader->getSource();
+            hash = hashData(reinterpret_cast<const unsigned char*>(&type),
+                sizeof(type), hash);
+            hash = hashData(reinterpret_cast<const unsigned char*>(
+                source.data()), source.size(), hash);
+        }
+
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        const GLubyte* value = glGetString(name);
+        if (value != nullptr)
+            hash = hashData(value, strlen(reinterpret_cast<const char*>(
+                value)) + 1, hash);
+    }
+
+    return hash;
+}
+
+
+// the driver still rejects binaries it doesn't like, the shaders are
+// compiled in that case
+bool ShaderManager::loadBinary(GLuint program, std::string file,
+    uint64_t key)
+{
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in.is_open())
+        return false;
+
+    std::vector<char> data(in.tellg());
+    in.seekg(0);
+    in.read(data.data(), data.size());
+
+    size_t headerSize = sizeof(binaryIdentifier) + sizeof(uint64_t) +
+        2 * sizeof(uint32_t);
+    if (in.fail() || data.size() < headerSize || memcmp(data.data(),
+        binaryIdentifier, sizeof(binaryIdentifier)) != 0)
+        return false;
+
+    uint64_t fileKey;
+    uint32_t format, length;
+    size_t offset = sizeof(binaryIdentifier);
+    memcpy(&fileKey, data.data() + offset, sizeof(fileKey));
+    offset += sizeof(fileKey);
+    memcpy(&format, data.data() + offset, sizeof(format));
+    offset += sizeof(format);
+    memcpy(&length, data.data() + offset, sizeof(length));
+    offset += sizeof(length);
+
+    if (fileKey != key || length != data.size() - headerSize)
+        return false;
+
+    glProgramBinary(program, format, data.data() + offset, length);
+
+    GLint linkStatus;
+    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+    return linkStatus == GL_TRUE;
+}
+
+
+void ShaderManager::saveBinary(GLuint program, std::string file,
+    uint64_t key)
+{
+    // drivers without any binary format return nothing
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    std::string tempFile = file + ".tmp";
+    std::ofstream out(tempFile, std::ios::binary);
+    if (!out.is_open())
+        return;
+
+    uint32_t fileFormat = format;
+    uint32_t fileLength = length;
+    out.write(binaryIdentifier, sizeof(binaryIdentifier));
+    out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+    out.write(reinterpret_cast<const char*>(&fileFormat),
+        sizeof(fileFormat));
+    out.write(reinterpret_cast<const char*>(&fileLength),
+        sizeof(fileLength));
+    out.write(binary.data(), length);
+
+    out.close();
+    if (out.fail() || !replaceFile(tempFile, file))
+        std::remove(tempFile.c_str());
 }
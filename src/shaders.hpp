@@ -1,8 +1,11 @@
 #ifndef SHADERS_HPP_
 #define SHADERS_HPP_
 
-#include "main.hpp"
+#include "graphics.hpp"
 
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <fstream>
 #include <regex>
@@ -20,19 +23,25 @@ class Shader
 {
 public:
     Shader(const char* shaderFile, const GLenum type);
-    ~Shader();
 
-    GLuint getID() const;
+    GLuint compile(const std::string& defines) const;
+    GLenum getType() const;
     bool getInitialized() const;
+    const std::string& getSource() const;
 
 private:
-    GLuint ID;
     const GLenum shaderType;
     bool initialized;
+    std::string fileName;
+    std::string source;
 
     std::string openFile(const char* filename);
 };
 
+// every feature is a #define in the sources and doubles the number of
+// possible programs, a variant is the mask of its features in the order they
+// were added, so the shaders never branch on them, only the added variants
+// are built (all of them when none is added)
 class ShaderManager
 {
 public:
@@ -40,15 +49,29 @@ public:
     ~ShaderManager();
 
     void addShader(const char* file);
+    void addFeature(const char* define);
+    void addVariant(int variant);
     bool linkProgram();
-    void useProgram();
-    GLuint getID() const;
+    void useProgram(int variant = 0);
+    GLuint getID(int variant = 0) const;
+
+    // linked programs are stored there as driver binaries, empty disables
+    // the cache
+    static void setCacheDirectory(std::string directory);
 
 private:
-    GLuint ID;
+    std::vector<GLuint> programs;
+    std::vector<std::string> features;
+    std::vector<int> variants;
     std::vector<std::unique_ptr<Shader>> vertexShaders;
     std::vector<std::unique_ptr<Shader>> fragmentShaders;
-};
 
+    static std::string cacheDirectory;
+
+    std::string defines(int variant);
+    uint64_t cacheKey(const std::string& variantDefines);
+    bool loadBinary(GLuint program, std::string file, uint64_t key);
+    void saveBinary(GLuint program, std::string file, uint64_t key);
+};
 
 #endif /* SHADERS_HPP_ */
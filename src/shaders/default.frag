@@ -4,38 +4,51 @@
 
 out vec4 finalColor;
 
+// TEXTURED and LIT are defined by the ShaderManager for each variant
 in vec3 vertColor;
+#ifdef TEXTURED
 in vec2 vertTexCoord;
+#endif
+#ifdef LIT
 in vec3 vertNormal;
 in vec3 vertPos;
+#endif
 
-uniform int useTex;
-uniform sampler2D tex;
-uniform vec3 lightColor;
-uniform vec3 lightPos;
+layout (std140, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    vec4 lightColor;
+    vec4 lightPos;
+};
+
+#ifdef TEXTURED
+uniform int texLayer;
+uniform sampler2DArray tex;
+#endif
 
 void main()
 {
-    if (length(vertNormal) == 0)
-    {
-        finalColor = vec4(vertColor, 1.0f);
-        return;
-    }
-    
+#ifdef LIT
     float ambientLightStrength = 0.1f;
-    vec3 ambientLight = ambientLightStrength * lightColor;
+    vec3 ambientLight = ambientLightStrength * lightColor.rgb;
 
     float diffuseLightStrength = 1.0f;
     float diffuse = abs(
-        dot(normalize(vertNormal), normalize(lightPos - vertPos)));
-    vec3 diffuseLight = diffuse * diffuseLightStrength * lightColor;
-
-    if (useTex == 1)
-    {
-        vec4 lightVec = vec4((ambientLight + diffuseLight), 1.0f);
-        finalColor = lightVec * texture(tex, vertTexCoord);
-        return;
-    }
-
-    finalColor = vec4((ambientLight + diffuseLight) * vertColor, 1.0f);
+        dot(normalize(vertNormal), normalize(lightPos.xyz - vertPos)));
+    vec3 diffuseLight = diffuse * diffuseLightStrength * lightColor.rgb;
+
+    vec3 light = ambientLight + diffuseLight;
+#else
+    // lines have no normals, they keep their color
+    vec3 light = vec3(1.0f);
+#endif
+
+#ifdef TEXTURED
+    // images are stored from the top row, OpenGL starts at the bottom
+    finalColor = vec4(light, 1.0f) * texture(tex,
+        vec3(vertTexCoord.x, 1.0f - vertTexCoord.y, texLayer));
+#else
+    finalColor = vec4(light * vertColor, 1.0f);
+#endif
 }
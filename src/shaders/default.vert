@@ -7,20 +7,35 @@ layout (location = 1) in vec3 inColor;
 layout (location = 2) in vec2 inTexCoord;
 layout (location = 3) in vec3 inNormal;
 
+layout (std140, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    vec4 lightColor;
+    vec4 lightPos;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
+// TEXTURED and LIT are defined by the ShaderManager for each variant
 out vec3 vertColor;
+#ifdef TEXTURED
 out vec2 vertTexCoord;
+#endif
+#ifdef LIT
 out vec3 vertNormal;
 out vec3 vertPos;
+#endif
 
 void main()
 {
     gl_Position = projection * view * model * vec4(inPos, 1.0);
     vertColor = inColor;
+#ifdef TEXTURED
     vertTexCoord = inTexCoord;
+#endif
+#ifdef LIT
     vertNormal = mat3(transpose(inverse(model))) * inNormal;
     vertPos = vec3(model * vec4(inPos, 1.0f));
+#endif
 }
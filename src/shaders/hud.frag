@@ -0,0 +1,19 @@
+#version 460 core
+
+out vec4 finalColor;
+
+in vec2 vertTexCoord;
+
+uniform sampler2D glyphs;
+
+void main()
+{
+    // the background has no glyph
+    if (vertTexCoord.x < 0.0f)
+    {
+        finalColor = vec4(0.0f, 0.0f, 0.0f, 0.5f);
+        return;
+    }
+
+    finalColor = vec4(1.0f, 1.0f, 1.0f, texture(glyphs, vertTexCoord).r);
+}
@@ -0,0 +1,15 @@
+#version 460 core
+
+layout (location = 0) in vec2 inPos;
+layout (location = 1) in vec2 inTexCoord;
+
+// maps the window pixels from the top left corner to the clip space
+uniform mat4 screen;
+
+out vec2 vertTexCoord;
+
+void main()
+{
+    gl_Position = screen * vec4(inPos, 0.0f, 1.0f);
+    vertTexCoord = inTexCoord;
+}
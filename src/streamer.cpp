@@ -0,0 +1,283 @@
+#include "streamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+
+// the levels are made by the jobs and handed to the uploader on the render
+// thread
+TextureStreamer::TextureStreamer(TextureUploader* textureUploader)
+    : uploader(textureUploader)
+{
+    budget = static_cast<size_t>(512) * 1024 * 1024;
+    used = 0;
+    allocated = 0;
+}
+
+
+void TextureStreamer::setBudget(size_t bytes)
+{
+    budget = bytes;
+}
+
+
+size_t TextureStreamer::getBudget()
+{
+    return budget;
+}
+
+
+// memory of the layers used by textures in the last frame
+size_t TextureStreamer::getUsed()
+{
+    return used;
+}
+
+
+// includes the free layers of the texture arrays
+size_t TextureStreamer::getAllocated()
+{
+    return allocated;
+}
+
+
+// the level is chosen so that a texel covers about one pixel when the
+// texture is stretched over the whole object once, the bounds are the
+// object's bounding sphere in the world space
+void TextureStreamer::markVisible(Texture* texture, const glm::vec4& bounds,
+    const glm::mat4& view, float pixelsPerUnit, uint64_t frame)
+{
+    if (texture == nullptr || texture->getSource() == nullptr)
+        return;
+
+    TextureImage& source = *texture->getSource();
+
+    glm::vec4 center = view * glm::vec4(glm::vec3(bounds), 1.0f);
+    float depth = std::max(-center.z, 0.1f);
+    float pixels = 2.0f * bounds.w / depth * pixelsPerUnit;
+
+    int levels = TextureImage::levelCount(source.width, source.height);
+    int level = levels - 1;
+    if (pixels >= 1.0f)
+        level = std::floor(std::log2(
+            std::max(source.width, source.height) / pixels));
+
+    texture->requestLevel(std::min(std::max(level, 0), levels - 1), frame);
+}
+
+
+// the usage is measured after the uploads of the previous frames finished,
+// the levels which are still uploaded are counted as if they were done
+void TextureStreamer::update(std::vector<std::shared_ptr<Texture>>& textures,
+    std::vector<std::shared_ptr<TextureArray>>& arrays, uint64_t frame)
+{
+    PROFILE_SCOPE("TextureStreamer::update");
+
+    // arrays left empty by the streamed textures are freed
+    arrays.erase(std::remove_if(arrays.begin(), arrays.end(),
+        [](std::shared_ptr<TextureArray>& array){
+            return array.use_count() == 1;
+        }), arrays.end());
+
+    used = 0;
+    allocated = 0;
+    for (auto& array : arrays)
+    {
+        used += array->getUsedSize();
+        allocated += array->getAllocatedSize();
+    }
+
+    int64_t expected = used;
+
+    // a layer which is being streamed counts only once, its other textures
+    // wait for it
+    std::unordered_set<uint64_t> streaming;
+    for (auto& texture : textures)
+    {
+        if (texture->getSource() == nullptr ||
+            texture->getStreamingLevel() == -1)
+            continue;
+
+        streaming.insert(texture->getHash());
+
+        // the first upload replaces the placeholder
+        if (texture->getLayerSize() != 0)
+            expected += static_cast<int64_t>(levelSize(*texture,
+                texture->getStreamingLevel())) - texture->getLayerSize();
+    }
+
+    // the textures with the same hash share their layer, the group is
+    // visible when any of them is and wants the most detailed level
+    std::vector<Group> candidates;
+    std::unordered_map<uint64_t, size_t> groups;
+
+    for (auto& texture : textures)
+    {
+        if (texture->getSource() == nullptr ||
+            texture->getStreamingLevel() != -1 ||
+            streaming.count(texture->getHash()) != 0)
+            continue;
+
+        auto group = groups.find(texture->getHash());
+        if (group == groups.end())
+        {
+            groups[texture->getHash()] = candidates.size();
+            candidates.push_back(Group{texture, texture->getLastVisible(),
+                texture->getWantedLevel()});
+            continue;
+        }
+
+        Group& candidate = candidates[group->second];
+        if (texture->getLastVisible() > candidate.lastVisible)
+        {
+            candidate.lastVisible = texture->getLastVisible();
+            candidate.wantedLevel = texture->getWantedLevel();
+        }
+        else if (texture->getLastVisible() == candidate.lastVisible)
+            candidate.wantedLevel = std::min(candidate.wantedLevel,
+                texture->getWantedLevel());
+    }
+
+    int changes = 0;
+
+    if (expected > static_cast<int64_t>(budget))
+    {
+        // least recently visible first, then the ones with more detail
+        // than their objects need
+        std::sort(candidates.begin(), candidates.end(),
+            [](const Group& a, const Group& b){
+                if (a.lastVisible != b.lastVisible)
+                    return a.lastVisible < b.lastVisible;
+
+                return a.wantedLevel - a.texture->getResidentLevel() >
+                    b.wantedLevel - b.texture->getResidentLevel();
+            });
+
+        for (Group& candidate : candidates)
+        {
+            if (changes == maxChanges ||
+                expected <= static_cast<int64_t>(budget))
+                break;
+
+            Texture& texture = *candidate.texture;
+            int level = texture.getResidentLevel() + 1;
+            if (level > maxLevel(texture))
+                continue;
+
+            expected -= texture.getLayerSize() - levelSize(texture, level);
+            stream(candidate.texture, level);
+            changes++;
+        }
+
+        return;
+    }
+
+    // the visible textures missing the most levels get them first
+    std::sort(candidates.begin(), candidates.end(),
+        [](const Group& a, const Group& b){
+            return a.texture->getResidentLevel() - a.wantedLevel >
+                b.texture->getResidentLevel() - b.wantedLevel;
+        });
+
+    for (Group& candidate : candidates)
+    {
+        if (changes == maxChanges)
+            break;
+
+        Texture& texture = *candidate.texture;
+        if (candidate.lastVisible != frame ||
+            candidate.wantedLevel >= texture.getResidentLevel())
+            continue;
+
+        // a single level is better than nothing when the whole image
+        // doesn't fit
+        int level = candidate.wantedLevel;
+        for (; level < texture.getResidentLevel(); level++)
+        {
+            int64_t growth = static_cast<int64_t>(levelSize(texture,
+                level)) - texture.getLayerSize();
+
+            if (expected + growth <= static_cast<int64_t>(budget))
+            {
+                expected += growth;
+                stream(candidate.texture, level);
+                changes++;
+                break;
+            }
+        }
+    }
+}
+
+
+// the render thread waits for the levels before it releases the uploader,
+// the jobs post the uploads before they finish, so they are added by its
+// last commands
+void TextureStreamer::finishJobs()
+{
+    JobSystem::instance().wait(levelJobs);
+}
+
+
+// the smallest textures aren't streamed at all
+int TextureStreamer::maxLevel(Texture& texture)
+{
+    TextureImage& source = *texture.getSource();
+    int size = std::max(source.width, source.height);
+
+    int level = 0;
+    while ((size >> (level + 1)) >= minResidentSize)
+        level++;
+
+    return level;
+}
+
+
+size_t TextureStreamer::levelSize(Texture& texture, int level)
+{
+    TextureImage& source = *texture.getSource();
+    int width = source.width, height = source.height;
+
+    for (int i = 0; i < level; i++)
+    {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    return TextureImage::storageSize(source.format, width, height);
+}
+
+
+// the texture keeps its current level until the new one is uploaded
+void TextureStreamer::stream(std::shared_ptr<Texture> texture, int level)
+{
+    #ifdef DEBUG
+        std::cout << "Texture " << texture->textureName << " streamed from "
+            << "level " << texture->getResidentLevel() << " to " << level
+            << std::endl;
+    #endif /* DEBUG */
+
+    texture->setStreamingLevel(level);
+
+    // downsampling a big image takes longer than a frame
+    std::shared_ptr<TextureImage> source = texture->getSource();
+    std::shared_ptr<std::shared_ptr<TextureImage>> image =
+        std::make_shared<std::shared_ptr<TextureImage>>();
+
+    JobSystem& jobs = JobSystem::instance();
+    JobHandle downsample = jobs.run([source, level, image]{
+        *image = source->fromLevel(level);
+    });
+
+    // the continuation can't run before this command returns, so the handle
+    // is already set
+    std::shared_ptr<JobHandle> handle = std::make_shared<JobHandle>();
+    *handle = jobs.continueOnRenderThread([this, texture, image, handle]{
+        levelJobs.erase(std::find(levelJobs.begin(), levelJobs.end(),
+            *handle));
+        uploader->add(texture, *image);
+    }, {downsample});
+
+    levelJobs.push_back(*handle);
+}
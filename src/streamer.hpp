@@ -0,0 +1,66 @@
+#ifndef STREAMER_HPP_
+#define STREAMER_HPP_
+
+#include "graphics.hpp"
+#include "jobs.hpp"
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class Texture;
+class TextureArray;
+class TextureUploader;
+
+
+// keeps the texture memory under a budget, every texture has only the
+// levels needed for the size of its objects on the screen, the textures
+// which weren't visible for the longest time lose their levels first,
+// textures sharing a layer are streamed together
+class TextureStreamer
+{
+public:
+    TextureStreamer(TextureUploader* textureUploader);
+
+    void setBudget(size_t bytes);
+    size_t getBudget();
+    size_t getUsed();
+    size_t getAllocated();
+
+    void markVisible(Texture* texture, const glm::vec4& bounds,
+        const glm::mat4& view, float pixelsPerUnit, uint64_t frame);
+    void update(std::vector<std::shared_ptr<Texture>>& textures,
+        std::vector<std::shared_ptr<TextureArray>>& arrays, uint64_t frame);
+    void finishJobs();
+
+private:
+    // a layer shared by the textures with the same source, the texture
+    // which is streamed stands for all of them
+    struct Group
+    {
+        std::shared_ptr<Texture> texture;
+        uint64_t lastVisible;
+        int wantedLevel;
+    };
+
+    // the smallest level is never dropped below this size
+    static const int minResidentSize = 32;
+    // levels changed in a single frame
+    static const int maxChanges = 4;
+
+    TextureUploader* uploader;
+    // the levels being made by the jobs
+    std::vector<JobHandle> levelJobs;
+    size_t budget;
+    size_t used;
+    size_t allocated;
+
+    static int maxLevel(Texture& texture);
+    static size_t levelSize(Texture& texture, int level);
+    void stream(std::shared_ptr<Texture> texture, int level);
+};
+
+
+#endif /* STREAMER_HPP_ */
@@ -0,0 +1,607 @@
+#include "teximage.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+    #define NOMINMAX
+    #include <windows.h>
+#endif /* _WIN32 */
+
+
+TextureImage::TextureImage()
+    : memory(MemoryTracker::TEXTURE_CPU)
+{
+}
+
+
+std::shared_ptr<TextureImage> TextureImage::fromRGB(const unsigned char* rgb,
+    int width, int height)
+{
+    std::shared_ptr<TextureImage> image = std::make_shared<TextureImage>();
+    size_t size = static_cast<size_t>(width) * height * 3;
+
+    image->format = GL_RGB8;
+    image->width = width;
+    image->height = height;
+    image->baseLevel = 0;
+    image->levels.push_back(Level{width, height, 0, size});
+    image->data.assign(rgb, rgb + size);
+    image->memory.resize(image->data.size());
+    image->computeHash();
+    return image;
+}
+
+
+int TextureImage::levelCount(int width, int height)
+{
+    return 1 + static_cast<int>(std::log2(std::max(width, height)));
+}
+
+
+// memory used by the image with all its mipmaps on the GPU
+size_t TextureImage::storageSize(GLenum format, int width, int height)
+{
+    size_t size = 0;
+
+    for (int level = 0; level < levelCount(width, height); level++)
+    {
+        if (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+            size += static_cast<size_t>((width + 3) / 4) *
+                ((height + 3) / 4) * 8;
+        // drivers store RGB8 with padding to four bytes per pixel
+        else
+            size += static_cast<size_t>(width) * height * 4;
+
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    return size;
+}
+
+
+// halves the image, the last row and column are repeated for odd sizes
+static std::vector<unsigned char> downsample(const unsigned char* rgb,
+    int width, int height, int newWidth, int newHeight)
+{
+    std::vector<unsigned char> result(
+        static_cast<size_t>(newWidth) * newHeight * 3);
+
+    for (int y = 0; y < newHeight; y++)
+        for (int x = 0; x < newWidth; x++)
+        {
+            int x0 = std::min(x * 2, width - 1);
+            int x1 = std::min(x * 2 + 1, width - 1);
+            int y0 = std::min(y * 2, height - 1);
+            int y1 = std::min(y * 2 + 1, height - 1);
+
+            for (int channel = 0; channel < 3; channel++)
+            {
+                int sum = rgb[(y0 * width + x0) * 3 + channel] +
+                    rgb[(y0 * width + x1) * 3 + channel] +
+                    rgb[(y1 * width + x0) * 3 + channel] +
+                    rgb[(y1 * width + x1) * 3 + channel];
+                result[(y * newWidth + x) * 3 + channel] = (sum + 2) / 4;
+            }
+        }
+
+    return result;
+}
+
+
+static uint16_t toRGB565(const int* color)
+{
+    return ((color[0] * 31 + 127) / 255) << 11 |
+        ((color[1] * 63 + 127) / 255) << 5 |
+        ((color[2] * 31 + 127) / 255);
+}
+
+
+static void fromRGB565(uint16_t packed, int* color)
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+
+// the endpoints are the corners of the colors' bounding box, moved slightly
+// inwards, which is the fast mode of stb_dxt:
+// https://github.com/nothings/stb/blob/master/stb_dxt.h
+// https://www.khronos.org/opengl/wiki/S3_Texture_Compression
+static void encodeBlock(const unsigned char* rgb, int width, int height,
+    int blockX, int blockY, unsigned char* out)
+{
+    int pixels[16][3];
+    int minColor[3] = {255, 255, 255}, maxColor[3] = {0, 0, 0};
+
+    for (int i = 0; i < 16; i++)
+    {
+        int x = std::min(blockX * 4 + i % 4, width - 1);
+        int y = std::min(blockY * 4 + i / 4, height - 1);
+
+        for (int channel = 0; channel < 3; channel++)
+        {
+            pixels[i][channel] = rgb[(y * width + x) * 3 + channel];
+            minColor[channel] = std::min(minColor[channel],
+                pixels[i][channel]);
+            maxColor[channel] = std::max(maxColor[channel],
+                pixels[i][channel]);
+        }
+    }
+
+    for (int channel = 0; channel < 3; channel++)
+    {
+        int inset = (maxColor[channel] - minColor[channel]) / 16;
+        minColor[channel] += inset;
+        maxColor[channel] -= inset;
+    }
+
+    uint16_t color0 = toRGB565(maxColor), color1 = toRGB565(minColor);
+    uint32_t indices = 0;
+
+    // color0 must be the greater one, otherwise the block has only three
+    // colors and a transparent black
+    if (color0 < color1)
+        std::swap(color0, color1);
+
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        fromRGB565(color0, palette[0]);
+        fromRGB565(color1, palette[1]);
+
+        for (int channel = 0; channel < 3; channel++)
+        {
+            palette[2][channel] =
+                (2 * palette[0][channel] + palette[1][channel]) / 3;
+            palette[3][channel] =
+                (palette[0][channel] + 2 * palette[1][channel]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = INT32_MAX;
+
+            for (int entry = 0; entry < 4; entry++)
+            {
+                int distance = 0;
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    int difference = pixels[i][channel] -
+                        palette[entry][channel];
+                    distance += difference * difference;
+                }
+
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = entry;
+                }
+            }
+
+            indices |= static_cast<uint32_t>(best) << (i * 2);
+        }
+    }
+
+    // all values are little-endian
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (i * 8)) & 0xFF;
+}
+
+
+// the mipmaps are built on the CPU and every level is encoded, the block rows
+// of all levels are shared among the jobs
+std::shared_ptr<TextureImage> TextureImage::compressBC1(
+    const unsigned char* rgb, int width, int height)
+{
+    PROFILE_SCOPE("compressBC1");
+
+    std::shared_ptr<TextureImage> image = std::make_shared<TextureImage>();
+    image->format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    image->width = width;
+    image->height = height;
+    image->baseLevel = 0;
+
+    std::vector<std::vector<unsigned char>> mipmaps;
+    mipmaps.push_back(std::vector<unsigned char>(rgb,
+        rgb + static_cast<size_t>(width) * height * 3));
+
+    size_t offset = 0;
+    int levelWidth = width, levelHeight = height;
+
+    for (int level = 0; level < levelCount(width, height); level++)
+    {
+        if (level > 0)
+        {
+            int newWidth = std::max(levelWidth / 2, 1);
+            int newHeight = std::max(levelHeight / 2, 1);
+            mipmaps.push_back(downsample(mipmaps.back().data(), levelWidth,
+                levelHeight, newWidth, newHeight));
+            levelWidth = newWidth;
+            levelHeight = newHeight;
+        }
+
+        size_t size = static_cast<size_t>((levelWidth + 3) / 4) *
+            ((levelHeight + 3) / 4) * 8;
+        image->levels.push_back(Level{levelWidth, levelHeight, offset, size});
+        offset += size;
+    }
+
+    image->data.resize(offset);
+
+    std::vector<std::pair<int, int>> blockRows;
+    for (size_t level = 0; level < image->levels.size(); level++)
+        for (int row = 0; row < image->rowCount(level); row++)
+            blockRows.push_back(std::make_pair(level, row));
+
+    JobSystem::instance().parallelFor(blockRows.size(), 16,
+        [&image, &mipmaps, &blockRows](size_t begin, size_t end){
+        for (size_t task = begin; task < end; task++)
+        {
+            int level = blockRows[task].first, row = blockRows[task].second;
+            Level& info = image->levels[level];
+            unsigned char* out = image->data.data() + info.offset +
+                row * image->rowSize(level);
+
+            for (int column = 0; column < (info.width + 3) / 4; column++)
+                encodeBlock(mipmaps[level].data(), info.width, info.height,
+                    column, row, out + column * 8);
+        }
+    });
+
+    image->memory.resize(image->data.size());
+    image->computeHash();
+    return image;
+}
+
+
+// image without the levels above the given one, compressed images already
+// have the level, uncompressed ones are downsampled
+std::shared_ptr<TextureImage> TextureImage::fromLevel(int level)
+{
+    std::shared_ptr<TextureImage> image = std::make_shared<TextureImage>();
+    image->format = format;
+    image->width = levels[0].width;
+    image->height = levels[0].height;
+    image->baseLevel = baseLevel + level;
+
+    if (compressed())
+    {
+        image->width = levels[level].width;
+        image->height = levels[level].height;
+
+        size_t start = levels[level].offset;
+        for (size_t i = level; i < levels.size(); i++)
+        {
+            image->levels.push_back(levels[i]);
+            image->levels.back().offset -= start;
+        }
+
+        image->data.assign(data.begin() + start, data.begin() +
+            levels.back().offset + levels.back().size);
+    }
+    else
+    {
+        image->data.assign(data.begin() + levels[0].offset,
+            data.begin() + levels[0].offset + levels[0].size);
+
+        for (int i = 0; i < level; i++)
+        {
+            int newWidth = std::max(image->width / 2, 1);
+            int newHeight = std::max(image->height / 2, 1);
+            image->data = downsample(image->data.data(), image->width,
+                image->height, newWidth, newHeight);
+            image->width = newWidth;
+            image->height = newHeight;
+        }
+
+        image->levels.push_back(Level{image->width, image->height, 0,
+            image->data.size()});
+    }
+
+    image->memory.resize(image->data.size());
+    image->computeHash();
+    return image;
+}
+
+
+bool TextureImage::compressed()
+{
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+
+// compressed images are made of rows of 4x4 blocks
+int TextureImage::rowCount(int level)
+{
+    int rows = levels[level].height;
+    return compressed() ? (rows + 3) / 4 : rows;
+}
+
+
+size_t TextureImage::rowSize(int level)
+{
+    size_t columns = levels[level].width;
+    return compressed() ? (columns + 3) / 4 * 8 : columns * 3;
+}
+
+
+int TextureImage::pixelsPerRow()
+{
+    return compressed() ? 4 : 1;
+}
+
+
+// only the pixels are hashed, so an image read from the cache has the same
+// hash as the one which was written there
+void TextureImage::computeHash()
+{
+    uint32_t header[3] = {format, static_cast<uint32_t>(width),
+        static_cast<uint32_t>(height)};
+    hash = hashData(reinterpret_cast<const unsigned char*>(header),
+        sizeof(header));
+
+    for (Level& level : levels)
+        hash = hashData(data.data() + level.offset, level.size, hash);
+}
+
+
+// https://registry.khronos.org/KTX/specs/1.0/ktxspec.v1.html
+static const unsigned char KTXIdentifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+static const int KTXHeaderFields = 13;
+
+
+// only compressed images are cached, their levels never need padding
+bool TextureImage::writeKTX(std::string file)
+{
+    if (!compressed())
+        return false;
+
+    // the file is written under another name first, so a reader never
+    // sees half of it
+    std::string tempFile = file + ".tmp";
+    std::ofstream out(tempFile, std::ios::binary);
+    if (!out.is_open())
+        return false;
+
+    uint32_t header[KTXHeaderFields] = {
+        0x04030201, 0, 1, 0, format, GL_RGB,
+        static_cast<uint32_t>(width), static_cast<uint32_t>(height), 0, 0, 1,
+        static_cast<uint32_t>(levels.size()), 0
+    };
+
+    out.write(reinterpret_cast<const char*>(KTXIdentifier),
+        sizeof(KTXIdentifier));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    for (Level& level : levels)
+    {
+        uint32_t size = level.size;
+        out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        out.write(reinterpret_cast<const char*>(data.data() + level.offset),
+            level.size);
+    }
+
+    out.close();
+    if (out.fail() || !replaceFile(tempFile, file))
+    {
+        std::remove(tempFile.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+// the file is kept in memory as it is, the levels point inside it
+std::shared_ptr<TextureImage> TextureImage::readKTX(std::string file)
+{
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in.is_open())
+        return nullptr;
+
+    std::shared_ptr<TextureImage> image = std::make_shared<TextureImage>();
+    image->data.resize(in.tellg());
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(image->data.data()), image->data.size());
+
+    size_t headerSize = sizeof(KTXIdentifier) +
+        KTXHeaderFields * sizeof(uint32_t);
+    if (in.fail() || image->data.size() < headerSize || memcmp(
+        image->data.data(), KTXIdentifier, sizeof(KTXIdentifier)) != 0)
+        return nullptr;
+
+    uint32_t header[KTXHeaderFields];
+    memcpy(header, image->data.data() + sizeof(KTXIdentifier),
+        sizeof(header));
+
+    // files written on a machine with other endianness aren't supported
+    if (header[0] != 0x04030201 ||
+        header[4] != GL_COMPRESSED_RGB_S3TC_DXT1_EXT || header[6] == 0 ||
+        header[7] == 0 || header[12] != 0)
+        return nullptr;
+
+    image->format = header[4];
+    image->width = header[6];
+    image->height = header[7];
+    image->baseLevel = 0;
+
+    if (header[11] != static_cast<uint32_t>(
+        levelCount(image->width, image->height)))
+        return nullptr;
+
+    size_t offset = headerSize;
+    int levelWidth = image->width, levelHeight = image->height;
+
+    for (uint32_t level = 0; level < header[11]; level++)
+    {
+        uint32_t size;
+        if (offset + sizeof(size) > image->data.size())
+            return nullptr;
+
+        memcpy(&size, image->data.data() + offset, sizeof(size));
+        offset += sizeof(size);
+
+        size_t expected = static_cast<size_t>((levelWidth + 3) / 4) *
+            ((levelHeight + 3) / 4) * 8;
+        if (size != expected || offset + size > image->data.size())
+            return nullptr;
+
+        image->levels.push_back(Level{levelWidth, levelHeight, offset, size});
+        offset += size;
+        levelWidth = std::max(levelWidth / 2, 1);
+        levelHeight = std::max(levelHeight / 2, 1);
+    }
+
+    image->memory.resize(image->data.size());
+    image->computeHash();
+    return image;
+}
+
+
+static const uint64_t hashPrime1 = 0x9E3779B185EBCA87ull;
+static const uint64_t hashPrime2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t hashPrime3 = 0x165667B19E3779F9ull;
+static const uint64_t hashPrime4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t hashPrime5 = 0x27D4EB2F165667C5ull;
+
+
+static uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+static uint64_t hashRound(uint64_t accumulator, uint64_t word)
+{
+    accumulator += word * hashPrime2;
+    return rotateLeft(accumulator, 31) * hashPrime1;
+}
+
+
+static uint64_t hashMerge(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= hashRound(0, accumulator);
+    return hash * hashPrime1 + hashPrime4;
+}
+
+
+// the words are read in the byte order of the CPU
+static uint64_t read64(const unsigned char* data)
+{
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+
+static uint32_t read32(const unsigned char* data)
+{
+    uint32_t word;
+    memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+
+// XXH64, it reads 8 bytes at a time into four independent lanes, so the big
+// texture payloads are hashed several times faster than byte by byte, the
+// hash of the previous part can be passed as the seed to continue
+// https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+uint64_t hashData(const unsigned char* data, size_t size, uint64_t hash)
+{
+    const unsigned char* end = data + size;
+    uint64_t result;
+
+    if (size >= 32)
+    {
+        uint64_t lanes[4] = {hash + hashPrime1 + hashPrime2,
+            hash + hashPrime2, hash, hash - hashPrime1};
+
+        for (; data + 32 <= end; data += 32)
+            for (int lane = 0; lane < 4; lane++)
+                lanes[lane] = hashRound(lanes[lane], read64(data + lane * 8));
+
+        result = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+            rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+        for (uint64_t lane : lanes)
+            result = hashMerge(result, lane);
+    }
+    else
+        result = hash + hashPrime5;
+
+    result += size;
+
+    for (; data + 8 <= end; data += 8)
+    {
+        result ^= hashRound(0, read64(data));
+        result = rotateLeft(result, 27) * hashPrime1 + hashPrime4;
+    }
+
+    if (data + 4 <= end)
+    {
+        result ^= read32(data) * hashPrime1;
+        result = rotateLeft(result, 23) * hashPrime2 + hashPrime3;
+        data += 4;
+    }
+
+    for (; data < end; data++)
+    {
+        result ^= *data * hashPrime5;
+        result = rotateLeft(result, 11) * hashPrime1;
+    }
+
+    // the last bits mix into all of them
+    result ^= result >> 33;
+    result *= hashPrime2;
+    result ^= result >> 29;
+    result *= hashPrime3;
+    result ^= result >> 32;
+
+    return result;
+}
+
+
+// the cache is keyed by the content, so a changed file is encoded again even
+// if its name stays the same
+uint64_t hashFile(std::string file, bool& ok)
+{
+    std::ifstream in(file, std::ios::binary);
+    uint64_t hash = hashData(nullptr, 0);
+    ok = in.is_open();
+
+    std::vector<char> chunk(64 * 1024);
+    while (ok && in)
+    {
+        in.read(chunk.data(), chunk.size());
+        hash = hashData(reinterpret_cast<const unsigned char*>(chunk.data()),
+            in.gcount(), hash);
+    }
+
+    ok = ok && in.eof();
+    return hash;
+}
+
+
+// the target is replaced in a single step, it stays as it was when the move
+// fails, std::rename doesn't replace existing files on Windows
+bool replaceFile(std::string from, std::string to)
+{
+    #ifdef _WIN32
+        return MoveFileExA(from.c_str(), to.c_str(),
+            MOVEFILE_REPLACE_EXISTING) != 0;
+    #else
+        return std::rename(from.c_str(), to.c_str()) == 0;
+    #endif /* _WIN32 */
+}
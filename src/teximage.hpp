@@ -0,0 +1,67 @@
+#ifndef TEXIMAGE_HPP_
+#define TEXIMAGE_HPP_
+
+#include "graphics.hpp"
+#include "memory.hpp"
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// image prepared for the upload, either RGB rows with only the first level
+// or BC1 blocks with all the mipmap levels
+struct TextureImage
+{
+    struct Level
+    {
+        int width;
+        int height;
+        size_t offset;
+        size_t size;
+    };
+
+    GLenum format;
+    int width;
+    int height;
+    // level of the original image this one starts at, lower resolutions
+    // are made for the texture streaming
+    int baseLevel;
+    std::vector<Level> levels;
+    std::vector<unsigned char> data;
+
+    // identical images are uploaded only once
+    uint64_t hash;
+
+    // the decoded data counts to the texture memory until the image is freed
+    TrackedAllocation memory;
+
+    TextureImage();
+
+    static std::shared_ptr<TextureImage> fromRGB(const unsigned char* rgb,
+        int width, int height);
+    static std::shared_ptr<TextureImage> compressBC1(const unsigned char* rgb,
+        int width, int height);
+    static int levelCount(int width, int height);
+    static size_t storageSize(GLenum format, int width, int height);
+
+    std::shared_ptr<TextureImage> fromLevel(int level);
+    bool compressed();
+    int rowCount(int level);
+    size_t rowSize(int level);
+    int pixelsPerRow();
+    void computeHash();
+
+    bool writeKTX(std::string file);
+    static std::shared_ptr<TextureImage> readKTX(std::string file);
+};
+
+
+uint64_t hashData(const unsigned char* data, size_t size, uint64_t hash = 0);
+uint64_t hashFile(std::string file, bool& ok);
+bool replaceFile(std::string from, std::string to);
+
+
+#endif /* TEXIMAGE_HPP_ */
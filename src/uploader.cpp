@@ -0,0 +1,148 @@
+#include "uploader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+TextureUploader::TextureUploader()
+    : bufferMemory(MemoryTracker::UPLOAD_STAGING, segments * segmentSize)
+{
+    // https://www.khronos.org/opengl/wiki/Pixel_Buffer_Object
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+        GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, segments * segmentSize, nullptr, flags);
+    mapped = static_cast<unsigned char*>(glMapNamedBufferRange(buffer, 0,
+        segments * segmentSize, flags));
+
+    for (GLsync& fence : fences)
+        fence = 0;
+
+    segment = 0;
+    uploadedBytes = 0;
+}
+
+
+// the image must be stored from the top row, the shader flips the texture
+// coordinates, so the rows don't have to be reversed
+void TextureUploader::add(std::shared_ptr<Texture> texture,
+    std::shared_ptr<TextureImage> image)
+{
+    // the image is freed once its levels are copied into an array
+    uploads.push_back(Upload{texture, image, TextureArray::createImage(
+        image->width, image->height, image->format), 0, 0,
+        TrackedAllocation(MemoryTracker::UPLOAD_STAGING,
+        TextureImage::storageSize(image->format, image->width,
+        image->height))});
+}
+
+
+// copies whole rows until the segment is full, compressed images are copied
+// by rows of blocks
+std::vector<TextureUploader::Finished> TextureUploader::process()
+{
+    std::vector<Finished> finished;
+    uploadedBytes = 0;
+
+    if (uploads.empty())
+        return finished;
+
+    PROFILE_SCOPE("TextureUploader::process");
+
+    // the segment was used three frames ago, so the wait is usually free
+    if (fences[segment] != 0)
+    {
+        glClientWaitSync(fences[segment], GL_SYNC_FLUSH_COMMANDS_BIT,
+            GL_TIMEOUT_IGNORED);
+        glDeleteSync(fences[segment]);
+        fences[segment] = 0;
+    }
+
+    GLintptr offset = segment * segmentSize;
+    GLintptr end = offset + segmentSize;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (auto it = uploads.begin(); it != uploads.end();)
+    {
+        TextureImage& data = *it->data;
+        TextureImage::Level& level = data.levels[it->level];
+        size_t rowSize = data.rowSize(it->level);
+        int rows = std::min<int>((end - offset) / rowSize,
+            data.rowCount(it->level) - it->nextRow);
+
+        if (rows == 0)
+            break;
+
+        memcpy(mapped + offset, data.data.data() + level.offset +
+            it->nextRow * rowSize, rows * rowSize);
+
+        int y = it->nextRow * data.pixelsPerRow();
+        int height = std::min(rows * data.pixelsPerRow(), level.height - y);
+
+        // with a pixel unpack buffer bound the pointer is an offset into it
+        if (data.compressed())
+            glCompressedTextureSubImage2D(it->image, it->level, 0, y,
+                level.width, height, data.format, rows * rowSize,
+                reinterpret_cast<void*>(offset));
+        else
+            glTextureSubImage2D(it->image, it->level, 0, y, level.width,
+                height, GL_RGB, GL_UNSIGNED_BYTE,
+                reinterpret_cast<void*>(offset));
+
+        offset += rows * rowSize;
+        uploadedBytes += rows * rowSize;
+        it->nextRow += rows;
+
+        if (it->nextRow < data.rowCount(it->level))
+            continue;
+
+        it->nextRow = 0;
+        if (++it->level < static_cast<int>(data.levels.size()))
+            continue;
+
+        finished.push_back(Finished{it->texture, it->image, it->data});
+        it = uploads.erase(it);
+    }
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    segment = (segment + 1) % segments;
+
+    return finished;
+}
+
+
+bool TextureUploader::pending()
+{
+    return !uploads.empty();
+}
+
+
+// bytes copied by the last call of process
+size_t TextureUploader::getUploadedBytes()
+{
+    return uploadedBytes;
+}
+
+
+void TextureUploader::release()
+{
+    for (Upload& upload : uploads)
+        glDeleteTextures(1, &upload.image);
+    uploads.clear();
+
+    for (GLsync& fence : fences)
+        if (fence != 0)
+        {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+
+    glUnmapNamedBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+    bufferMemory.resize(0);
+}
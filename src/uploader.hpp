@@ -0,0 +1,66 @@
+#ifndef UPLOADER_HPP_
+#define UPLOADER_HPP_
+
+#include "graphics.hpp"
+#include "memory.hpp"
+
+#include <GL/glew.h>
+#include <list>
+#include <memory>
+#include <vector>
+
+class Texture;
+struct TextureImage;
+
+
+// streams decoded images to the GPU through a persistently mapped pixel
+// buffer, only a part of the images is copied every frame, so large textures
+// don't stall the rendering
+class TextureUploader
+{
+public:
+    // image whose levels are on the GPU, uncompressed images have only the
+    // first one and their mipmaps must be generated
+    struct Finished
+    {
+        std::shared_ptr<Texture> texture;
+        GLuint image;
+        std::shared_ptr<TextureImage> data;
+    };
+
+    TextureUploader();
+
+    void add(std::shared_ptr<Texture> texture,
+        std::shared_ptr<TextureImage> image);
+    std::vector<Finished> process();
+    bool pending();
+    size_t getUploadedBytes();
+    void release();
+
+private:
+    struct Upload
+    {
+        std::shared_ptr<Texture> texture;
+        std::shared_ptr<TextureImage> data;
+        GLuint image;
+        int level;
+        int nextRow;
+        TrackedAllocation memory;
+    };
+
+    // every frame fills one segment, the segment is reused after its
+    // copies are finished by the GPU
+    static const int segments = 3;
+    static const GLsizeiptr segmentSize = 8 * 1024 * 1024;
+
+    GLuint buffer;
+    unsigned char* mapped;
+    GLsync fences[segments];
+    int segment;
+    size_t uploadedBytes;
+    std::list<Upload> uploads;
+    TrackedAllocation bufferMemory;
+};
+
+
+#endif /* UPLOADER_HPP_ */
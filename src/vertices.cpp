@@ -1,49 +1,92 @@
 #include "vertices.hpp"
 
+#include <algorithm>
+#include <cmath>
 
+
+// drivers often can't allocate bigger buffers, the bigger meshes are split
+static const size_t maxBufferBytes = 1024 * 1024 * 1024;
+
+
+// the data is uploaded by the frames after the buffer is filled
 VertexBuffer::VertexBuffer(GraphicsManager* parent)
-    : parentManager(parent)
+    : parentManager(parent), CPUMemory(MemoryTracker::MESH_CPU),
+    GPUMemory(MemoryTracker::MESH_GPU)
 {
+    dataStored = nullptr;
     dataStoredSize = 0;
+    uploadedBytes = 0;
     glCreateBuffers(1, &ID);
 }
 
 
 VertexBuffer::VertexBuffer(const VertexBuffer& old)
+    : CPUMemory(old.CPUMemory), GPUMemory(old.GPUMemory)
 {
     parentManager = old.parentManager;
     dataStoredSize = old.dataStoredSize;
     dataStored = new GLfloat[dataStoredSize];
-
-    for (GLsizei i = 0; i < dataStoredSize; i++)
-        dataStored[i] = old.dataStored[i];
+    std::copy(old.dataStored, old.dataStored + dataStoredSize, dataStored);
 
     glCreateBuffers(1, &ID);
-    glNamedBufferData(ID, dataStoredSize * sizeof(GLfloat),
-        dataStored, GL_STATIC_DRAW);
+    glNamedBufferData(ID, dataStoredSize * sizeof(GLfloat), nullptr,
+        GL_STATIC_DRAW);
+    uploadedBytes = 0;
+    parentManager->queueBufferUpload(this);
 }
 
 
 VertexBuffer::~VertexBuffer()
 {
+    parentManager->cancelBufferUpload(this);
     glDeleteBuffers(1, &ID);
     delete[] dataStored;
 }
 
 
-void VertexBuffer::sendData(GLfloat* data, GLsizei size)
+// the old storage is orphaned, the frames in flight can still be reading
+// it and writing into it would wait for them
+void VertexBuffer::sendData(const GLfloat* data, size_t size)
 {
     // data is stored inside the object for copying
-    if (dataStoredSize != 0)
-        delete dataStored;
+    if (size != dataStoredSize)
+    {
+        delete[] dataStored;
+        dataStoredSize = size;
+        dataStored = new GLfloat[dataStoredSize];
+    }
 
-    dataStoredSize = size;
-    dataStored = new GLfloat[dataStoredSize];
+    std::copy(data, data + size, dataStored);
+
+    glNamedBufferData(ID, dataStoredSize * sizeof(GLfloat), nullptr,
+        GL_STATIC_DRAW);
+    uploadedBytes = 0;
+    parentManager->queueBufferUpload(this);
 
-    for (GLsizei i = 0; i < dataStoredSize; i++)
-        dataStored[i] = data[i];
+    CPUMemory.resize(size * sizeof(GLfloat));
+    GPUMemory.resize(size * sizeof(GLfloat));
+}
+
+
+// uploads the next part of the stored data, returns its size
+size_t VertexBuffer::upload(size_t maxBytes)
+{
+    size_t bytes = std::min(dataStoredSize * sizeof(GLfloat) - uploadedBytes,
+        maxBytes);
 
-    glNamedBufferData(ID, size * sizeof(GLfloat), data, GL_STATIC_DRAW);
+    if (bytes > 0)
+        glNamedBufferSubData(ID, uploadedBytes, bytes,
+            reinterpret_cast<const char*>(dataStored) + uploadedBytes);
+
+    uploadedBytes += bytes;
+    return bytes;
+}
+
+
+// the buffer can't be drawn until all its data is uploaded
+bool VertexBuffer::isUploaded()
+{
+    return uploadedBytes == dataStoredSize * sizeof(GLfloat);
 }
 
 
@@ -53,25 +96,40 @@ GLuint VertexBuffer::getID()
 }
 
 
+size_t VertexBuffer::getCPUMemory()
+{
+    return CPUMemory.getSize();
+}
+
+
+size_t VertexBuffer::getGPUMemory()
+{
+    return GPUMemory.getSize();
+}
+
+
 VertexArray::VertexArray()
 {
-    glGenVertexArrays(1, &ID);
+    glCreateVertexArrays(1, &ID);
 }
 
 
 VertexArray::~VertexArray()
 {
+    GLState::instance().forgetVertexArray(ID);
     glDeleteVertexArrays(1, &ID);
 }
 
 
+// the vertex array is set up through DSA, so nothing gets bound and the
+// state cache stays valid
 void VertexArray::enable()
 {
-    glBindVertexArray(ID);
+    const GLsizei stride = 11 * sizeof(GLfloat);
 
-    // bind linked buffers
-    for (auto it = buffers.begin(); it != buffers.end(); it++)
-        glBindBuffer((*it).first, (*it).second);
+    // every linked buffer gets its own binding point
+    for (size_t i = 0; i < buffers.size(); i++)
+        glVertexArrayVertexBuffer(ID, i, buffers[i].second, 0, stride);
 
     // usage of the vertex array inspired by:
     // https://learnopengl.com/Getting-started/Hello-Triangle
@@ -79,28 +137,16 @@ void VertexArray::enable()
     // data structure inside vertex array
     //  pos  | color | tex | normal
     // X Y Z | R G B | X Y | X Y Z
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), 
-        (GLvoid*)0);
-    glEnableVertexAttribArray(0);
-    
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), 
-        (GLvoid*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(1);
-    
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), 
-        (GLvoid*)(6 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(2);
-    
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(GLfloat), 
-        (GLvoid*)(8 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(3);
+    const GLint sizes[] = {3, 3, 2, 3};
+    const GLuint offsets[] = {0, 3, 6, 8};
 
-    // vertex array must be unbound first
-    glBindVertexArray(0);
-
-    // unbind linked buffers
-    for (auto it = buffers.begin(); it != buffers.end(); it++)
-        glBindBuffer((*it).first, 0);
+    for (GLuint attrib = 0; attrib < 4; attrib++)
+    {
+        glVertexArrayAttribFormat(ID, attrib, sizes[attrib], GL_FLOAT,
+            GL_FALSE, offsets[attrib] * sizeof(GLfloat));
+        glVertexArrayAttribBinding(ID, attrib, 0);
+        glEnableVertexArrayAttrib(ID, attrib);
+    }
 }
 
 void VertexArray::link(VertexBuffer* buffer)
@@ -110,135 +156,434 @@ void VertexArray::link(VertexBuffer* buffer)
 }
 
 
-void VertexArray::bind()
+GLuint VertexArray::getID()
 {
-    glBindVertexArray(ID);
+    return ID;
 }
 
 
-Texture::Texture(const unsigned char* imageData, int imageWidth,
-    int imageHeight, std::string name)
-    : textureName(name)
+// arrays start small and double when they are full, so a single texture
+// doesn't allocate memory for many layers
+static const int initialLayers = 4;
+
+
+TextureArray::TextureArray(int layerWidth, int layerHeight,
+    GLenum layerFormat)
+    : width(layerWidth), height(layerHeight), format(layerFormat),
+    memory(MemoryTracker::TEXTURE_GPU)
 {
-    glGenTextures(1, &ID);
+    levels = TextureImage::levelCount(width, height);
+    capacity = 0;
+    used = 0;
+    ID = 0;
+    grow(initialLayers);
+}
+
+
+TextureArray::~TextureArray()
+{
+    GLState::instance().forgetTexture(ID);
+    glDeleteTextures(1, &ID);
+}
+
+
+// array textures have immutable storage, a bigger one is created and the
+// existing layers are copied over on the GPU
+void TextureArray::grow(int newCapacity)
+{
+    PROFILE_SCOPE("texture array grow");
+
+    GLuint newID;
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &newID);
 
-    glBindTexture(GL_TEXTURE_2D, ID);
-    
     // setting up bilinear upscaling and trilinear downscaling
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+    glTextureParameteri(newID, GL_TEXTURE_MIN_FILTER,
         GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
-        GL_LINEAR);
+    glTextureParameteri(newID, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     // setting up how the texture wraps around the object
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(newID, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(newID, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, imageWidth, imageHeight, 0, GL_RGB,
-        GL_UNSIGNED_BYTE, imageData);
+    glTextureStorage3D(newID, levels, format, width, height, newCapacity);
 
-    // OpenGL generates the remaining mipmap levels from the image
-    glGenerateMipmap(GL_TEXTURE_2D);
+    if (ID != 0)
+    {
+        for (int level = 0; level < levels; level++)
+            glCopyImageSubData(ID, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                newID, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                std::max(width >> level, 1), std::max(height >> level, 1),
+                used);
+
+        GLState::instance().forgetTexture(ID);
+        glDeleteTextures(1, &ID);
+    }
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    ID = newID;
+    capacity = newCapacity;
+    memory.resize(getAllocatedSize());
+
+    #ifdef DEBUG
+        std::cout << "Texture array " << width << "x" << height
+            << " resized to " << capacity << " layers" << std::endl;
+    #endif /* DEBUG */
+}
+
+
+// compressed and uncompressed layers can't share an array
+bool TextureArray::matches(int imageWidth, int imageHeight,
+    GLenum imageFormat)
+{
+    return imageWidth == width && imageHeight == height &&
+        imageFormat == format;
+}
+
+
+// 2D texture with storage for all mipmap levels of an array layer
+GLuint TextureArray::createImage(int imageWidth, int imageHeight,
+    GLenum imageFormat)
+{
+    GLuint image;
+    glCreateTextures(GL_TEXTURE_2D, 1, &image);
+    glTextureStorage2D(image, TextureImage::levelCount(imageWidth,
+        imageHeight), imageFormat, imageWidth, imageHeight);
+    return image;
+}
+
+
+// uncompressed images have only the first level filled and the mipmaps are
+// generated there, generating them in the array would recalculate every
+// layer, returns -1 when the array can't hold any more layers
+int TextureArray::addLayer(GLuint image, bool generateMipmaps)
+{
+    int layer;
+
+    if (!freeLayers.empty())
+    {
+        layer = freeLayers.back();
+        freeLayers.pop_back();
+    }
+    else
+    {
+        GLint maxLayers;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+        if (used == capacity)
+        {
+            if (capacity >= maxLayers)
+                return -1;
+
+            grow(std::min(capacity * 2, static_cast<int>(maxLayers)));
+        }
+
+        layer = used++;
+        layerUsers.resize(used, 0);
+    }
+
+    layerUsers[layer] = 1;
+
+    if (generateMipmaps)
+        glGenerateTextureMipmap(image);
+
+    for (int level = 0; level < levels; level++)
+        glCopyImageSubData(image, GL_TEXTURE_2D, level, 0, 0, 0,
+            ID, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+            std::max(width >> level, 1), std::max(height >> level, 1), 1);
+
+    return layer;
+}
+
+
+void TextureArray::retainLayer(int layer)
+{
+    layerUsers[layer]++;
+}
+
+
+void TextureArray::releaseLayer(int layer)
+{
+    if (--layerUsers[layer] == 0)
+        freeLayers.push_back(layer);
+}
+
+
+GLuint TextureArray::getID()
+{
+    return ID;
+}
+
+
+size_t TextureArray::getLayerSize()
+{
+    return TextureImage::storageSize(format, width, height);
+}
+
+
+// layers which are free count only to the allocated size
+size_t TextureArray::getUsedSize()
+{
+    return (used - freeLayers.size()) * getLayerSize();
+}
+
+
+size_t TextureArray::getAllocatedSize()
+{
+    return capacity * getLayerSize();
+}
+
+
+// the texture has no image until a layer is set
+Texture::Texture(std::string name, int textureKey)
+    : textureName(name), key(textureKey)
+{
+    layer = -1;
+    hash = 0;
+    residentLevel = 0;
+    streamingLevel = -1;
+    wantedLevel = 0;
+    lastVisible = 0;
 }
 
 
 Texture::~Texture()
 {
-    glDeleteTextures(1, &ID);
+    if (array != nullptr)
+        array->releaseLayer(layer);
+}
+
+
+// replaces the placeholder when the real image is uploaded or a level of
+// the image when it is streamed, the objects using the texture don't have
+// to be changed, the hash stays the one of the source, so a streamed
+// texture is still found by the identical images
+void Texture::setLayer(std::shared_ptr<TextureArray> textureArray,
+    int textureLayer, std::shared_ptr<TextureImage> image)
+{
+    if (array != nullptr)
+        array->releaseLayer(layer);
+
+    array = textureArray;
+    layer = textureLayer;
+    hash = source != nullptr ? source->hash : 0;
+    residentLevel = image->baseLevel;
+    streamingLevel = -1;
 }
 
 
-void Texture::bind()
+// the image is already on the GPU, so it doesn't have to be uploaded again
+void Texture::shareLayer(Texture& other)
 {
-    glBindTexture(GL_TEXTURE_2D, ID);
+    other.array->retainLayer(other.layer);
+
+    if (array != nullptr)
+        array->releaseLayer(layer);
+
+    array = other.array;
+    layer = other.layer;
+    hash = other.hash;
+    residentLevel = other.residentLevel;
+}
+
+
+// the textures sharing an array have the same ID
+GLuint Texture::getID()
+{
+    return array != nullptr ? array->getID() : 0;
 }
 
 
-Object::Object(GraphicsManager* parent, std::string name, int lines,
+int Texture::getLayer()
+{
+    return layer;
+}
+
+
+int Texture::getKey()
+{
+    return key;
+}
+
+
+// hash of the source whose image is in the layer, 0 for the placeholder
+uint64_t Texture::getHash()
+{
+    return hash;
+}
+
+
+void Texture::setSource(std::shared_ptr<TextureImage> image)
+{
+    source = image;
+}
+
+
+// nullptr until the image of the texture is set
+std::shared_ptr<TextureImage> Texture::getSource()
+{
+    return source;
+}
+
+
+// the first level of the source which is on the GPU
+int Texture::getResidentLevel()
+{
+    return residentLevel;
+}
+
+
+size_t Texture::getLayerSize()
+{
+    return array != nullptr ? array->getLayerSize() : 0;
+}
+
+
+// every object using the texture asks for a level, the most detailed one
+// is kept for the frame
+void Texture::requestLevel(int level, uint64_t frame)
+{
+    if (lastVisible != frame)
+        wantedLevel = level;
+    else
+        wantedLevel = std::min(wantedLevel, level);
+
+    lastVisible = frame;
+}
+
+
+int Texture::getWantedLevel()
+{
+    return wantedLevel;
+}
+
+
+uint64_t Texture::getLastVisible()
+{
+    return lastVisible;
+}
+
+
+// -1 when no other level is being uploaded
+void Texture::setStreamingLevel(int level)
+{
+    streamingLevel = level;
+}
+
+
+int Texture::getStreamingLevel()
+{
+    return streamingLevel;
+}
+
+
+// the decoded image kept for the streaming
+size_t Texture::getCPUMemory()
+{
+    return source != nullptr ? source->data.size() : 0;
+}
+
+
+// shared layers are counted by every texture using them
+size_t Texture::getGPUMemory()
+{
+    return getLayerSize();
+}
+
+
+Object::Object(GraphicsManager* parent, std::string name, size_t lines,
     std::shared_ptr<std::vector<GLfloat>> vert,
     std::shared_ptr<std::vector<GLfloat>> texVert,
     std::shared_ptr<std::vector<GLfloat>> norm)
-    :  objectName(name), parentManager(parent), lineCount(lines)
+    :  objectName(name), parentManager(parent), lineCount(lines),
+    combinedMemory(MemoryTracker::MESH_CPU)
 {
-    show = true;
     tex = nullptr;
-    position = glm::vec3(0.0f, 0.0f, 0.0f);
-    rotation = glm::vec3(0.0f, 0.0f, 0.0f);
-    size = glm::vec3(1.0f, 1.0f, 1.0f);
-    renderMode = FILL;
     color[0] = 1.0f;
     color[1] = 0.0f;
     color[2] = 0.0f;
 
-    vertexArrayStride = 11;
+    vertexArrayStride = vertexStride;
 
 // combined array includes position of vertices (x, y, z), colors of vertices
 // without texture (r, g, b), position of vertices in texture (x, y) and
 // vertex normals for lighting (x, y, z)
-    combinedLen = (vert->size() / 3) * vertexArrayStride;
+    size_t vertexCount = vert->size() / 3;
+    combinedLen = vertexCount * vertexArrayStride;
     combinedData = new GLfloat[combinedLen];
+    combinedMemory.resize(combinedLen * sizeof(GLfloat));
 
-    float texVal, normVal;
+    // missing texture coordinates and normals are zeros, the kernel needs
+    // them for every vertex
+    std::vector<GLfloat> paddedTex, paddedNorm;
+    const GLfloat* texData = texVert->data();
+    const GLfloat* normData = norm->data();
 
-    // concatenate all data into a single chunk
-    for (size_t vertex = 0; vertex < vert->size() / 3; vertex++)
+    if (texVert->size() < vertexCount * 2)
     {
-        for (size_t coordIdx = 0; coordIdx < 3; coordIdx++)
-            combinedData[vertex * vertexArrayStride + coordIdx] =
-                vert->at(vertex * 3 + coordIdx);
+        paddedTex.assign(vertexCount * 2, 0.0f);
+        std::copy(texVert->begin(), texVert->end(), paddedTex.begin());
+        texData = paddedTex.data();
+    }
 
-        for (size_t clrIdx = 0; clrIdx < 3; clrIdx++)
-            combinedData[vertex * vertexArrayStride + 3 + clrIdx] =
-                color[clrIdx];
+    if (norm->size() < vertexCount * 3)
+    {
+        paddedNorm.assign(vertexCount * 3, 0.0f);
+        std::copy(norm->begin(), norm->end(), paddedNorm.begin());
+        normData = paddedNorm.data();
+    }
 
-        for (size_t texIdx = 0; texIdx < 2; texIdx++)
-        {
-            if (texVert->size() <= vertex * 2 + texIdx)
-                texVal = 0.0f;
-            else
-                texVal = texVert->at(vertex * 2 + texIdx);
+    // concatenate all data into a single chunk
+    MeshKernels& kernels = MeshKernels::instance();
+    kernels.interleave(vert->data(), texData, normData, color, vertexCount,
+        combinedData);
 
-            combinedData[vertex * vertexArrayStride + 6 + texIdx] = texVal;
-        }
+    // the texture streaming estimates the size of the object on the screen
+    boundingRadius = kernels.maxLength(vert->data(), vertexCount);
 
-        for (size_t normIdx = 0; normIdx < 3; normIdx++)
-        {
-            if (norm->size() <= vertex * 3 + normIdx)
-                normVal = 0.0f;
-            else
-                normVal = norm->at(vertex * 3 + normIdx);
+    createSegments();
+}
 
-            combinedData[vertex * vertexArrayStride + 8 + normIdx] = normVal;
-        }
-    }
 
-    vertexBuffer = new VertexBuffer(parentManager);
-    vertexBuffer->sendData(combinedData, combinedLen);
+// the vertices are already interleaved with the color baked in, so a
+// restored scene skips the parsing and goes straight to the upload
+Object::Object(GraphicsManager* parent, std::string name, size_t lines,
+    std::shared_ptr<std::vector<GLfloat>> interleaved, float radius,
+    glm::vec3 objectColor)
+    :  objectName(name), parentManager(parent), lineCount(lines),
+    combinedMemory(MemoryTracker::MESH_CPU)
+{
+    tex = nullptr;
+    color[0] = objectColor.r;
+    color[1] = objectColor.g;
+    color[2] = objectColor.b;
+
+    vertexArrayStride = vertexStride;
+    combinedLen = interleaved->size();
+    combinedData = new GLfloat[combinedLen];
+    combinedMemory.resize(combinedLen * sizeof(GLfloat));
+    std::copy(interleaved->begin(), interleaved->end(), combinedData);
+
+    boundingRadius = radius;
 
-    vertexArray = new VertexArray();
-    vertexArray->link(vertexBuffer);
-    vertexArray->enable();
+    createSegments();
 }
 
 
 Object::~Object()
 {
     delete[] combinedData;
-    delete vertexArray;
-    delete vertexBuffer;
+
+    for (Segment& segment : segments)
+    {
+        delete segment.array;
+        delete segment.buffer;
+    }
 }
 
 
 Object::Object(const Object& old)
+    : combinedMemory(old.combinedMemory)
 {
-    show = old.show;
     objectName = old.objectName + " copy";
-    position = old.position;
-    rotation = old.rotation;
-    size = old.size;
-    renderMode = old.renderMode;
 
     for (int i = 0; i < 3; i++)
         color[i] = old.color[i];
@@ -247,17 +592,21 @@ Object::Object(const Object& old)
     tex = old.tex;
 
     lineCount = old.lineCount;
+    boundingRadius = old.boundingRadius;
     vertexArrayStride = old.vertexArrayStride;
     combinedLen = old.combinedLen;
     combinedData = new GLfloat[combinedLen];
-    for (int i = 0; i < combinedLen; i++)
-        combinedData[i] = old.combinedData[i];
+    std::copy(old.combinedData, old.combinedData + combinedLen, combinedData);
 
-    vertexBuffer = new VertexBuffer(*old.vertexBuffer);
-
-    vertexArray = new VertexArray();
-    vertexArray->link(vertexBuffer);
-    vertexArray->enable();
+    for (const Segment& oldSegment : old.segments)
+    {
+        Segment segment = oldSegment;
+        segment.buffer = new VertexBuffer(*oldSegment.buffer);
+        segment.array = new VertexArray();
+        segment.array->link(segment.buffer);
+        segment.array->enable();
+        segments.push_back(segment);
+    }
 }
 
 
@@ -274,44 +623,90 @@ void Object::setColor(GLfloat r, GLfloat g, GLfloat b)
     color[2] = b;
 
     // color is on positions 3, 4 and 5
-    for (int vertex = 0; vertex < combinedLen / vertexArrayStride; vertex++)
+    for (size_t vertex = 0; vertex < combinedLen / vertexArrayStride; vertex++)
         for (int tone = 0; tone < 3; tone++)
             combinedData[vertex * vertexArrayStride + 3 + tone] = color[tone];
     
-    vertexBuffer->sendData(combinedData, combinedLen);
+    for (Segment& segment : segments)
+        segment.buffer->sendData(
+            combinedData + segment.first * vertexArrayStride,
+            (segment.triangleVertices + segment.lineVertices) *
+            vertexArrayStride);
 }
 
 
-void Object::draw()
+// distance of the farthest vertex from the object's origin
+float Object::getBoundingRadius()
 {
-    int useTexUniform = glGetUniformLocation(parentManager->getShadersID(),
-        "useTex");
+    return boundingRadius;
+}
 
-    // let shader know if it should try to use texture
-    GLint useTex;
 
-    if (tex != nullptr)
-    {
-        useTex = 1;
-        tex->bind();
-    }
-    else 
-        useTex = 0;
+// number of floats of the line vertices stored after the triangles
+size_t Object::getLineCount()
+{
+    return lineCount;
+}
+
+
+// the interleaved vertices, the scene file saves them as they are
+const GLfloat* Object::getVertexData()
+{
+    return combinedData;
+}
+
+
+size_t Object::getVertexDataLength()
+{
+    return combinedLen;
+}
+
+
+// 0 means no texture, objects with textures in the same array share the ID
+GLuint Object::getTextureID()
+{
+    return tex != nullptr ? tex->getID() : 0;
+}
+
+
+// every object has its own vertex arrays, the first one stands for the
+// whole mesh, 0 for an empty mesh
+GLuint Object::getMeshID()
+{
+    return segments.empty() ? 0 : segments.front().array->getID();
+}
 
-    glUniform1i(useTexUniform, useTex);
-    
-    // calculate model matrix - where is object located in the world
-    glm::mat4 model = glm::mat4(1.0f);
-    model = glm::rotate(model, glm::radians(rotation.x),
-        glm::vec3(1.0f, 0.0f, 0.0f));
-    model = glm::rotate(model, glm::radians(rotation.y),
-        glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::rotate(model, glm::radians(rotation.z),
-        glm::vec3(0.0f, 0.0f, 1.0f));
-    model = glm::translate(model, position);
-    model = glm::scale(model, size);
-
-    parentManager->setUniformMatrix(model, "model");
+
+// the vertex data is kept twice on the CPU, once for editing the colors
+// and once inside the buffer for copying
+size_t Object::getCPUMemory()
+{
+    size_t memory = combinedMemory.getSize();
+    for (Segment& segment : segments)
+        memory += segment.buffer->getCPUMemory();
+    return memory;
+}
+
+
+size_t Object::getGPUMemory()
+{
+    size_t memory = 0;
+    for (Segment& segment : segments)
+        memory += segment.buffer->getGPUMemory();
+    return memory;
+}
+
+
+// every segment is drawn from its own vertex array once its buffer is
+// uploaded, empty parts of the mesh are skipped, so they don't count as draw
+// calls, the triangles are lit and the lines have no normals, so each part
+// uses its own variant of the program
+void Object::draw(const glm::mat4& model, int renderMode,
+    FrameStats& stats)
+{
+    PROFILE_SCOPE("Object::draw");
+
+    GLState& state = GLState::instance();
 
     GLenum oglRenderMode;
     switch(renderMode)
@@ -328,10 +723,86 @@ void Object::draw()
             oglRenderMode = GL_POINT;
         break;
     }
-    glPolygonMode(GL_FRONT_AND_BACK, oglRenderMode);
+    state.setPolygonMode(oglRenderMode);
+
+    for (Segment& segment : segments)
+    {
+        if (!segment.buffer->isUploaded())
+            continue;
+
+        state.bindVertexArray(segment.array->getID());
+
+        // the counts of a segment always fit into GLsizei
+        GLsizei triangleVertices = segment.triangleVertices;
+        GLsizei lineVertices = segment.lineVertices;
+
+        if (triangleVertices > 0)
+        {
+            // the texture array stays bound for the next objects and only
+            // the layer changes
+            GLuint textureID = getTextureID();
+            state.useProgram(parentManager->getShadersID(
+                textureID != 0 ? TEXTURED | LIT : LIT));
+
+            if (textureID != 0)
+            {
+                state.bindTexture(0, textureID);
+                state.setUniform(GLState::TEX_LAYER, tex->getLayer());
+            }
+
+            state.setUniform(GLState::MODEL, model);
+
+            glDrawArrays(GL_TRIANGLES, 0, triangleVertices);
+            stats.drawCalls++;
+            stats.triangles += triangleVertices / 3;
+        }
+
+        if (lineVertices > 0)
+        {
+            state.useProgram(parentManager->getShadersID(0));
+            state.setUniform(GLState::MODEL, model);
+
+            glDrawArrays(GL_LINES, triangleVertices, lineVertices);
+            stats.drawCalls++;
+        }
+
+        stats.vertices += triangleVertices + lineVertices;
+    }
+}
 
-    vertexArray->bind();
-    glDrawArrays(GL_TRIANGLES, 0, combinedLen / 11 - lineCount / 3);
-    glDrawArrays(GL_LINES, combinedLen / 11 - lineCount / 3, combinedLen / 11);
-    glBindTexture(GL_TEXTURE_2D, 0);
+
+// the segments are cut at most maxBufferBytes apart, the line vertices are
+// stored after the triangles, so a cut among the lines has to be at an even
+// distance from their start
+void Object::createSegments()
+{
+    size_t segmentVertices = maxBufferBytes /
+        (vertexArrayStride * sizeof(GLfloat)) / 6 * 6;
+    size_t vertexCount = combinedLen / vertexArrayStride;
+    size_t lineStart = vertexCount - std::min(lineCount / 3, vertexCount);
+    size_t start = 0;
+
+    while (start < vertexCount)
+    {
+        size_t end = std::min(start + segmentVertices, vertexCount);
+        if (end < vertexCount && end > lineStart && (end - lineStart) % 2 != 0)
+            end--;
+
+        Segment segment;
+        segment.first = start;
+        segment.triangleVertices =
+            start < lineStart ? std::min(end, lineStart) - start : 0;
+        segment.lineVertices = end - start - segment.triangleVertices;
+
+        segment.buffer = new VertexBuffer(parentManager);
+        segment.buffer->sendData(combinedData + start * vertexArrayStride,
+            (end - start) * vertexArrayStride);
+
+        segment.array = new VertexArray();
+        segment.array->link(segment.buffer);
+        segment.array->enable();
+
+        segments.push_back(segment);
+        start = end;
+    }
 }
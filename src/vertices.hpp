@@ -1,8 +1,10 @@
 #ifndef VERTICES_HPP_
 #define VERTICES_HPP_
 
-#include "main.hpp"
+#include "graphics.hpp"
+#include "memory.hpp"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <string>
@@ -10,7 +12,8 @@
 #include <glm/glm.hpp>
 
 class GraphicsManager;
-class TextureManager;
+struct TextureImage;
+struct FrameStats;
 
 class VertexBuffer
 {
@@ -19,14 +22,21 @@ public:
     VertexBuffer(const VertexBuffer& old);
     ~VertexBuffer();
 
-    void sendData(GLfloat* data, GLsizei size);
+    void sendData(const GLfloat* data, size_t size);
+    size_t upload(size_t maxBytes);
+    bool isUploaded();
     GLuint getID();
+    size_t getCPUMemory();
+    size_t getGPUMemory();
 
 protected:
     GLuint ID;
     GraphicsManager* parentManager;
     GLfloat* dataStored;
-    GLsizei dataStoredSize;
+    size_t dataStoredSize;
+    size_t uploadedBytes;
+    TrackedAllocation CPUMemory;
+    TrackedAllocation GPUMemory;
 };
 
 
@@ -38,7 +48,7 @@ public:
 
     void link(VertexBuffer* buffer);
     void enable();
-    void bind();
+    GLuint getID();
 
 private:
     GLuint ID;
@@ -46,55 +56,154 @@ private:
 };
 
 
+// textures of the same size share a single array texture, so objects with
+// different textures don't need different bindings
+class TextureArray
+{
+public:
+    TextureArray(int layerWidth, int layerHeight, GLenum layerFormat);
+    ~TextureArray();
+
+    static GLuint createImage(int imageWidth, int imageHeight,
+        GLenum imageFormat);
+
+    bool matches(int imageWidth, int imageHeight, GLenum imageFormat);
+    int addLayer(GLuint image, bool generateMipmaps);
+    void retainLayer(int layer);
+    void releaseLayer(int layer);
+    GLuint getID();
+    size_t getLayerSize();
+    size_t getUsedSize();
+    size_t getAllocatedSize();
+
+private:
+    GLuint ID;
+    int width;
+    int height;
+    GLenum format;
+    int levels;
+    int capacity;
+    int used;
+    std::vector<int> freeLayers;
+
+    // identical images share a layer, it is freed by its last user
+    std::vector<int> layerUsers;
+
+    TrackedAllocation memory;
+
+    void grow(int newCapacity);
+};
+
+
 class Texture
 {
 public:
     std::string textureName;
 
-    Texture(const unsigned char* imageData, int imageWidth, int imageHeight,
-        std::string name);
+    Texture(std::string name, int textureKey);
     ~Texture();
 
-    void bind();
+    void setLayer(std::shared_ptr<TextureArray> textureArray,
+        int textureLayer, std::shared_ptr<TextureImage> image);
+    void shareLayer(Texture& other);
+    GLuint getID();
+    int getLayer();
+    int getKey();
+    uint64_t getHash();
+
+    // the full image is kept in memory, so the streaming can upload any
+    // level when the texture gets closer
+    void setSource(std::shared_ptr<TextureImage> image);
+    std::shared_ptr<TextureImage> getSource();
+    int getResidentLevel();
+    size_t getLayerSize();
+    void requestLevel(int level, uint64_t frame);
+    int getWantedLevel();
+    uint64_t getLastVisible();
+    void setStreamingLevel(int level);
+    int getStreamingLevel();
+    size_t getCPUMemory();
+    size_t getGPUMemory();
 
 private:
-    GLuint ID;
+    std::shared_ptr<TextureArray> array;
+    int layer;
+    int key;
+    uint64_t hash;
+
+    std::shared_ptr<TextureImage> source;
+    int residentLevel;
+    int streamingLevel;
+    int wantedLevel;
+    uint64_t lastVisible;
 };
 
 
+// the buffers and the rarely used data of an object, the transform, the
+// visibility and the render mode are kept by the Scene
 class Object
 {
 public:
-    bool show;
     std::string objectName;
     std::shared_ptr<Texture> tex;
-    glm::vec3 position;
-    glm::vec3 rotation;
-    glm::vec3 size;
-    int renderMode;
 
-    Object(GraphicsManager* parent, std::string name, int lineCount,
+    // floats of a single vertex in the interleaved data
+    static const int vertexStride = 11;
+
+    // features of the default program's variants, the values are their bits
+    enum ShaderFeature
+    {
+        TEXTURED = 1,
+        LIT = 2
+    };
+
+    Object(GraphicsManager* parent, std::string name, size_t lineCount,
         std::shared_ptr<std::vector<GLfloat>> vert,
         std::shared_ptr<std::vector<GLfloat>> tex,
         std::shared_ptr<std::vector<GLfloat>> norm);
+    Object(GraphicsManager* parent, std::string name, size_t lineCount,
+        std::shared_ptr<std::vector<GLfloat>> interleaved, float radius,
+        glm::vec3 objectColor);
     ~Object();
     Object(const Object& oldObject);
 
     std::tuple<GLfloat, GLfloat, GLfloat> getColor();
     void setColor(GLfloat r, GLfloat g, GLfloat b);
-    void draw();
+    float getBoundingRadius();
+    size_t getLineCount();
+    const GLfloat* getVertexData();
+    size_t getVertexDataLength();
+    GLuint getTextureID();
+    GLuint getMeshID();
+    size_t getCPUMemory();
+    size_t getGPUMemory();
+    void draw(const glm::mat4& model, int renderMode, FrameStats& stats);
 
 private:
+    // a part of the mesh in its own buffer, big meshes don't fit into
+    // a single one, the parts hold only whole triangles and lines
+    struct Segment
+    {
+        VertexBuffer* buffer;
+        VertexArray* array;
+        size_t first;
+        size_t triangleVertices;
+        size_t lineVertices;
+    };
+
     GraphicsManager* parentManager;
-    VertexBuffer* vertexBuffer;
-    VertexArray* vertexArray;
+    std::vector<Segment> segments;
 
-    int lineCount;
+    size_t lineCount;
     int vertexArrayStride;
-    int combinedLen;
+    size_t combinedLen;
     GLfloat* combinedData;
+    TrackedAllocation combinedMemory;
 
     GLfloat color[3];
+    float boundingRadius;
+
+    void createSegments();
 
     enum RenderMode
     {
@@ -0,0 +1,24 @@
+#include "../src/kernels.hpp"
+
+#include <iostream>
+
+
+// compares the vectorized mesh kernels with the scalar ones, it needs no GL
+// context, so it runs on any machine, the exit code is 0 when they match
+int main()
+{
+    MeshKernels& kernels = MeshKernels::instance();
+    MeshKernels::Level level = kernels.getLevel();
+
+    std::cout << "Mesh kernels: " << MeshKernels::levelName(level) << std::endl;
+
+    if (!kernels.verify())
+    {
+        std::cerr << "The " << MeshKernels::levelName(level) <<
+            " kernels don't match the scalar versions" << std::endl;
+        return 1;
+    }
+
+    std::cout << "The kernels match the scalar versions" << std::endl;
+    return 0;
+}